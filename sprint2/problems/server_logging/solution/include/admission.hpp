@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "sdk.hpp"
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+//
+#include <boost/asio/ip/address.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+namespace http_server {
+
+// Ограничивает число одновременных сессий и обрабатываемых запросов, чтобы
+// при всплеске нагрузки сервер не накапливал соединения без ограничений.
+// Один объект разделяется всеми acceptor'ами и сессиями сервера, поэтому
+// все методы потокобезопасны
+class AdmissionControl {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Limits {
+        // Максимальное число одновременных сессий. Когда оно достигнуто,
+        // новые соединения не принимаются и ждут в очереди ядра. 0 - без
+        // ограничений
+        std::size_t max_sessions = 0;
+        // Максимальное число сессий с одного IP-адреса. Лишние соединения
+        // получают ответ 503. 0 - без ограничений
+        std::size_t max_sessions_per_ip = 0;
+        // Максимальное число запросов, обрабатываемых одновременно. На лишние
+        // запросы отвечаем 503. 0 - без ограничений
+        std::size_t max_in_flight = 0;
+        // Сколько запросов одной сессии могут ждать ответа одновременно.
+        // Пока предел достигнут, следующие запросы не читаются
+        std::size_t max_pipeline_depth = 16;
+        // Сколько ждать начала следующего запроса в keep-alive соединении
+        Clock::duration idle_timeout = std::chrono::seconds{30};
+        // Сколько ждать заголовков запроса после его начала
+        Clock::duration header_timeout = std::chrono::seconds{30};
+        // Сколько ждать тела запроса после заголовков
+        Clock::duration body_timeout = std::chrono::seconds{30};
+        // Значение Retry-After в ответе 503
+        std::chrono::seconds retry_after{1};
+    };
+
+    // Право сессии на существование. Освобождает место сессии при
+    // уничтожении
+    class SessionPermit {
+      public:
+        SessionPermit() = default;
+        SessionPermit(SessionPermit &&other) noexcept;
+        SessionPermit &operator=(SessionPermit &&other) noexcept;
+        ~SessionPermit();
+
+        explicit operator bool() const noexcept { return control_; }
+
+      private:
+        friend class AdmissionControl;
+
+        SessionPermit(AdmissionControl *control,
+                      boost::asio::ip::address address) noexcept
+            : control_(control), address_(std::move(address)) {}
+
+        AdmissionControl *control_ = nullptr;
+        boost::asio::ip::address address_;
+    };
+
+    // Право запроса на обработку. Освобождает место запроса при уничтожении
+    class RequestPermit {
+      public:
+        RequestPermit() = default;
+        RequestPermit(RequestPermit &&other) noexcept
+            : control_(std::exchange(other.control_, nullptr)) {}
+        RequestPermit &operator=(RequestPermit &&other) noexcept;
+        ~RequestPermit();
+
+        explicit operator bool() const noexcept { return control_; }
+
+      private:
+        friend class AdmissionControl;
+
+        explicit RequestPermit(AdmissionControl *control) noexcept
+            : control_(control) {}
+
+        AdmissionControl *control_ = nullptr;
+    };
+
+    // Ограничения по умолчанию
+    AdmissionControl();
+    explicit AdmissionControl(Limits limits) : limits_(limits) {}
+
+    AdmissionControl(const AdmissionControl &) = delete;
+    AdmissionControl &operator=(const AdmissionControl &) = delete;
+
+    const Limits &GetLimits() const noexcept { return limits_; }
+
+    // Если достигнут предел числа сессий, запоминает on_slot и вызывает его,
+    // когда одна из сессий завершится, и возвращает true. Иначе возвращает
+    // false, не вызывая on_slot
+    bool WaitForSessionSlot(std::function<void()> on_slot);
+
+    // Забывает ждущие acceptor'ы и больше не принимает новых. Вызывается
+    // после остановки io_context'ов, до их разрушения
+    void Stop();
+
+    // Выдаёт право на сессию клиенту с адресом address. Пустое право
+    // означает, что соединение нужно отклонить
+    SessionPermit AdmitSession(const boost::asio::ip::address &address);
+
+    // Выдаёт право на обработку запроса. Пустое право означает, что на
+    // запрос нужно ответить 503
+    RequestPermit AdmitRequest() noexcept;
+
+    // Ответ 503 с заголовком Retry-After для отклонённых соединений и
+    // запросов. Соединение после него закрывается
+    boost::beast::http::response<boost::beast::http::string_body>
+    MakeRejection(unsigned http_version) const;
+
+  private:
+    // Увеличивает counter, если его значение меньше limit (0 - без
+    // ограничений)
+    static bool TryAcquire(std::atomic<std::size_t> &counter,
+                           std::size_t limit) noexcept;
+
+    void ReleaseSession(const boost::asio::ip::address &address);
+    // Освобождает место сессии и будит ждущие его acceptor'ы
+    void ReleaseSessionSlot();
+    void ReleaseRequest() noexcept;
+
+    struct AddressHasher {
+        size_t
+        operator()(const boost::asio::ip::address &address) const noexcept;
+    };
+
+    const Limits limits_;
+
+    std::atomic<std::size_t> sessions_{0};
+    std::atomic<std::size_t> in_flight_{0};
+
+    // Защищает sessions_per_ip_ и waiters_
+    std::mutex mutex_;
+    std::unordered_map<boost::asio::ip::address, std::size_t, AddressHasher>
+        sessions_per_ip_;
+    // Acceptor'ы, ждущие освобождения места для сессии
+    std::vector<std::function<void()>> waiters_;
+    bool stopped_ = false;
+};
+
+} // namespace http_server
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "metrics.hpp"
+#include "worker_topology.hpp"
+
+namespace http_handler {
+
+// Потоки для блокирующих обращений к файловой системе: stat, open и чтения
+// файлов статики. Пока диск отвечает медленно, ждут только эти потоки, а
+// io-потоки продолжают обслуживать остальные запросы. Очередь заданий
+// ограничена, чтобы при медленном диске запросы не копились без предела
+class BlockingIoPool {
+  public:
+    struct Options {
+        // Число потоков. При 0 задания выполняются в вызывающем потоке
+        unsigned threads = 4;
+        // Сколько заданий может ждать свободного потока
+        std::size_t max_queued = 1024;
+    };
+
+    // Каждый поток пула при запуске вызывает setup_thread, если она задана
+    explicit BlockingIoPool(const Options &options,
+                            worker_topology::ThreadSetup setup_thread = {});
+
+    BlockingIoPool(const BlockingIoPool &) = delete;
+    BlockingIoPool &operator=(const BlockingIoPool &) = delete;
+
+    // Ставит задание в очередь. Возвращает false, если очередь заполнена.
+    // Задание не должно выбрасывать исключений. Результат передаётся
+    // дальше самим заданием, например через net::post
+    bool Submit(std::function<void()> job);
+
+    // Текущие длина очереди и число занятых потоков для /metrics
+    metrics::BlockingIoGauges GetGauges() const noexcept;
+
+  private:
+    void Work(std::stop_token stop_token);
+
+    const std::size_t max_queued_;
+    std::mutex mutex_;
+    std::condition_variable_any has_jobs_;
+    std::deque<std::function<void()>> jobs_;
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> busy_{0};
+    // Объявлены последними, чтобы потоки останавливались раньше, чем
+    // разрушается очередь
+    std::vector<std::jthread> threads_;
+};
+
+} // namespace http_handler
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http_handler {
+
+// Диапазон байт ресурса. Границы включаются в диапазон
+struct ByteRange {
+    std::uint64_t first;
+    std::uint64_t last;
+
+    std::uint64_t Size() const noexcept { return last - first + 1; }
+};
+
+struct RangeRequest {
+    enum class Status {
+        // Заголовка нет, он некорректен или его следует игнорировать -
+        // клиенту отправляется ресурс целиком
+        NONE,
+        SATISFIABLE,
+        // Ни один из диапазонов не пересекается с ресурсом - ответ 416
+        NOT_SATISFIABLE,
+    };
+
+    Status status = Status::NONE;
+    std::vector<ByteRange> ranges;
+};
+
+// Разбирает заголовок Range вида "bytes=0-99,200-,-50" для ресурса
+// размером size байт. Диапазоны, выходящие за конец ресурса, усекаются
+RangeRequest ParseRange(std::string_view range, std::uint64_t size);
+
+// Значение заголовка Content-Range: "bytes 0-99/1000"
+std::string MakeContentRange(const ByteRange &range, std::uint64_t size);
+
+// Значение заголовка Content-Range ответа 416: "bytes */1000"
+std::string MakeUnsatisfiedContentRange(std::uint64_t size);
+
+// Служебные строки тела multipart/byteranges
+struct MultipartFraming {
+    std::string content_type;
+    // Заголовки каждой части, включая предшествующий разделитель
+    std::vector<std::string> part_headers;
+    // Завершающий разделитель
+    std::string closing;
+
+    // Размер тела ответа с частями ranges
+    std::uint64_t BodySize(const std::vector<ByteRange> &ranges) const;
+};
+
+MultipartFraming MakeMultipartFraming(const std::vector<ByteRange> &ranges,
+                                      std::string_view content_type,
+                                      std::uint64_t size);
+
+} // namespace http_handler
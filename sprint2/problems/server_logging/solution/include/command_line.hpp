@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "admission.hpp"
+#include "blocking_io_pool.hpp"
+#include "file_reader.hpp"
+#include "http_server.hpp"
+#include "log_sampling.hpp"
+#include "logs.hpp"
+#include "worker_topology.hpp"
+
+namespace command_line {
+
+// Параметры запуска сервера
+struct Args {
+    std::string config_file;
+    std::string www_root;
+    // Максимальный суммарный размер статических файлов в кеше, байт
+    std::size_t static_cache_size = 0;
+    // Статические файлы не меньше этого размера отдаются через sendfile
+    std::uintmax_t sendfile_threshold = 0;
+    // Способ чтения с диска файлов статики, которых нет в кеше
+    http_handler::FileIo file_io = http_handler::FileIo::SYNC;
+    // Потоки для обращений к диску за файлами статики, которых нет в кеше
+    http_handler::BlockingIoPool::Options blocking_io;
+    // Создать при запуске gzip-версии сжимаемых статических файлов
+    bool precompress_static = false;
+    // Число рабочих потоков. 0 - по числу аппаратных потоков
+    unsigned threads = 0;
+    // Запустить в каждом рабочем потоке собственный io_context со своим
+    // acceptor'ом (SO_REUSEPORT) вместо одного io_context на все потоки
+    bool reuse_port = false;
+    // Реализация сессий: на обработчиках завершения или на корутинах
+    http_server::SessionEngine session_engine =
+        http_server::SessionEngine::CALLBACKS;
+    // Ограничения на число соединений и запросов и таймауты чтения
+    http_server::AdmissionControl::Limits admission;
+    // Размещение рабочих потоков по ядрам и узлам NUMA
+    worker_topology::Options topology;
+    // Параметры асинхронного вывода лога
+    logs::Options log;
+    // Параметры выборочного логирования запросов
+    http_handler::LogSampler::Settings request_log;
+    // Токен доступа к /admin/. Пустой токен отключает /admin/
+    std::string admin_token;
+};
+
+// Разбирает параметры командной строки.
+// Возвращает std::nullopt, если была запрошена справка.
+// При некорректных параметрах выбрасывает исключение
+std::optional<Args> ParseCommandLine(int argc, const char *const argv[]);
+
+} // namespace command_line
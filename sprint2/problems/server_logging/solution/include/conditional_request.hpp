@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace http_cache {
+
+using HttpTime = std::chrono::sys_seconds;
+
+// Переводит время модификации файла в HttpTime (с точностью до секунды)
+HttpTime ToHttpTime(std::filesystem::file_time_type file_time);
+
+// Форматирует время в формате HTTP-date: "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string FormatHttpDate(HttpTime time);
+
+// Разбирает HTTP-date. Возвращает std::nullopt при неверном формате
+std::optional<HttpTime> ParseHttpDate(std::string_view date);
+
+// Проверяет, совпадает ли хотя бы один из ETag в заголовке If-None-Match
+// с etag. Используется слабое сравнение (W/"x" совпадает с "x")
+bool MatchesIfNoneMatch(std::string_view if_none_match, std::string_view etag);
+
+// Проверяет по заголовкам условного запроса, что у клиента актуальная версия
+// ресурса и ему можно ответить 304 Not Modified.
+// If-Modified-Since учитывается, только если в запросе нет If-None-Match
+bool IsNotModified(std::string_view if_none_match,
+                   std::string_view if_modified_since, std::string_view etag,
+                   std::optional<HttpTime> last_modified);
+
+} // namespace http_cache
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "admission.hpp"
+#include "metrics.hpp"
+#include "sendfile_body.hpp"
+#include "session_arena.hpp"
+#include "session_settings.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "sdk.hpp"
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+//
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+namespace http_server {
+
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// Сессия, обслуживаемая одной корутиной: чтение запроса, его обработка и
+// отправка ответа записаны последовательно, без цепочки обработчиков
+// завершения. Ограничения, таймауты и сообщения об ошибках те же, что у
+// SessionBase, но запросы, отправленные конвейером, обрабатываются по одному:
+// следующий запрос читается после отправки ответа на предыдущий
+class CoroutineSessionBase {
+  public:
+    // client_endpoint - адрес клиента, полученный при accept
+    CoroutineSessionBase(SessionSocket &&socket,
+                         const tcp::endpoint &client_endpoint,
+                         std::shared_ptr<AdmissionControl> admission,
+                         AdmissionControl::SessionPermit permit);
+
+    CoroutineSessionBase(const CoroutineSessionBase &) = delete;
+    CoroutineSessionBase &operator=(const CoroutineSessionBase &) = delete;
+
+  protected:
+    using HttpRequest = http::request<ArenaStringBody, ArenaFields>;
+    using FileResponse = http::response<SendfileBody, ArenaFields>;
+    // Корутины сессии и их асинхронные операции, как и сокет, используют
+    // исполнитель сессии конкретного типа (см. SessionExecutor)
+    template <typename T> using Awaitable = net::awaitable<T, SessionExecutor>;
+    static constexpr net::use_awaitable_t<SessionExecutor> use_awaitable{};
+
+    ~CoroutineSessionBase();
+
+    SessionExecutor GetExecutor() { return stream_.get_executor(); }
+
+    // Запомнен при accept, как и в SessionBase
+    const tcp::endpoint &GetClientEndpoint() const noexcept {
+        return client_endpoint_;
+    }
+
+    // Читает следующий запрос. Возвращает std::nullopt, если соединение
+    // закрыто клиентом, по таймауту или из-за ошибки
+    Awaitable<std::optional<HttpRequest>> ReadRequest();
+
+    AdmissionControl::RequestPermit AdmitRequest() {
+        return admission_->AdmitRequest();
+    }
+
+    // Отвечает 503 на запрос, не допущенный к обработке
+    void Reject(unsigned version) {
+        SetResponse(admission_->MakeRejection(version));
+    }
+
+    // Запоминает ответ на текущий запрос. Должен вызываться в strand сессии
+    template <typename Body, typename Fields>
+    void SetResponse(http::response<Body, Fields> &&response) {
+        using Response = http::response<Body, Fields>;
+
+        response_ = std::allocate_shared<Response>(arena_.GetAllocator(),
+                                                   std::move(response));
+        write_response_ = [](CoroutineSessionBase &self,
+                             void *response) -> Awaitable<bool> {
+            return self.Write(*static_cast<Response *>(response));
+        };
+        // Будим корутину, если обработчик ответил асинхронно
+        response_ready_.cancel();
+    }
+
+    // Дожидается ответа на текущий запрос и отправляет его. Возвращает true,
+    // если соединение остаётся открытым для следующих запросов
+    Awaitable<bool> WriteResponse();
+
+    void Close();
+
+  private:
+    template <typename Body, typename Fields>
+    Awaitable<bool> Write(http::response<Body, Fields> &response) {
+        beast::error_code ec;
+        stream_.expires_after(SEND_TIMEOUT);
+        const auto bytes_written = co_await http::async_write(
+            stream_, response, net::redirect_error(use_awaitable, ec));
+        co_return OnWrite(response.need_eof(), ec, bytes_written);
+    }
+
+    // Заголовок ответа записывается обычным образом, а тело передаётся из
+    // файла в сокет через sendfile(2)
+    Awaitable<bool> Write(FileResponse &response);
+
+    bool OnWrite(bool close, beast::error_code ec, std::size_t bytes_written);
+
+  private:
+    SessionStream stream_;
+    const tcp::endpoint client_endpoint_;
+    beast::flat_buffer buffer_;
+    // Объявлена раньше всего, что в ней размещается, чтобы уничтожаться
+    // последней
+    SessionArena arena_;
+    std::optional<http::request_parser<ArenaStringBody, ArenaAllocator>>
+        parser_;
+    std::shared_ptr<AdmissionControl> admission_;
+    AdmissionControl::SessionPermit session_permit_;
+
+    // Ответ на текущий запрос, размещённый в арене, и функция, отправляющая
+    // ответ его типа
+    std::shared_ptr<void> response_;
+    Awaitable<bool> (*write_response_)(CoroutineSessionBase &,
+                                            void *) = nullptr;
+    // Срабатывает, когда обработчик, ответивший асинхронно, передал ответ
+    SessionTimer response_ready_;
+    // Ограничивает ожидание готовности сокета при отправке через sendfile,
+    // которое не покрывается таймаутом tcp_stream
+    SessionTimer send_timer_;
+};
+
+template <typename RequestHandler>
+class CoroutineSession
+    : public CoroutineSessionBase,
+      public std::enable_shared_from_this<CoroutineSession<RequestHandler>> {
+  public:
+    template <typename Handler>
+    CoroutineSession(SessionSocket &&socket,
+                     const tcp::endpoint &client_endpoint,
+                     Handler &&request_handler,
+                     std::shared_ptr<AdmissionControl> admission,
+                     AdmissionControl::SessionPermit permit)
+        : CoroutineSessionBase(std::move(socket), client_endpoint,
+                               std::move(admission), std::move(permit)),
+          request_handler_(std::forward<Handler>(request_handler)) {}
+
+    void Run() {
+        // Корутина владеет сессией до своего завершения
+        net::co_spawn(
+            GetExecutor(),
+            [self = this->shared_from_this()] { return self->Serve(); },
+            net::detached);
+    }
+
+  private:
+    Awaitable<void> Serve() {
+        while (auto request = co_await ReadRequest()) {
+            const bool keep_alive = request->keep_alive();
+
+            // Право на обработку удерживается до отправки ответа
+            const auto permit = AdmitRequest();
+            if (permit) {
+                // Ответ может быть передан и после возврата из обработчика
+                // через связанный с лямбдой strand сессии, поэтому лямбда
+                // продлевает время жизни сессии
+                request_handler_(
+                    GetClientEndpoint(), std::move(*request),
+                    net::bind_executor(GetExecutor(),
+                                       [self = this->shared_from_this()](
+                                           auto &&response) {
+                                           self->SetResponse(
+                                               std::move(response));
+                                       }));
+            } else {
+                Reject(request->version());
+            }
+
+            if (!co_await WriteResponse()) {
+                co_return;
+            }
+            if (!keep_alive) {
+                co_return Close();
+            }
+        }
+    }
+
+    RequestHandler request_handler_;
+};
+
+} // namespace http_server
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <system_error>
+
+#include "sdk.hpp"
+//
+#include <boost/asio/any_io_executor.hpp>
+
+namespace http_handler {
+
+// Способ чтения с диска файлов статики, которых нет в кеше
+enum class FileIo {
+    // std::ifstream в потоке пула блокирующего ввода-вывода
+    SYNC,
+    // Асинхронное чтение через io_uring. Доступно, если сервер собран с
+    // опцией GAME_SERVER_IO_URING
+    URING,
+};
+
+// Собран ли сервер с поддержкой чтения файлов через io_uring
+bool IsUringFileIoSupported() noexcept;
+
+using ReadFileHandler =
+    std::function<void(std::error_code ec, std::string content)>;
+
+// Читает файл path целиком и передаёт его содержимое в handler до возврата
+// из ReadFile. Блокирует поток, поэтому вызывается в пуле блокирующего
+// ввода-вывода
+void ReadFile(const std::filesystem::path &path,
+              const ReadFileHandler &handler);
+
+// Файл, открытый для чтения через io_uring. Asio передаёт в io_uring только
+// чтение и запись, а открытие файла и stat блокируют поток. Поэтому файл
+// открывается в пуле блокирующего ввода-вывода, а в strand сессии
+// дескриптор лишь передаётся Asio для чтения
+class OpenedFile {
+  public:
+    OpenedFile() = default;
+    OpenedFile(OpenedFile &&other) noexcept;
+    OpenedFile &operator=(OpenedFile &&other) noexcept;
+    ~OpenedFile();
+
+    // Открывает файл path и узнаёт его размер
+    static OpenedFile Open(const std::filesystem::path &path,
+                           std::error_code &ec);
+
+    bool IsOpen() const noexcept { return fd_ != -1; }
+    std::uint64_t Size() const noexcept { return size_; }
+
+    // Передаёт владение дескриптором вызывающему
+    int Release() noexcept;
+
+  private:
+    int fd_ = -1;
+    std::uint64_t size_ = 0;
+};
+
+// Читает открытый файл через io_uring и передаёт его содержимое в handler
+// через executor. Не блокирует поток
+void ReadOpenedFile(const boost::asio::any_io_executor &executor,
+                    OpenedFile file, ReadFileHandler handler);
+
+} // namespace http_handler
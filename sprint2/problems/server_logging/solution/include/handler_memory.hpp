@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace http_server {
+
+// Память под асинхронные операции сессии. Asio размещает запущенную
+// операцию вместе с обработчиком в памяти, полученной от распределителя
+// обработчика, и освобождает её перед вызовом обработчика. У сессии
+// одновременно запущено всего несколько операций, поэтому им хватает
+// нескольких блоков, выделенных вместе с сессией. Операция, которой не
+// хватило свободного блока, размещается в куче.
+// Asio освобождает память операции в потоке, который её завершил, ещё до
+// перехода в strand сессии, поэтому занятость блоков отмечается атомарно
+class HandlerMemory {
+  public:
+    HandlerMemory() = default;
+
+    HandlerMemory(const HandlerMemory &) = delete;
+    HandlerMemory &operator=(const HandlerMemory &) = delete;
+
+    void *Allocate(std::size_t size);
+    void Deallocate(void *pointer) noexcept;
+
+  private:
+    // Самая большая операция сессии - запись ответов, объединённых в одну
+    // запись: вместе с обработчиком она занимает меньше килобайта
+    static constexpr std::size_t BLOCK_SIZE = 1024;
+    // Обычному запросу хватает шести блоков: чтение, таймер простоя, запись,
+    // таймер отправки и переходы в strand. Остальные - запас для конвейера
+    // и отправки файлов через sendfile
+    static constexpr std::size_t BLOCK_COUNT = 8;
+
+    struct alignas(std::max_align_t) Block {
+        std::byte data[BLOCK_SIZE];
+    };
+
+    std::array<Block, BLOCK_COUNT> blocks_;
+    std::array<std::atomic<bool>, BLOCK_COUNT> used_{};
+};
+
+// Распределитель, который Asio получает от обработчика, связанного с памятью
+// сессии (см. BindHandlerMemory)
+template <typename T> class HandlerAllocator {
+  public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory &memory) noexcept
+        : memory_(&memory) {}
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U> &other) noexcept
+        : memory_(&other.Memory()) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(memory_->Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept { memory_->Deallocate(p); }
+
+    HandlerMemory &Memory() const noexcept { return *memory_; }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U> &other) const noexcept {
+        return memory_ == &other.Memory();
+    }
+
+  private:
+    HandlerMemory *memory_;
+};
+
+// Обработчик, операции которого Asio размещает в памяти сессии. Исполнитель
+// с ним не связан: обработчик вызывается через исполнитель объекта, чью
+// операцию он завершает
+template <typename Handler> class HandlerWithMemory {
+  public:
+    using allocator_type = HandlerAllocator<void>;
+
+    template <typename H>
+    HandlerWithMemory(HandlerMemory &memory, H &&handler)
+        : memory_(&memory), handler_(std::forward<H>(handler)) {}
+
+    allocator_type get_allocator() const noexcept {
+        return allocator_type{*memory_};
+    }
+
+    template <typename... Args> void operator()(Args &&...args) {
+        handler_(std::forward<Args>(args)...);
+    }
+
+  private:
+    HandlerMemory *memory_;
+    Handler handler_;
+};
+
+template <typename Handler>
+HandlerWithMemory<std::decay_t<Handler>>
+BindHandlerMemory(HandlerMemory &memory, Handler &&handler) {
+    return {memory, std::forward<Handler>(handler)};
+}
+
+} // namespace http_server
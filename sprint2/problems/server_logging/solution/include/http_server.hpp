@@ -1,14 +1,31 @@
 #pragma once
 
+#include "admission.hpp"
+#include "coroutine_session.hpp"
 #include "errors.hpp"
+#include "handler_memory.hpp"
+#include "metrics.hpp"
+#include "sendfile_body.hpp"
+#include "session_arena.hpp"
+#include "session_settings.hpp"
+#include "shared_buffer_body.hpp"
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "sdk.hpp"
 // boost.beast будет использовать std::string_view вместо boost::string_view
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 //
+#include <boost/asio/bind_executor.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -21,55 +38,251 @@ namespace beast = boost::beast;
 namespace http = beast::http;
 using namespace std::literals;
 
+// Версия HTTP в формате Beast: 10 * major + minor
+inline constexpr unsigned HTTP_1_1 = 11;
+
+// Реализация сессий. Корутины медленнее цепочки обработчиков и выделяют
+// память на каждый запрос, поэтому по умолчанию выключены (замеры в
+// README.md)
+enum class SessionEngine {
+    // Цепочка обработчиков завершения асинхронных операций (SessionBase)
+    CALLBACKS,
+    // Корутина на каждое соединение (CoroutineSessionBase)
+    COROUTINES,
+};
+
+// Параметры приёма входящих соединений
+struct ListenerOptions {
+    // Разрешает нескольким acceptor'ам слушать один и тот же порт
+    // (SO_REUSEPORT). Ядро само распределяет входящие соединения между ними,
+    // поэтому каждый поток может принимать соединения в своём io_context
+    bool reuse_port = false;
+    // Ограничения на число сессий и запросов и таймауты чтения. Может быть
+    // общим для нескольких acceptor'ов. Если не задано, действуют ограничения
+    // по умолчанию
+    std::shared_ptr<AdmissionControl> admission;
+    SessionEngine engine = SessionEngine::CALLBACKS;
+};
+
+// Сессия поддерживает конвейерную обработку (HTTP/1.1 pipelining): пока
+// отправляются ответы на предыдущие запросы, читаются следующие. Ответы
+// отправляются строго в порядке поступления запросов, а несколько готовых
+// подряд небольших ответов - одной записью.
+// Запросы, поля ответов и объекты, владеющие ответами во время отправки,
+// размещаются в арене сессии, которая сбрасывается, когда все прочитанные
+// запросы получили ответы
 class SessionBase {
   public:
     void Run();
-    explicit SessionBase(boost::asio::ip::tcp::socket &&socket);
+    // client_endpoint - адрес клиента, полученный при accept
+    SessionBase(SessionSocket &&socket, const tcp::endpoint &client_endpoint,
+                std::shared_ptr<AdmissionControl> admission,
+                AdmissionControl::SessionPermit permit);
 
   protected:
-    using HttpRequest = http::request<http::string_body>;
-    ~SessionBase() = default;
+    using HttpRequest = http::request<ArenaStringBody, ArenaFields>;
+    using FileResponse = http::response<SendfileBody, ArenaFields>;
+    ~SessionBase();
 
+    // Ставит ответ на запрос с номером sequence в очередь отправки. Должен
+    // вызываться в strand сессии
     template <typename Body, typename Fields>
-    void Write(http::response<Body, Fields> &&response) {
+    void Write(std::uint64_t sequence,
+               http::response<Body, Fields> &&response) {
         // Запись выполняется асинхронно, поэтому response перемещаем в область
         // кучи
         auto safe_response =
-            std::make_shared<http::response<Body, Fields>>(std::move(response));
-
-        auto self = GetSharedThis();
-        http::async_write(stream_, *safe_response,
-                          [safe_response, self](beast::error_code ec,
-                                                std::size_t bytes_written) {
-                              self->OnWrite(safe_response->need_eof(), ec,
-                                            bytes_written);
-                          });
+            std::allocate_shared<http::response<Body, Fields>>(
+                arena_.GetAllocator(), std::move(response));
+
+        auto &pending = GetPendingResponse(sequence);
+        pending.need_eof = safe_response->need_eof();
+
+        if (safe_response->chunked()) {
+            // Кодирование тела частями выполняет сериализатор Beast
+            pending.write_alone = [](SessionBase &self, void *response) {
+                self.WriteAlone(
+                    *static_cast<http::response<Body, Fields> *>(response));
+            };
+        } else {
+            AppendHeader(pending.header, safe_response->base());
+            AppendBodyBuffers(pending.body, safe_response->body());
+        }
+        pending.storage = std::move(safe_response);
+
+        OnResponseReady(pending);
     }
 
-    inline tcp::endpoint GetClientEndpoint() {
-        return stream_.socket().remote_endpoint();
+    // Заголовок ответа записывается обычным образом, а тело передаётся из
+    // файла в сокет через sendfile(2)
+    void Write(std::uint64_t sequence, FileResponse &&response);
+
+    // Адрес запоминается при accept: к моменту обработки запроса,
+    // прочитанного конвейером, клиент мог уже сбросить соединение, и
+    // getpeername завершился бы ошибкой
+    const tcp::endpoint &GetClientEndpoint() const noexcept {
+        return client_endpoint_;
     }
 
+    SessionExecutor GetExecutor() { return stream_.get_executor(); }
+
   private:
+    // Ответ, ожидающий отправки
+    struct PendingResponse {
+        AdmissionControl::RequestPermit permit;
+        bool ready = false;
+        bool need_eof = false;
+        // Ответ, целиком находящийся в памяти: сериализованный заголовок и
+        // участки тела, которые можно отправить вместе с соседними ответами
+        std::string header;
+        std::vector<net::const_buffer> body;
+        // Ответ, размещённый в арене. Владеет памятью, на которую
+        // ссылаются участки тела
+        std::shared_ptr<void> storage;
+        // Запускает отдельную запись ответа из storage, который нельзя
+        // объединить с соседними. По её окончании вызывается OnWrite
+        void (*write_alone)(SessionBase &, void *response) = nullptr;
+
+        std::size_t Size() const noexcept;
+        // Освобождает ответ, сохраняя выделенную под заголовок и участки
+        // тела память для следующих ответов
+        void Clear() noexcept;
+    };
+
     // Запрещаем копирование и присваивание объектов SessionBase и его
     // наследников
     SessionBase(const SessionBase &) = delete;
     SessionBase &operator=(const SessionBase &) = delete;
 
+    template <typename Fields>
+    static void AppendHeader(std::string &out,
+                             const http::response_header<Fields> &header) {
+        out += "HTTP/"sv;
+        out += static_cast<char>('0' + header.version() / 10);
+        out += '.';
+        out += static_cast<char>('0' + header.version() % 10);
+        out += ' ';
+        const auto code = header.result_int();
+        out += static_cast<char>('0' + code / 100 % 10);
+        out += static_cast<char>('0' + code / 10 % 10);
+        out += static_cast<char>('0' + code % 10);
+        out += ' ';
+        out += header.reason();
+        out += "\r\n"sv;
+
+        for (const auto &field : header) {
+            out += field.name_string();
+            out += ": "sv;
+            out += field.value();
+            out += "\r\n"sv;
+        }
+
+        out += "\r\n"sv;
+    }
+    static void AppendBodyBuffers(std::vector<net::const_buffer> &out,
+                                  const std::string &body);
+    static void
+    AppendBodyBuffers(std::vector<net::const_buffer> &out,
+                      const SharedBufferBody::value_type &body);
+
+    // Чтение запроса проходит три этапа со своими таймаутами: ожидание
+    // начала запроса в keep-alive соединении, чтение заголовков и чтение
+    // тела
     void Read();
-    void OnRead(boost::beast::error_code ec,
-                [[maybe_unused]] std::size_t bytes_read);
+    void OnIdleRead(boost::beast::error_code ec, std::size_t bytes_read);
+    void OnIdleTimeout(boost::beast::error_code ec);
+    void ReadHeader();
+    void OnReadHeader(boost::beast::error_code ec, std::size_t bytes_read);
+    void OnRead(boost::beast::error_code ec, std::size_t bytes_read);
+    // Читает следующий запрос, если глубина конвейера это позволяет
+    void ContinueReading();
+    // Прекращает чтение запросов. Соединение закрывается после отправки
+    // ответов на уже прочитанные запросы
+    void StopReading();
+
+    std::size_t PendingCount() const noexcept {
+        return next_sequence_ - first_sequence_;
+    }
+    PendingResponse &GetPendingResponse(std::uint64_t sequence) noexcept {
+        return pending_[sequence % pending_.size()];
+    }
+    void OnResponseReady(PendingResponse &pending);
+    // Отправляет готовые ответы из начала очереди
+    void WriteNext();
+    template <typename Body, typename Fields>
+    void WriteAlone(http::response<Body, Fields> &response) {
+        // Ответ остаётся в очереди до вызова OnWrite
+        http::async_write(
+            stream_.socket(), response,
+            BindHandlerMemory(handler_memory_,
+                              [close = response.need_eof(),
+                               self = GetSharedThis()](
+                                  beast::error_code ec,
+                                  std::size_t bytes_written) {
+                                  self->OnWrite(close, ec, bytes_written);
+                              }));
+    }
+    void WriteFile(FileResponse &response);
     void OnWrite(bool close, boost::beast::error_code ec,
-                 [[maybe_unused]] std::size_t bytes_written);
+                 std::size_t bytes_written);
+    // Ограничивает время отправки ответа или ожидания готовности сокета к
+    // отправке следующей части файла. По истечении отменяет операции сокета
+    void StartSendTimer();
+    // Прекращает отправку ответов после закрывающего соединение ответа или
+    // ошибки записи. Готовые ответы отбрасываются сразу, остальные - когда
+    // будут готовы
+    void StopWriting();
     void Close();
+    // Отправляет тело ответа, заголовок которого записан file_serializer_
+    void SendFileBody(std::uint64_t sent);
 
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
-    virtual void HandleRequest(HttpRequest &&request) = 0;
+    virtual void HandleRequest(HttpRequest &&request,
+                               std::uint64_t sequence) = 0;
 
   private:
-    boost::beast::tcp_stream stream_;
+    SessionStream stream_;
+    const tcp::endpoint client_endpoint_;
     boost::beast::flat_buffer buffer_;
-    HttpRequest request_;
+    // Объявлена раньше всего, что в ней размещается, чтобы уничтожаться
+    // последней
+    SessionArena arena_;
+    std::optional<http::request_parser<ArenaStringBody, ArenaAllocator>>
+        parser_;
+    std::shared_ptr<AdmissionControl> admission_;
+    AdmissionControl::SessionPermit session_permit_;
+    // Память под запущенные асинхронные операции сессии
+    HandlerMemory handler_memory_;
+
+    // Кольцевой буфер ответов на прочитанные запросы размером в глубину
+    // конвейера. Ответ на запрос с номером n хранится в элементе
+    // n % pending_.size()
+    std::vector<PendingResponse> pending_;
+    // Номер первого запроса, ответ на который ещё не отправлен
+    std::uint64_t first_sequence_ = 0;
+    // Номер следующего прочитанного запроса
+    std::uint64_t next_sequence_ = 0;
+    // Сколько первых ответов очереди отправляется текущей записью
+    std::size_t writing_count_ = 0;
+    std::vector<net::const_buffer> write_buffers_;
+    // Сериализатор ответа из очереди, отправляемого через sendfile.
+    // Объявлен после очереди, чтобы уничтожаться раньше ответа
+    std::optional<http::response_serializer<SendfileBody, ArenaFields>>
+        file_serializer_;
+
+    bool reading_ = false;
+    bool waiting_for_request_ = false;
+    bool read_stopped_ = false;
+    bool write_stopped_ = false;
+
+    // Ограничивает ожидание начала запроса. В отличие от таймаута
+    // tcp_stream, не закрывает соединение, пока отправляются ответы на
+    // предыдущие запросы
+    SessionTimer idle_timer_;
+    // Ограничивает отправку ответа. Ответы пишутся прямо в сокет, а не через
+    // stream_: внутренний таймер tcp_stream использует net::any_io_executor,
+    // и каждая запись с таймаутом выделяла бы память в куче
+    SessionTimer send_timer_;
 };
 
 template <typename RequestHandler>
@@ -77,8 +290,12 @@ class Session : public SessionBase,
                 public std::enable_shared_from_this<Session<RequestHandler>> {
   public:
     template <typename Handler>
-    Session(tcp::socket &&socket, Handler &&request_handler)
-        : SessionBase(std::move(socket)),
+    Session(SessionSocket &&socket, const tcp::endpoint &client_endpoint,
+            Handler &&request_handler,
+            std::shared_ptr<AdmissionControl> admission,
+            AdmissionControl::SessionPermit permit)
+        : SessionBase(std::move(socket), client_endpoint, std::move(admission),
+                      std::move(permit)),
           request_handler_(std::forward<Handler>(request_handler)) {}
 
   private:
@@ -86,15 +303,20 @@ class Session : public SessionBase,
         return this->shared_from_this();
     }
 
-    void HandleRequest(HttpRequest &&request) override {
+    void HandleRequest(HttpRequest &&request,
+                       std::uint64_t sequence) override {
         // Захватываем умный указатель на текущий объект Session в лямбде,
         // чтобы продлить время жизни сессии до вызова лямбды.
         // Используется generic-лямбда функция, способная принять response
-        // произвольного типа
-        request_handler_(this->GetClientEndpoint(), std::move(request),
-                         [self = this->shared_from_this()](auto &&response) {
-                             self->Write(std::move(response));
-                         });
+        // произвольного типа. Обработчик, отвечающий асинхронно, вызывает её
+        // через связанный с ней strand сессии
+        request_handler_(
+            this->GetClientEndpoint(), std::move(request),
+            net::bind_executor(this->GetExecutor(),
+                               [self = this->shared_from_this(),
+                                sequence](auto &&response) {
+                                   self->Write(sequence, std::move(response));
+                               }));
     }
 
   private:
@@ -106,12 +328,16 @@ class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
   public:
     template <typename Handler>
     Listener(net::io_context &ioc, const tcp::endpoint &server_endpoint,
-             Handler &&request_handler)
+             Handler &&request_handler, const ListenerOptions &options = {})
         : ioc_(ioc),
           // Обработчики асинхронных операций acceptor_ будут вызываться в своём
           // strand
           acceptor_(net::make_strand(ioc)),
-          request_handler_(std::forward<Handler>(request_handler)) {
+          request_handler_(std::forward<Handler>(request_handler)),
+          admission_(options.admission
+                         ? options.admission
+                         : std::make_shared<AdmissionControl>()),
+          engine_(options.engine) {
         // Открываем acceptor, используя протокол (IPv4 или IPv6), указанный в
         // endpoint
         acceptor_.open(server_endpoint.protocol());
@@ -122,6 +348,9 @@ class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
         // полузакрытом состоянии. Флаг reuse_address разрешает открыть сокет,
         // когда он "наполовину закрыт"
         acceptor_.set_option(net::socket_base::reuse_address(true));
+        if (options.reuse_port) {
+            acceptor_.set_option(ReusePort(true));
+        }
         // Привязываем acceptor к адресу и порту endpoint
         acceptor_.bind(server_endpoint);
         // Переводим acceptor в состояние, в котором он способен принимать новые
@@ -133,12 +362,52 @@ class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
     void Run() { DoAccept(); }
 
   private:
-    void AsyncRunSession(tcp::socket &&socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket),
-                                                  request_handler_)
+    void AsyncRunSession(SessionSocket &&socket,
+                         const tcp::endpoint &client_endpoint,
+                         AdmissionControl::SessionPermit permit) {
+        if (engine_ == SessionEngine::COROUTINES) {
+            return std::make_shared<CoroutineSession<RequestHandler>>(
+                       std::move(socket), client_endpoint, request_handler_,
+                       admission_, std::move(permit))
+                ->Run();
+        }
+        std::make_shared<Session<RequestHandler>>(
+            std::move(socket), client_endpoint, request_handler_, admission_,
+            std::move(permit))
             ->Run();
     }
+
+    // Отвечает 503 на соединение сверх ограничений и закрывает его. Запрос
+    // не читается, поэтому ответ отправляется по HTTP/1.1
+    void Reject(SessionSocket &&socket) {
+        struct Rejection {
+            SessionSocket socket;
+            http::response<http::string_body> response;
+        };
+        auto rejection = std::make_shared<Rejection>(
+            std::move(socket), admission_->MakeRejection(HTTP_1_1));
+
+        http::async_write(
+            rejection->socket, rejection->response,
+            [rejection](beast::error_code, std::size_t bytes_written) {
+                metrics::Increment(metrics::Counter::BYTES_SENT,
+                                   bytes_written);
+                beast::error_code ec;
+                rejection->socket.shutdown(tcp::socket::shutdown_send, ec);
+            });
+    }
+
     void DoAccept() {
+        // Пока число сессий на пределе, новые соединения ждут в очереди ядра
+        const bool paused =
+            admission_->WaitForSessionSlot([self = this->shared_from_this()] {
+                net::post(self->acceptor_.get_executor(),
+                          [self] { self->DoAccept(); });
+            });
+        if (paused) {
+            return;
+        }
+
         acceptor_.async_accept(
             // Передаём последовательный исполнитель, в котором будут вызываться
             // обработчики асинхронных операций сокета
@@ -154,37 +423,82 @@ class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
                                       this->shared_from_this()));
     }
 
+    void DoAcceptAfterBackoff() {
+        accept_backoff_.expires_after(ACCEPT_BACKOFF);
+        accept_backoff_.async_wait(
+            [self = this->shared_from_this()](beast::error_code ec) {
+                if (!ec) {
+                    self->DoAccept();
+                }
+            });
+    }
+
     // Метод socket::async_accept создаст сокет и передаст его передан в
     // OnAccept
-    void OnAccept(beast::error_code ec, tcp::socket socket) {
+    void OnAccept(beast::error_code ec, SessionSocket socket) {
         using namespace std::literals;
 
+        if (ec == net::error::operation_aborted) {
+            return;
+        }
         if (ec) {
-            return error::Report(ec, "accept"sv);
+            metrics::Increment(metrics::Counter::ACCEPT_ERRORS);
+            error::Report(ec, "accept"sv);
+            // Без свободных дескрипторов accept сразу же завершится той же
+            // ошибкой, поэтому следующая попытка откладывается, пока сессии
+            // не закроют часть соединений. После прочих ошибок (например,
+            // клиент сбросил соединение до accept) приём продолжается сразу
+            if (ec == net::error::no_descriptors ||
+                ec == boost::system::errc::too_many_files_open_in_system) {
+                return DoAcceptAfterBackoff();
+            }
+            return DoAccept();
         }
 
-        // Асинхронно обрабатываем сессию
-        AsyncRunSession(std::move(socket));
+        // Клиент мог успеть закрыть соединение
+        beast::error_code endpoint_ec;
+        const auto endpoint = socket.remote_endpoint(endpoint_ec);
+
+        if (!endpoint_ec) {
+            if (auto permit = admission_->AdmitSession(endpoint.address())) {
+                // Асинхронно обрабатываем сессию
+                AsyncRunSession(std::move(socket), endpoint,
+                                std::move(permit));
+            } else {
+                Reject(std::move(socket));
+            }
+        }
 
         // Принимаем новое соединение
         DoAccept();
     }
 
   private:
+    using ReusePort =
+        net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+    // Пауза перед повторным accept, когда у процесса или системы
+    // закончились файловые дескрипторы
+    static constexpr std::chrono::milliseconds ACCEPT_BACKOFF{100};
+
     net::io_context &ioc_;
     tcp::acceptor acceptor_;
+    // Срабатывает в strand acceptor_, как и его обработчики
+    net::steady_timer accept_backoff_{acceptor_.get_executor()};
     RequestHandler request_handler_;
+    std::shared_ptr<AdmissionControl> admission_;
+    SessionEngine engine_;
 };
 
 template <typename RequestHandler>
 void ServeHttp(net::io_context &ioc, const tcp::endpoint &server_endpoint,
-               RequestHandler &&handler) {
+               RequestHandler &&handler, const ListenerOptions &options = {}) {
     // При помощи decay_t исключим ссылки из типа RequestHandler,
     // чтобы Listener хранил RequestHandler по значению
     using MyListener = Listener<std::decay_t<RequestHandler>>;
 
     std::make_shared<MyListener>(ioc, server_endpoint,
-                                 std::forward<RequestHandler>(handler))
+                                 std::forward<RequestHandler>(handler), options)
         ->Run();
 }
 
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+namespace logs {
+
+// Дописывает к out строку str в кавычках, экранируя её по правилам JSON
+void AppendJsonString(std::string &out, std::string_view str);
+
+// Формирует JSON-объект непосредственно в строке, без построения
+// промежуточного json::object. Используется для поля data записей лога:
+//
+//     std::string data;
+//     logs::JsonObjectWriter{data}.Add("code"sv, 200).Add("ip"sv, ip);
+//
+// Объект закрывается в деструкторе
+class JsonObjectWriter {
+  public:
+    explicit JsonObjectWriter(std::string &out) : out_(out) { out_ += '{'; }
+
+    ~JsonObjectWriter() { out_ += '}'; }
+
+    JsonObjectWriter &Add(std::string_view key, std::string_view value) {
+        AppendKey(key);
+        AppendJsonString(out_, value);
+        return *this;
+    }
+
+    JsonObjectWriter &Add(std::string_view key, const char *value) {
+        return Add(key, std::string_view{value});
+    }
+
+    JsonObjectWriter &Add(std::string_view key, bool value) {
+        AppendKey(key);
+        out_ += value ? "true" : "false";
+        return *this;
+    }
+
+    template <std::integral T>
+    JsonObjectWriter &Add(std::string_view key, T value) {
+        AppendKey(key);
+        char buffer[24];
+        auto [end, ec] = std::to_chars(std::begin(buffer), std::end(buffer),
+                                       value);
+        out_.append(buffer, end);
+        return *this;
+    }
+
+    // Добавляет значение, уже записанное в формате JSON
+    JsonObjectWriter &AddRaw(std::string_view key, std::string_view json) {
+        AppendKey(key);
+        out_ += json;
+        return *this;
+    }
+
+  private:
+    JsonObjectWriter(const JsonObjectWriter &) = delete;
+    JsonObjectWriter &operator=(const JsonObjectWriter &) = delete;
+
+    void AppendKey(std::string_view key) {
+        if (!empty_) {
+            out_ += ',';
+        }
+        empty_ = false;
+        AppendJsonString(out_, key);
+        out_ += ':';
+    }
+
+    std::string &out_;
+    bool empty_ = true;
+};
+
+} // namespace logs
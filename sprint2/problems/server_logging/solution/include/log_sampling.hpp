@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <boost/json.hpp>
+
+namespace http_handler {
+
+// Выборочное логирование запросов.
+// Записи о запросе и ответе выводятся лишь для каждого rate-го запроса к
+// маршруту. Ответы с ошибками (код >= 400) и медленные ответы логируются
+// всегда. Остальные ответы попадают в сводку по маршруту и коду ответа.
+// Сводки выводятся вызовом Flush, который main выполняет по таймеру раз в
+// aggregate_interval и при завершении сервера
+class LogSampler {
+  public:
+    struct Settings {
+        // Логировать каждый rate-й запрос, если для маршрута не задано иное
+        unsigned default_rate = 1;
+        // Ответы, сформированные не быстрее этого, логируются всегда
+        std::chrono::milliseconds slow_threshold{100};
+        // Как часто выводить сводки по пропущенным записям
+        std::chrono::seconds aggregate_interval{60};
+    };
+
+    explicit LogSampler(const Settings &settings);
+
+    // Добавляет маршрут, для которого можно задать отдельную частоту.
+    // Вызывается до запуска io-потоков
+    void AddRoute(std::string_view route);
+
+    // Решает, логировать ли запрос к маршруту route. Вызывается до обработки
+    // запроса
+    bool Sample(std::string_view route) noexcept;
+
+    // Ответ, который логируется независимо от решения Sample
+    bool MustLog(unsigned code,
+                 std::chrono::milliseconds response_time) const noexcept;
+
+    // Учитывает в сводке ответ, запись о котором не выводилась. Время
+    // хранится в микросекундах: большинство таких ответов быстрее
+    // миллисекунды
+    void Aggregate(std::string_view route, unsigned code, std::uint64_t bytes,
+                   std::chrono::microseconds response_time);
+
+    // Выводит и сбрасывает все накопленные сводки
+    void Flush();
+
+    std::chrono::seconds GetAggregateInterval() const noexcept {
+        return aggregate_interval_;
+    }
+
+    // Текущие настройки:
+    // {"default_rate":1,"slow_threshold_ms":100,"routes":{"/api/v1/maps":1}}
+    std::string SettingsToJson() const;
+
+    // Изменяет настройки, переданные в объекте того же вида, что и
+    // возвращает SettingsToJson. Любое поле можно опустить. Частота 0 для
+    // маршрута означает частоту по умолчанию.
+    // При некорректных настройках выбрасывает std::invalid_argument, не
+    // применив ни одной из них
+    void ApplySettings(const boost::json::object &settings);
+
+  private:
+    LogSampler(const LogSampler &) = delete;
+    LogSampler &operator=(const LogSampler &) = delete;
+
+    struct Summary {
+        std::uint64_t count = 0;
+        std::uint64_t bytes = 0;
+        std::chrono::microseconds total_time{0};
+        std::chrono::microseconds max_time{0};
+    };
+
+    struct RouteState {
+        // 0 - использовать частоту по умолчанию
+        std::atomic<unsigned> rate{0};
+        std::atomic<std::uint64_t> counter{0};
+
+        std::mutex mutex;
+        // Код ответа -> сводка
+        std::map<unsigned, Summary> summaries;
+    };
+
+    // Хешер с поддержкой гетерогенного поиска по std::string_view
+    struct RouteHasher {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view route) const noexcept {
+            return std::hash<std::string_view>{}(route);
+        }
+    };
+
+    // Состояние маршрута route. Для неизвестных маршрутов - общее состояние
+    // запросов, не совпавших ни с одним маршрутом
+    RouteState &GetState(std::string_view route) const noexcept;
+
+    std::atomic<unsigned> default_rate_;
+    std::atomic<std::chrono::milliseconds::rep> slow_threshold_ms_;
+    const std::chrono::seconds aggregate_interval_;
+
+    // Набор маршрутов не меняется после запуска io-потоков, поэтому поиск
+    // в нём не требует синхронизации
+    std::unordered_map<std::string, std::unique_ptr<RouteState>, RouteHasher,
+                       std::equal_to<>>
+        routes_;
+    std::unique_ptr<RouteState> unmatched_;
+};
+
+} // namespace http_handler
@@ -11,14 +11,53 @@
 #include <boost/log/utility/setup/console.hpp>
 #include <boost/log/utility/setup/file.hpp>
 
+#include <string>
+
+#include "json_writer.hpp"
+#include "worker_topology.hpp"
+
 namespace json = boost::json;
 namespace logging = boost::log;
 
-BOOST_LOG_ATTRIBUTE_KEYWORD(additional_data, "AdditionalData", json::value)
+// Поле data записи лога - JSON-объект, уже записанный в строку
+// (см. JsonObjectWriter)
+BOOST_LOG_ATTRIBUTE_KEYWORD(additional_data, "AdditionalData", std::string)
 BOOST_LOG_ATTRIBUTE_KEYWORD(timestamp, "TimeStamp", boost::posix_time::ptime)
 
 namespace logs {
 
-void init();
+// Что делать с записью, если очередь асинхронного вывода её потока
+// заполнена
+enum class OverflowPolicy {
+    // Ждать, пока поток вывода освободит место
+    BLOCK,
+    // Отбросить запись. Число отброшенных записей выводится в лог
+    DROP,
+    // Начиная с половины заполнения очереди принимать лишь каждую
+    // sample_rate-ю запись, при полной очереди - отбрасывать
+    SAMPLE,
+};
+
+struct Options {
+    // Максимальное число записей одного потока, ожидающих вывода.
+    // Округляется вверх до степени двойки
+    std::size_t queue_size = 64 * 1024;
+    OverflowPolicy overflow = OverflowPolicy::BLOCK;
+    unsigned sample_rate = 10;
+};
+
+// Записи лога выводятся в stdout отдельным потоком: io-потоки лишь ставят
+// их в собственные очереди без блокировок, а поток вывода форматирует
+// записи и пишет их пачками. Поток вывода при запуске вызывает
+// setup_writer, если она задана
+void init(const Options &options = {},
+          worker_topology::ThreadSetup setup_writer = {});
+
+// Выводит оставшиеся в очереди записи и останавливает поток вывода
+void shutdown();
+
+// Дописывает к out запись лога в формате
+// {"timestamp":"...","data":{...},"message":"..."} и перевод строки
+void FormatRecord(const logging::record_view &rec, std::string &out);
 
 } // namespace logs
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace metrics {
+
+// Счётчики, значения которых только растут
+enum class Counter {
+    BYTES_RECEIVED,
+    BYTES_SENT,
+    ACCEPT_ERRORS,
+    ERRORS_REPORTED,
+    // Сколько раз приём соединений приостанавливался из-за предела сессий
+    ACCEPT_PAUSES,
+    // Отклонённые соединения и запросы по причинам отказа
+    REJECTED_SESSIONS,
+    REJECTED_SESSIONS_PER_IP,
+    REJECTED_REQUESTS,
+    // Выделения памяти из кучи аренами сессий сверх начального буфера
+    ARENA_HEAP_ALLOCATIONS,
+    // Задания, выполненные пулом блокирующего ввода-вывода, и задания, не
+    // поставленные в его заполненную очередь
+    BLOCKING_IO_JOBS,
+    BLOCKING_IO_REJECTED,
+};
+
+// Показатели, значения которых могут как расти, так и уменьшаться
+enum class Gauge {
+    ACTIVE_SESSIONS,
+};
+
+// Задания в очереди пула блокирующего ввода-вывода и занятые ими потоки.
+// Задание ставится в очередь одним потоком, а снимается другим, поэтому эти
+// показатели хранит сам пул: сумма наборов потоков, прочитанных не
+// одновременно, могла бы оказаться отрицательной
+struct BlockingIoGauges {
+    std::size_t queued = 0;
+    std::size_t busy = 0;
+};
+
+// Каждый поток пишет показатели в собственный набор счётчиков, поэтому
+// запись не требует ни блокировок, ни атомарных операций чтения-изменения-
+// записи. Наборы всех потоков суммируются только при чтении в Render
+
+void Increment(Counter counter, std::uint64_t value = 1) noexcept;
+
+void Add(Gauge gauge, std::int64_t delta) noexcept;
+
+// Учитывает время обработки запроса к маршруту route, завершившегося ответом
+// с кодом code. Гистограмма хранит время с точностью до двух интервалов на
+// каждую степень двойки микросекунд.
+// route должен ссылаться на строку, живущую до конца работы сервера
+// (например, на шаблон маршрута в Router)
+void RecordRequest(std::string_view route, unsigned code,
+                   std::chrono::nanoseconds duration);
+
+// Все показатели в текстовом формате Prometheus
+std::string Render(const BlockingIoGauges &blocking_io = {});
+
+} // namespace metrics
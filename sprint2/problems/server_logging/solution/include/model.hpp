@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "model_fwd.hpp"
+#include "road_graph.hpp"
+#include "road_index.hpp"
 #include "tagged.hpp"
 
 namespace model {
@@ -105,6 +107,21 @@ class Map {
 
     const Roads &GetRoads() const noexcept { return roads_; }
 
+    // Граф и индекс строятся методом Compile при добавлении карты в Game,
+    // после чего дороги карты не меняются. GetRoads возвращает дороги в том
+    // виде, в каком они заданы в конфигурации, а движение по карте
+    // рассчитывается по объединённым дорогам графа
+    const RoadGraph &GetRoadGraph() const noexcept { return road_graph_; }
+
+    // Индексы дорог в запросах к индексу - индексы в
+    // GetRoadGraph().GetRoads()
+    const RoadIndex &GetRoadIndex() const noexcept { return road_index_; }
+
+    void Compile() {
+        road_graph_ = RoadGraph{roads_};
+        road_index_ = RoadIndex{road_graph_.GetRoads()};
+    }
+
     const Offices &GetOffices() const noexcept { return offices_; }
 
     void AddRoad(const Road &road) { roads_.emplace_back(road); }
@@ -122,6 +139,8 @@ class Map {
     Id id_;
     std::string name_;
     Roads roads_;
+    RoadGraph road_graph_;
+    RoadIndex road_index_;
     Buildings buildings_;
 
     OfficeIdToIndex warehouse_id_to_index_;
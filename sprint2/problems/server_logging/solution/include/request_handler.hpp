@@ -1,19 +1,51 @@
 #pragma once
 
+#include "blocking_io_pool.hpp"
+#include "file_reader.hpp"
 #include "http_server.hpp"
 #include "json_loader.hpp"
+#include "log_sampling.hpp"
+#include "metrics.hpp"
 #include "model_fwd.hpp"
+#include "response_cache.hpp"
+#include "router.hpp"
+#include "shared_buffer_body.hpp"
+#include "static_content_cache.hpp"
 
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string_view>
+#include <variant>
+#include <vector>
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/bind_executor.hpp>
 
 namespace http_handler {
 
 namespace http = boost::beast::http;
+namespace net = boost::asio;
 
-// Запрос, тело которого представлено в виде строки
-using StringRequest = http::request<http::string_body>;
-// Ответ, тело которого представлено в виде строки
-using StringResponse = http::response<http::string_body>;
+// Запрос, тело которого представлено в виде строки. Запрос и его поля
+// размещаются в арене сессии
+using StringRequest =
+    http::request<http_server::ArenaStringBody, http_server::ArenaFields>;
+// Ответ, тело которого представлено в виде строки. Поля ответов создаются с
+// распределителем запроса и размещаются в той же арене
+using StringResponse =
+    http::response<http::string_body, http_server::ArenaFields>;
+// Ответ, тело которого ссылается на разделяемый неизменяемый буфер
+using SharedBufferResponse =
+    http::response<http_server::SharedBufferBody, http_server::ArenaFields>;
+// Ответ, тело которого отправляется из файла через sendfile
+using FileResponse =
+    http::response<http_server::SendfileBody, http_server::ArenaFields>;
+// Любой из ответов, которые может сформировать RequestHandler
+using Response =
+    std::variant<StringResponse, SharedBufferResponse, FileResponse>;
 
 using std::string_view_literals::operator""sv;
 
@@ -35,13 +67,41 @@ struct ContentType {
     constexpr static auto AUDIO_MPEG = "audio/mpeg"sv;
     constexpr static auto APPLICATION_OCTET_STREAM =
         "application/octet-stream"sv;
+    // Текстовый формат показателей Prometheus
+    constexpr static auto PROMETHEUS_TEXT = "text/plain; version=0.0.4"sv;
 };
 
+// Возвращает Content-Type по расширению файла
+std::string_view GetContentTypeByExtension(std::string extension);
+
+// Проверяет, имеет ли смысл сжимать файл (текст, JSON, XML, SVG)
+bool IsCompressibleFile(const std::filesystem::path &path);
+
 class RequestHandler final {
   public:
     struct Context {
         model::Game &game;
         const std::string static_content_directory_path;
+        // Ограничение на суммарный размер кеша статических файлов, байт
+        const std::size_t static_cache_size;
+        // Файлы не меньше этого размера не кешируются и отправляются
+        // через sendfile
+        const std::uintmax_t sendfile_threshold;
+        // Настройки выборочного логирования, доступные через /admin/
+        LogSampler &log_sampler;
+        // Токен доступа к /admin/. Пустой токен отключает /admin/
+        const std::string admin_token;
+        // Способ чтения с диска файлов статики, которых нет в кеше
+        const FileIo file_io;
+        // Потоки, в которых ищутся, открываются и читаются файлы статики,
+        // которых нет в кеше
+        const BlockingIoPool::Options blocking_io;
+        // Значение Retry-After в ответе 503, когда пул чтения файлов
+        // перегружен. Совпадает с тем, что отправляет AdmissionControl
+        const std::chrono::seconds retry_after{1};
+        // Настройка служебных потоков: пула чтения файлов и наблюдения за
+        // каталогом статики
+        const worker_topology::ThreadSetup setup_service_thread{};
     };
 
   public:
@@ -51,7 +111,15 @@ class RequestHandler final {
     RequestHandler &operator=(RequestHandler &&) = default;
     ~RequestHandler() = default;
 
-    StringResponse operator()(StringRequest &&req);
+    // Обрабатывает запрос и передаёт ответ в reply. Почти все ответы
+    // формируются сразу и передаются до возврата. Ответ на запрос файла
+    // статики, которого нет в кеше, передаётся после обращения к диску через
+    // исполнитель, связанный с reply
+    template <typename Reply>
+    void operator()(StringRequest &&req, Reply &&reply) {
+        const auto match = FindRoute(req);
+        (*this)(std::move(req), match, std::forward<Reply>(reply));
+    }
 
   private:
     RequestHandler() = delete;
@@ -59,15 +127,181 @@ class RequestHandler final {
     RequestHandler &operator=(const RequestHandler &) = delete;
 
   private:
-    StringResponse HandleApiRequest(StringRequest &&);
-    StringResponse ServeStaticFile(StringRequest &&);
-    StringResponse HandleGetRequest(StringRequest &&);
-    StringResponse MakeAllMapsResponse(StringRequest &&);
-    StringResponse MakeCurrentMapResponse(StringRequest &&);
+    // Запрос файла статики, которого нет в кеше
+    struct StaticFileRead {
+        StringRequest req;
+        bool is_head = false;
+        // Ключ кеша - декодированный путь из запроса
+        std::string request_path;
+    };
+
+    // Сведения о файле статики, собранные в пуле блокирующего ввода-вывода
+    struct StaticFileInfo {
+        enum class Status {
+            NOT_FOUND,
+            // Файл вне каталога статики
+            BAD_REQUEST,
+            // Файл отправляется через sendfile. Он открыт, только если
+            // ответ содержит тело: не для HEAD и не для 304 Not Modified
+            SENDFILE,
+            // Файл и его сжатые версии нужно прочитать и закешировать
+            READ,
+        };
+
+        struct File {
+            std::filesystem::path path;
+            http_cache::ContentEncoding encoding =
+                http_cache::ContentEncoding::IDENTITY;
+            std::filesystem::file_time_type last_write_time;
+            // Размер файла. Заполняется только для SENDFILE
+            std::uintmax_t size = 0;
+            // Содержимое прочитанного файла
+            std::optional<std::string> content;
+            // Открытый файл, который прочитается через io_uring. Только для
+            // READ в режиме FileIo::URING
+            OpenedFile opened = {};
+        };
+
+        Status status = Status::NOT_FOUND;
+        std::filesystem::path relative_path;
+        std::string_view content_type;
+        bool compressible = false;
+        // Для READ первым идёт исходный файл, для SENDFILE здесь
+        // единственная отправляемая версия файла
+        std::vector<File> files;
+        http_server::SendfileBody::value_type sendfile;
+        // Получен до обращения к диску. Если файл сбросят из кеша позже,
+        // прочитанное содержимое не кешируется
+        http_cache::StaticContentCache::ReadTicket cache_read;
+    };
+
+    // Загрузка файла статики, которого нет в кеше. Получатель ответа
+    // хранится в наследнике, чтобы состояние загрузки и получатель
+    // размещались одним выделением памяти
+    struct StaticFileLoad {
+        explicit StaticFileLoad(StaticFileRead &&read)
+            : read(std::move(read)) {}
+        virtual ~StaticFileLoad() = default;
+
+        virtual void Reply(Response &&response) = 0;
+
+        StaticFileRead read;
+        StaticFileInfo info;
+        // Сколько файлов ещё читается через io_uring
+        std::size_t remaining = 0;
+    };
+
+    template <typename Callback>
+    struct StaticFileLoadWith final : StaticFileLoad {
+        template <typename C>
+        StaticFileLoadWith(StaticFileRead &&read, C &&callback)
+            : StaticFileLoad(std::move(read)),
+              callback(std::forward<C>(callback)) {}
+
+        void Reply(Response &&response) override {
+            callback(std::move(response));
+        }
+
+        Callback callback;
+    };
+
+    // Поля запроса, нужные для поиска файла в пуле. Копируются, так как
+    // поля самого запроса размещены в арене сессии
+    struct StaticFileHeaders {
+        std::string accept_encoding;
+        std::string if_none_match;
+        std::string if_modified_since;
+        bool is_head = false;
+    };
+
+    // Результат обработки запроса: готовый ответ или файл, который нужно
+    // прочитать, чтобы сформировать ответ
+    using Result = std::variant<Response, StaticFileRead>;
+
+    // Обработчик маршрута. Указатель на метод, а не замыкание с this,
+    // чтобы таблица маршрутов оставалась корректной при перемещении
+    // RequestHandler
+    using RouteHandler = Result (RequestHandler::*)(StringRequest &&,
+                                                    const RouteParams &);
+
+  public:
+    // Маршрут, которому соответствует запрос. Шаблон пути найденного
+    // маршрута - в pattern, он пуст, если маршрута нет
+    using RouteMatch = Router<RouteHandler>::Match;
+
+    RouteMatch FindRoute(const StringRequest &req) const noexcept {
+        return router_.Find(req.method(), req.target());
+    }
+
+    // То же, что operator()(req, reply), для запроса, маршрут которого уже
+    // найден через FindRoute. Параметры match ссылаются на target запроса
+    template <typename Reply>
+    void operator()(StringRequest &&req, const RouteMatch &match,
+                    Reply &&reply) {
+        auto result = Handle(std::move(req), match);
+        if (auto *response = std::get_if<Response>(&result)) {
+            return reply(std::move(*response));
+        }
+
+        const auto executor = net::get_associated_executor(reply);
+        using Load = StaticFileLoadWith<std::decay_t<Reply>>;
+        LoadStaticFile(
+            std::make_shared<Load>(std::get<StaticFileRead>(std::move(result)),
+                                   std::forward<Reply>(reply)),
+            executor);
+    }
+
+  private:
+    Result Handle(StringRequest &&req, const RouteMatch &match);
+
+    Result ServeStaticFile(StringRequest &&, const RouteParams &);
+    Result MakeAllMapsResponse(StringRequest &&, const RouteParams &);
+    Result MakeCurrentMapResponse(StringRequest &&, const RouteParams &);
+    Result MakeBadRequestResponse(StringRequest &&, const RouteParams &);
+    Result GetLogSampling(StringRequest &&, const RouteParams &);
+    Result SetLogSampling(StringRequest &&, const RouteParams &);
+    Result GetMetrics(StringRequest &&, const RouteParams &);
+
+    // Ищет и читает файл в пуле блокирующего ввода-вывода (через io_uring
+    // файл читается уже из executor), помещает его в кеш и передаёт ответ
+    // получателю state через executor. Если очередь пула заполнена, сразу
+    // отвечает 503
+    void LoadStaticFile(std::shared_ptr<StaticFileLoad> state,
+                        const net::any_io_executor &executor);
+    // Находит файл, а также открывает большой файл, если его нужно
+    // отправить, или в режиме FileIo::SYNC читает файл и его сжатые версии.
+    // Выполняется в потоке пула
+    StaticFileInfo OpenStaticFile(const std::string &request_path,
+                                  const StaticFileHeaders &headers) const;
+    // Формирует ответ по собранным сведениям о файле
+    Response MakeLoadedFileResponse(StaticFileRead &read,
+                                    StaticFileInfo &&info);
+    static Response MakeSendfileResponse(const StringRequest &,
+                                         StaticFileInfo &&info);
+
+    bool IsAdminAuthorized(const StringRequest &) const noexcept;
+
+    using StaticFilePtr = http_cache::StaticContentCache::FilePtr;
+    static SharedBufferResponse MakeStaticFileResponse(const StringRequest &,
+                                                       StaticFilePtr);
 
   private:
     model::Game &game_;
     const std::string content_root_;
+    const std::uintmax_t sendfile_threshold_;
+    const FileIo file_io_;
+    // Заполняются в конструкторе и далее только читаются из io-потоков
+    Router<RouteHandler> router_;
+    http_cache::ResponseCache response_cache_;
+    // Ответы с описанием карт по id карты
+    http_cache::ResponseCache map_responses_;
+    std::unique_ptr<http_cache::StaticContentCache> static_cache_;
+    LogSampler &log_sampler_;
+    const std::string admin_token_;
+    const std::string retry_after_;
+    // Объявлен последним, чтобы потоки пула останавливались раньше, чем
+    // разрушаются используемые заданиями поля
+    std::unique_ptr<BlockingIoPool> blocking_io_;
 };
 
 #define TEMPLATE_REQUEST_PREFIX                                                \
@@ -77,38 +311,70 @@ class RequestHandler final {
 class LoggingRequestHandler {
   private:
     static void LogRequest(const http_server::tcp::endpoint endpoint,
-                           const StringRequest &);
+                           std::string_view method, std::string_view target);
     static void LogResponse(const std::chrono::milliseconds,
-                            const StringResponse &);
+                            const Response &);
+    // Учитывает ответ в показателях и логирует его, если запрос попал в
+    // выборку или ответ должен логироваться всегда
+    void RecordResponse(const http_server::tcp::endpoint endpoint,
+                        std::string_view route, bool sampled,
+                        std::string_view method, std::string_view target,
+                        std::chrono::steady_clock::time_point start_time,
+                        const Response &resp);
 
   public:
-    LoggingRequestHandler(RequestHandler &handler_) : decorated_(handler_) {}
+    LoggingRequestHandler(RequestHandler &handler_, LogSampler &sampler)
+        : decorated_(handler_), sampler_(sampler) {}
 
     TEMPLATE_REQUEST_PREFIX
     void operator()([[maybe_unused]] const http_server::tcp::endpoint endpoint,
                     REQUEST_TYPE &&req, Send &&sender) {
-        // Логируем запрос
-        LogRequest(endpoint, req);
+        // Маршрут ищется один раз: он нужен и выборке, и обработчику
+        const auto match = decorated_.FindRoute(req);
+        const auto route = match.pattern;
+        const bool sampled = sampler_.Sample(route);
 
-        // Получаем текущее время
-        auto start_time = std::chrono::steady_clock::now();
-
-        // Обрабатываем запрос
-        auto resp = decorated_(std::forward<REQUEST_TYPE>(req));
+        // Метод и путь не попавшего в выборку запроса сохраняются на случай,
+        // если ответ на него всё же придётся залогировать. Память под них
+        // берётся там же, где размещён запрос
+        using String =
+            std::basic_string<char, std::char_traits<char>, Allocator>;
+        String method{req.get_allocator()};
+        String target{req.get_allocator()};
+        if (sampled) {
+            // Логируем запрос
+            LogRequest(endpoint, req.method_string(), req.target());
+        } else {
+            method = req.method_string();
+            target = req.target();
+        }
 
-        // Получаем время обработки запроса.
-        auto response_time =
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::steady_clock::now() - start_time);
-
-        // Логируем ответ
-        LogResponse(response_time, resp);
+        // Получаем текущее время
+        const auto start_time = std::chrono::steady_clock::now();
 
-        sender(std::move(resp));
+        // Обрабатываем запрос. Ответ на запрос файла статики, читаемого с
+        // диска асинхронно, придёт позже через исполнитель сессии
+        const auto executor = net::get_associated_executor(sender);
+        decorated_(std::forward<REQUEST_TYPE>(req), match,
+                   net::bind_executor(
+                       executor, [this, endpoint, route, sampled, start_time,
+                                  method = std::move(method),
+                                  target = std::move(target),
+                                  sender = std::forward<Send>(sender)](
+                                     Response &&resp) mutable {
+                           RecordResponse(endpoint, route, sampled, method,
+                                          target, start_time, resp);
+                           std::visit(
+                               [&sender](auto &&response) {
+                                   sender(std::move(response));
+                               },
+                               std::move(resp));
+                       }));
     }
 
   private:
     RequestHandler &decorated_;
+    LogSampler &sampler_;
 };
 
 #undef TEMPLATE_REQUEST_PREFIX
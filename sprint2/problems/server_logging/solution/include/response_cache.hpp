@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "conditional_request.hpp"
+
+namespace http_cache {
+
+// Заранее сериализованный ответ на GET-запрос к неизменяемому ресурсу
+struct CachedResponse {
+    // Тело ответа. Разделяется между всеми потоками и никогда не меняется
+    std::shared_ptr<const std::string> body;
+    std::string content_type;
+    // Сильный ETag в кавычках, например "\"3f2a9c0d1b7e6a55\""
+    std::string etag;
+    // Время регистрации ответа и оно же в формате заголовка Last-Modified
+    HttpTime last_modified;
+    std::string last_modified_date;
+
+    std::size_t ContentLength() const noexcept { return body->size(); }
+};
+
+// Кеш готовых ответов для ресурсов, которые не меняются после старта сервера
+// (список карт, описание карты и т.п.).
+// Заполняется методом Register до запуска io-потоков, после чего используется
+// только на чтение, поэтому Find не требует синхронизации.
+class ResponseCache {
+  public:
+    ResponseCache() = default;
+
+    ResponseCache(ResponseCache &&) = default;
+    ResponseCache &operator=(ResponseCache &&) = default;
+
+    // Регистрирует ответ для target. Повторная регистрация того же target
+    // заменяет предыдущий ответ
+    const CachedResponse &Register(std::string target, std::string body,
+                                   std::string_view content_type);
+
+    const CachedResponse *Find(std::string_view target) const noexcept;
+
+    std::size_t Size() const noexcept { return entries_.size(); }
+
+  private:
+    ResponseCache(const ResponseCache &) = delete;
+    ResponseCache &operator=(const ResponseCache &) = delete;
+
+    // Хешер с поддержкой гетерогенного поиска по std::string_view
+    struct TargetHasher {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view target) const noexcept {
+            return std::hash<std::string_view>{}(target);
+        }
+    };
+
+    using Entries = std::unordered_map<std::string, CachedResponse,
+                                       TargetHasher, std::equal_to<>>;
+
+    Entries entries_;
+};
+
+// Вычисляет сильный ETag по содержимому тела ответа
+std::string MakeStrongETag(std::string_view body);
+
+} // namespace http_cache
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "model_fwd.hpp"
+
+namespace model {
+
+// Граф дорог карты, построенный по дорогам из конфигурации.
+// Коллинеарные дороги, которые перекрываются или касаются концами,
+// объединяются в одну. Узлы графа - концы объединённых дорог и их
+// пересечения, рёбра соединяют соседние узлы одной дороги. Смежность хранится
+// в сжатом виде: рёбра всех узлов лежат в одном векторе подряд
+class RoadGraph {
+  public:
+    using NodeIndex = std::uint32_t;
+
+    struct Edge {
+        NodeIndex to;
+        // Индекс объединённой дороги, вдоль которой проходит ребро
+        std::uint32_t road;
+        Dimension length;
+    };
+
+    struct Stats {
+        // Дороги в конфигурации карты
+        std::size_t source_roads = 0;
+        // Дороги после объединения
+        std::size_t roads = 0;
+        std::size_t nodes = 0;
+        // Каждое ребро учитывается один раз, хотя хранится в обоих узлах
+        std::size_t edges = 0;
+    };
+
+    RoadGraph() = default;
+    explicit RoadGraph(const std::vector<Road> &roads);
+
+    // Объединённые дороги. Горизонтальные идут перед вертикальными, и у всех
+    // начало не дальше конца
+    const std::vector<Road> &GetRoads() const noexcept { return roads_; }
+
+    // Узлы упорядочены по x, затем по y
+    const std::vector<Point> &GetNodes() const noexcept { return nodes_; }
+
+    std::span<const Edge> GetEdges(NodeIndex node) const noexcept {
+        return {edges_.data() + edge_offsets_[node],
+                edges_.data() + edge_offsets_[node + 1]};
+    }
+
+    // Узел в точке point, если он есть
+    std::optional<NodeIndex> FindNode(Point point) const noexcept;
+
+    Stats GetStats() const noexcept;
+
+  private:
+    std::vector<Road> roads_;
+    std::vector<Point> nodes_;
+    // Рёбра узла i - edges_[edge_offsets_[i]..edge_offsets_[i + 1])
+    std::vector<std::uint32_t> edge_offsets_;
+    std::vector<Edge> edges_;
+    std::size_t source_roads_ = 0;
+};
+
+} // namespace model
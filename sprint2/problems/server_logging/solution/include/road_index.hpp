@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "model_fwd.hpp"
+
+namespace model {
+
+// Дорога покрывает полосу шириной 0.8 вдоль своей оси
+inline constexpr double ROAD_HALF_WIDTH = 0.4;
+
+// Точка карты с дробными координатами, например положение собаки
+struct Position {
+    double x = 0;
+    double y = 0;
+
+    bool operator==(const Position &) const = default;
+};
+
+// Ось y направлена на юг
+enum class Direction { NORTH, SOUTH, WEST, EAST };
+
+// Индекс дорог карты для запросов по координатам. Дороги сгруппированы по
+// линиям с одинаковой целой координатой оси (y у горизонтальных, x у
+// вертикальных), линии упорядочены по этой координате, а отрезки на линии -
+// по началу. Точка может лежать только на дорогах ближайшей горизонтальной и
+// ближайшей вертикальной линии, поэтому запросы находят их двоичным поиском
+// и не перебирают остальные дороги карты. Дороги линии, покрывающие точку,
+// находятся по дереву интервалов за O(log n + k), даже если дороги на линии
+// перекрываются
+class RoadIndex {
+  public:
+    RoadIndex() = default;
+    explicit RoadIndex(const std::vector<Road> &roads);
+
+    // Вызывает fn(road) для каждой дороги, которой принадлежит точка, где
+    // road - индекс дороги в roads, переданных в конструктор
+    template <typename Fn>
+    void ForEachRoadAt(Position position, Fn &&fn) const {
+        ForEachCovering(horizontal_, position.y, position.x, fn);
+        ForEachCovering(vertical_, position.x, position.y, fn);
+    }
+
+    std::vector<std::size_t> FindRoadsAt(Position position) const;
+
+    bool IsOnRoad(Position position) const;
+
+    // Самая дальняя точка, до которой можно дойти из position в направлении
+    // direction, не сходя с дорог. Если position не на дороге, возвращает её
+    Position GetMaxReachable(Position position, Direction direction) const;
+
+    // Ближайшая к position точка дорог, или std::nullopt, если дорог нет
+    std::optional<Position> FindNearestRoadPoint(Position position) const;
+
+  private:
+    // Дорога вдоль линии: from <= to
+    struct Segment {
+        Coord from;
+        Coord to;
+        std::size_t road;
+    };
+
+    static constexpr std::uint32_t NO_NODE =
+        std::numeric_limits<std::uint32_t>::max();
+
+    // Узел дерева интервалов. Хранит отрезки, содержащие center: отрезки
+    // левого поддерева заканчиваются до center, правого - начинаются после
+    struct Node {
+        Coord center;
+        // Отрезки узла в Line::by_from и Line::by_to
+        std::uint32_t begin;
+        std::uint32_t end;
+        std::uint32_t left = NO_NODE;
+        std::uint32_t right = NO_NODE;
+    };
+
+    struct Line {
+        Coord coord;
+        // По возрастанию from
+        std::vector<Segment> segments;
+        // max_to[i] - наибольший to среди segments[0..i]. По нему находится
+        // ближайшая точка линии
+        std::vector<Coord> max_to;
+        // Дерево интервалов, корень - nodes[0]
+        std::vector<Node> nodes;
+        // Отрезки каждого узла подряд: в by_from по возрастанию from, в
+        // by_to - по убыванию to
+        std::vector<Segment> by_from;
+        std::vector<Segment> by_to;
+    };
+
+    using Lines = std::vector<Line>;
+
+    // Границы полосы, покрываемой дорогой
+    struct Bounds {
+        double min_x, max_x, min_y, max_y;
+    };
+
+    struct Nearest {
+        Position point;
+        double distance;
+    };
+
+    // Линия, на дорогах которой может лежать точка с координатой across
+    // поперёк линий
+    static const Line *FindLine(const Lines &lines, double across) noexcept;
+    // Число отрезков линии, начинающихся не дальше along
+    static std::size_t CountStartingBefore(const Line &line,
+                                           double along) noexcept;
+    static Lines MakeLines(std::vector<std::pair<Coord, Segment>> segments);
+    // Строит поддерево из segments и возвращает индекс его корня
+    static std::uint32_t BuildTree(Line &line, std::vector<Segment> segments);
+    static void FindNearest(const Lines &lines, double across, double along,
+                            bool vertical, std::optional<Nearest> &nearest);
+
+    template <typename Fn>
+    static void ForEachCovering(const Lines &lines, double across,
+                                double along, Fn &fn) {
+        const auto *line = FindLine(lines, across);
+        if (!line) {
+            return;
+        }
+
+        // Точка левее центра покрыта отрезками узла, начинающимися до неё,
+        // правее - заканчивающимися после неё. Поддерево с другой стороны
+        // центра точку не покрывает
+        auto node = line->nodes.empty() ? NO_NODE : 0;
+        while (node != NO_NODE) {
+            const auto &current = line->nodes[node];
+            if (along < current.center) {
+                for (auto i = current.begin;
+                     i < current.end &&
+                     line->by_from[i].from - ROAD_HALF_WIDTH <= along;
+                     ++i) {
+                    fn(line->by_from[i].road);
+                }
+                node = current.left;
+            } else if (along > current.center) {
+                for (auto i = current.begin;
+                     i < current.end &&
+                     line->by_to[i].to + ROAD_HALF_WIDTH >= along;
+                     ++i) {
+                    fn(line->by_to[i].road);
+                }
+                node = current.right;
+            } else {
+                for (auto i = current.begin; i < current.end; ++i) {
+                    fn(line->by_from[i].road);
+                }
+                return;
+            }
+        }
+    }
+
+    Lines horizontal_;
+    Lines vertical_;
+    // Границы каждой дороги по её индексу
+    std::vector<Bounds> bounds_;
+};
+
+} // namespace model
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "sdk.hpp"
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+//
+#include <boost/beast/http/verb.hpp>
+
+namespace http_handler {
+
+namespace http = boost::beast::http;
+
+// Значения параметров пути, извлечённые при сопоставлении запроса с
+// маршрутом. Ссылаются на target запроса, поэтому действительны, пока жив
+// запрос
+class RouteParams {
+  public:
+    static constexpr std::size_t MAX_PARAMS = 8;
+
+    // Значение параметра name или пустая строка, если его нет в маршруте
+    std::string_view Get(std::string_view name) const noexcept {
+        for (std::size_t i = 0; i < size_ && names_; ++i) {
+            if ((*names_)[i] == name) {
+                return values_[i];
+            }
+        }
+        return {};
+    }
+
+    std::string_view operator[](std::size_t index) const noexcept {
+        return values_[index];
+    }
+
+    std::size_t Size() const noexcept { return size_; }
+
+  private:
+    template <typename Handler> friend class Router;
+
+    const std::vector<std::string> *names_ = nullptr;
+    std::array<std::string_view, MAX_PARAMS> values_{};
+    std::size_t size_ = 0;
+};
+
+// Маршрутизатор запросов по методу и пути.
+// Маршруты задаются шаблонами пути из сегментов трёх видов:
+//  - обычный сегмент ("maps") совпадает только с таким же сегментом;
+//  - параметр ("{id}") совпадает с любым одним сегментом;
+//  - остаток ("{*path}", только последним) совпадает с остатком пути.
+// При неоднозначности обычный сегмент предпочтительнее параметра, а
+// параметр - остатка. Маршруты без параметров дополнительно хранятся в
+// хеш-таблице по полному пути, и путь, совпадающий с таким маршрутом,
+// находится без обхода дерева.
+// Таблица строится один раз до начала обработки запросов, после чего
+// Find не выделяет память и не меняет состояние маршрутизатора, поэтому
+// может вызываться из нескольких потоков одновременно.
+template <typename Handler> class Router {
+  public:
+    struct Match {
+        enum class Status {
+            FOUND,
+            // Путь найден, но метод запроса для него не поддерживается
+            METHOD_NOT_ALLOWED,
+            NOT_FOUND,
+        };
+
+        Status status = Status::NOT_FOUND;
+        // Шаблон пути найденного маршрута, например "/api/v1/maps/{id}"
+        std::string_view pattern;
+        const Handler *handler = nullptr;
+        // Значение заголовка Allow для ответа 405
+        std::string_view allow;
+        RouteParams params;
+    };
+
+    Router() = default;
+
+    Router(Router &&) = default;
+    Router &operator=(Router &&) = default;
+
+    // Добавляет маршрут pattern для методов methods. Пустой список методов
+    // означает любой метод
+    Router &AddRoute(std::string_view pattern,
+                     std::initializer_list<http::verb> methods,
+                     Handler handler) {
+        Node *node = root_.get();
+        std::vector<std::string> names;
+        bool literal = true;
+
+        for (auto path = pattern; !path.empty();) {
+            const auto [segment, tail] = SplitSegment(path);
+            path = tail;
+
+            if (segment.starts_with("{*") && segment.ends_with('}')) {
+                if (!path.empty()) {
+                    throw std::invalid_argument(
+                        "Rest parameter must be the last segment");
+                }
+                names.emplace_back(segment.substr(2, segment.size() - 3));
+                node = GetOrCreate(node->rest);
+                literal = false;
+            } else if (segment.starts_with('{') && segment.ends_with('}')) {
+                names.emplace_back(segment.substr(1, segment.size() - 2));
+                node = GetOrCreate(node->param);
+                literal = false;
+            } else {
+                node = GetOrCreateChild(*node, segment);
+            }
+        }
+
+        if (names.size() > RouteParams::MAX_PARAMS) {
+            throw std::invalid_argument("Too many route parameters");
+        }
+
+        if (node->pattern.empty()) {
+            node->pattern = pattern;
+            patterns_.push_back(node->pattern);
+            if (literal) {
+                exact_.emplace(node->pattern, node);
+                exact_lengths_ |= LengthBit(node->pattern.size());
+            }
+        }
+        node->param_names = std::move(names);
+        node->endpoints.push_back(
+            Endpoint{.methods = methods, .handler = std::move(handler)});
+
+        for (const auto method : methods) {
+            if (!node->allow.empty()) {
+                node->allow += ", ";
+            }
+            node->allow += http::to_string(method);
+        }
+
+        return *this;
+    }
+
+    // Ищет обработчик для запроса с методом method к target. Строка запроса
+    // (всё после '?') при сопоставлении не учитывается
+    Match Find(http::verb method, std::string_view target) const noexcept {
+        Match match;
+
+        target = target.substr(0, target.find('?'));
+        if (!target.starts_with('/')) {
+            return match;
+        }
+
+        // Обычный сегмент предпочтительнее параметра, поэтому маршрут без
+        // параметров, совпадающий с путём целиком, нашёлся бы и в дереве
+        const Node *node = nullptr;
+        if (const auto it = (exact_lengths_ & LengthBit(target.size()))
+                                ? exact_.find(target)
+                                : exact_.end();
+            it != exact_.end()) {
+            node = it->second;
+        } else {
+            node = FindNode(*root_, target, match.params);
+        }
+        if (!node) {
+            return match;
+        }
+        match.pattern = node->pattern;
+        match.params.names_ = &node->param_names;
+
+        for (const auto &endpoint : node->endpoints) {
+            if (endpoint.methods.empty() ||
+                std::ranges::find(endpoint.methods, method) !=
+                    endpoint.methods.end()) {
+                match.status = Match::Status::FOUND;
+                match.handler = &endpoint.handler;
+                return match;
+            }
+        }
+
+        match.status = Match::Status::METHOD_NOT_ALLOWED;
+        match.allow = node->allow;
+        return match;
+    }
+
+    // Шаблоны путей всех маршрутов в порядке добавления
+    const std::vector<std::string_view> &Patterns() const noexcept {
+        return patterns_;
+    }
+
+  private:
+    Router(const Router &) = delete;
+    Router &operator=(const Router &) = delete;
+
+    struct Endpoint {
+        std::vector<http::verb> methods;
+        Handler handler;
+    };
+
+    struct Node {
+        // Обычных сегментов у одного узла немного, поэтому линейный поиск
+        // по вектору быстрее хеш-таблицы
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children;
+        std::unique_ptr<Node> param;
+        std::unique_ptr<Node> rest;
+
+        std::vector<Endpoint> endpoints;
+        std::string pattern;
+        std::vector<std::string> param_names;
+        std::string allow;
+    };
+
+    struct PathHasher {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view path) const noexcept {
+            return std::hash<std::string_view>{}(path);
+        }
+    };
+
+    // Бит длины пути в exact_lengths_. Длины от 63 делят один бит
+    static constexpr std::uint64_t LengthBit(std::size_t length) noexcept {
+        return std::uint64_t{1} << std::min<std::size_t>(length, 63);
+    }
+
+    // Отделяет первый сегмент пути "/a/b": возвращает "a" и "/b"
+    static std::pair<std::string_view, std::string_view>
+    SplitSegment(std::string_view path) noexcept {
+        if (path.starts_with('/')) {
+            path.remove_prefix(1);
+        }
+        const auto end = std::min(path.find('/'), path.size());
+        return {path.substr(0, end), path.substr(end)};
+    }
+
+    static Node *GetOrCreate(std::unique_ptr<Node> &node) {
+        if (!node) {
+            node = std::make_unique<Node>();
+        }
+        return node.get();
+    }
+
+    static Node *GetOrCreateChild(Node &node, std::string_view segment) {
+        for (auto &[name, child] : node.children) {
+            if (name == segment) {
+                return child.get();
+            }
+        }
+        return node.children
+            .emplace_back(std::string{segment}, std::make_unique<Node>())
+            .second.get();
+    }
+
+    // Ищет узел с обработчиками для пути path с возвратом: если по обычному
+    // сегменту дальше пройти не удалось, пробуются параметр и остаток
+    static const Node *FindNode(const Node &node, std::string_view path,
+                                RouteParams &params) noexcept {
+        if (path.empty()) {
+            return node.endpoints.empty() ? nullptr : &node;
+        }
+
+        const auto [segment, tail] = SplitSegment(path);
+
+        for (const auto &[name, child] : node.children) {
+            if (name == segment) {
+                if (auto found = FindNode(*child, tail, params)) {
+                    return found;
+                }
+                break;
+            }
+        }
+
+        if (params.size_ == RouteParams::MAX_PARAMS) {
+            return nullptr;
+        }
+
+        if (node.param) {
+            params.values_[params.size_++] = segment;
+            if (auto found = FindNode(*node.param, tail, params)) {
+                return found;
+            }
+            --params.size_;
+        }
+
+        if (node.rest && !node.rest->endpoints.empty()) {
+            params.values_[params.size_++] = path.substr(1);
+            return node.rest.get();
+        }
+
+        return nullptr;
+    }
+
+    // Узлы создаются в куче, чтобы ссылки на них и их строки оставались
+    // действительными при перемещении Router
+    std::unique_ptr<Node> root_ = std::make_unique<Node>();
+    // Ссылаются на строки pattern узлов
+    std::vector<std::string_view> patterns_;
+    // Узлы маршрутов без параметров по их шаблону. Ключи ссылаются на
+    // строки pattern узлов
+    std::unordered_map<std::string_view, const Node *, PathHasher,
+                       std::equal_to<>>
+        exact_;
+    // Биты длин шаблонов в exact_. Путь другой длины не ищется в таблице,
+    // и статике, которая обычно не совпадает ни с одним таким маршрутом,
+    // не приходится платить за хеширование пути
+    std::uint64_t exact_lengths_ = 0;
+};
+
+} // namespace http_handler
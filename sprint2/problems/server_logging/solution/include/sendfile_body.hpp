@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sdk.hpp"
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+//
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+#include <unistd.h>
+
+namespace http_server {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// Тело HTTP-ответа - один или несколько участков открытого файла.
+// Сессии отправляют такое тело напрямую из файла в сокет через
+// sendfile(2) (см. SendBody), не копируя данные в пространство пользователя.
+// writer, читающий файл через pread(2), нужен только для сериализации в
+// произвольный поток.
+struct SendfileBody {
+    // Участок тела: диапазон байт файла или, если text не пуст, служебный
+    // текст (заголовки частей multipart/byteranges)
+    struct Segment {
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+        std::string text = {};
+
+        bool IsText() const noexcept { return !text.empty(); }
+
+        std::uint64_t Size() const noexcept {
+            return IsText() ? text.size() : size;
+        }
+    };
+
+    // Положение байта тела: участок и смещение внутри него
+    struct Position {
+        const Segment *segment;
+        std::uint64_t offset;
+    };
+
+    class value_type {
+      public:
+        value_type() = default;
+
+        value_type(value_type &&) = default;
+        value_type &operator=(value_type &&) = default;
+
+        // Открывает файл path на чтение и выбирает его целиком
+        void Open(const std::filesystem::path &path, beast::error_code &ec) {
+            file_.open(path.c_str(), beast::file_mode::read, ec);
+            if (ec) {
+                return;
+            }
+            file_size_ = file_.size(ec);
+            SelectRange(0, file_size_);
+        }
+
+        // Выбирает для отправки size байт файла, начиная с offset
+        void SelectRange(std::uint64_t offset, std::uint64_t size) {
+            segments_.assign(1, Segment{.offset = offset, .size = size});
+            size_ = size;
+        }
+
+        void SetSegments(std::vector<Segment> segments) {
+            segments_ = std::move(segments);
+            size_ = 0;
+            for (const auto &segment : segments_) {
+                size_ += segment.Size();
+            }
+        }
+
+        int NativeHandle() const noexcept { return file_.native_handle(); }
+
+        std::uint64_t FileSize() const noexcept { return file_size_; }
+
+        std::uint64_t Size() const noexcept { return size_; }
+
+        // Находит участок, содержащий байт тела с номером pos < Size()
+        Position Locate(std::uint64_t pos) const noexcept {
+            for (const auto &segment : segments_) {
+                if (pos < segment.Size()) {
+                    return {&segment, pos};
+                }
+                pos -= segment.Size();
+            }
+            return {nullptr, 0};
+        }
+
+      private:
+        beast::file file_;
+        std::uint64_t file_size_ = 0;
+        std::vector<Segment> segments_;
+        std::uint64_t size_ = 0;
+    };
+
+    static std::uint64_t size(const value_type &body) noexcept {
+        return body.Size();
+    }
+
+    class writer {
+      public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template <bool isRequest, class Fields>
+        writer(const http::header<isRequest, Fields> &,
+               const value_type &body) noexcept
+            : body_(body) {}
+
+        void init(beast::error_code &ec) noexcept { ec = {}; }
+
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code &ec) {
+            const std::uint64_t remain = body_.Size() - sent_;
+            if (remain == 0) {
+                ec = {};
+                return boost::none;
+            }
+
+            const auto [segment, offset] = body_.Locate(sent_);
+            if (segment->IsText()) {
+                ec = {};
+                const auto text = std::string_view{segment->text}.substr(
+                    static_cast<std::size_t>(offset));
+                sent_ += text.size();
+                return {{boost::asio::buffer(text.data(), text.size()),
+                         sent_ < body_.Size()}};
+            }
+
+            if (!buffer_) {
+                buffer_ = std::make_unique<char[]>(BUFFER_SIZE);
+            }
+
+            const auto to_read = static_cast<std::size_t>(
+                std::min<std::uint64_t>(segment->size - offset, BUFFER_SIZE));
+            const ssize_t read = ::pread(body_.NativeHandle(), buffer_.get(),
+                                         to_read, segment->offset + offset);
+            if (read < 0) {
+                ec = {errno, boost::system::system_category()};
+                return boost::none;
+            }
+            if (read == 0) {
+                // Файл стал короче, чем было указано в Content-Length
+                ec = beast::http::error::short_read;
+                return boost::none;
+            }
+
+            ec = {};
+            sent_ += read;
+            return {{boost::asio::buffer(buffer_.get(), read),
+                     sent_ < body_.Size()}};
+        }
+
+      private:
+        static constexpr std::size_t BUFFER_SIZE = 64 * 1024;
+
+        const value_type &body_;
+        std::uint64_t sent_ = 0;
+        // Выделяется при первом чтении: при отправке через sendfile writer
+        // создаётся сериализатором, но тело через него не читается
+        std::unique_ptr<char[]> buffer_;
+    };
+};
+
+// Что делать после вызова SendBody
+enum class SendBodyStatus {
+    // Тело отправлено целиком, или произошла ошибка
+    DONE,
+    // Буфер отправки сокета заполнен - продолжить, когда он освободится
+    WOULD_BLOCK,
+    // Отправлена часть тела - продолжить из нового обработчика, чтобы
+    // io-поток тем временем обслужил другие сессии
+    PARTIAL,
+};
+
+// Отправляет очередную часть тела body в неблокирующий сокет socket, начиная
+// с байта sent: не больше одного фрагмента файла или одного заголовка части
+// multipart/byteranges
+SendBodyStatus SendBody(int socket, const SendfileBody::value_type &body,
+                        std::uint64_t &sent, beast::error_code &ec);
+
+} // namespace http_server
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+
+#include "sdk.hpp"
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+//
+#include <boost/beast/http/fields.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+namespace http_server {
+
+// Распределитель памяти из арены сессии. В отличие от
+// std::pmr::polymorphic_allocator допускает присваивание, которого Beast
+// требует от распределителя полей. Созданный по умолчанию распределитель
+// выделяет память в обычной куче
+template <typename T> class BasicArenaAllocator {
+  public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    BasicArenaAllocator() noexcept = default;
+
+    BasicArenaAllocator(std::pmr::memory_resource *resource) noexcept
+        : resource_(resource) {}
+
+    template <typename U>
+    BasicArenaAllocator(const BasicArenaAllocator<U> &other) noexcept
+        : resource_(other.Resource()) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(
+            resource_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        resource_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    std::pmr::memory_resource *Resource() const noexcept { return resource_; }
+
+    template <typename U>
+    bool operator==(const BasicArenaAllocator<U> &other) const noexcept {
+        return resource_ == other.Resource();
+    }
+
+  private:
+    std::pmr::memory_resource *resource_ = std::pmr::new_delete_resource();
+};
+
+using ArenaAllocator = BasicArenaAllocator<char>;
+// Поля запросов и ответов, размещаемые в арене сессии
+using ArenaFields = boost::beast::http::basic_fields<ArenaAllocator>;
+// Тело-строка, размещаемое в арене сессии
+using ArenaStringBody =
+    boost::beast::http::basic_string_body<char, std::char_traits<char>,
+                                          ArenaAllocator>;
+
+// Арена, из которой сессия выделяет память под запрос, поля ответа и объект,
+// владеющий ответом во время отправки. Освобождение отдельных блоков ничего
+// не стоит, а вся память возвращается разом в Reset, поэтому при обычном
+// keep-alive обмене память на запрос из кучи не выделяется: она берётся из
+// буфера, выделенного один раз при создании сессии
+class SessionArena final : public std::pmr::memory_resource {
+  public:
+    explicit SessionArena(std::size_t initial_size);
+
+    SessionArena(const SessionArena &) = delete;
+    SessionArena &operator=(const SessionArena &) = delete;
+
+    ArenaAllocator GetAllocator() noexcept { return ArenaAllocator{this}; }
+
+    // Возвращает в арену всю выделенную из неё память. К этому моменту все
+    // объекты, размещённые в арене, должны быть уничтожены
+    void Reset() noexcept;
+
+    // Сколько байт выделено с последнего сброса
+    std::size_t BytesAllocated() const noexcept { return allocated_; }
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    std::unique_ptr<std::byte[]> initial_buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+    std::size_t allocated_ = 0;
+};
+
+} // namespace http_server
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include "sdk.hpp"
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+//
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core/basic_stream.hpp>
+
+namespace http_server {
+
+// Параметры, общие для сессий на обработчиках завершения и на корутинах
+
+// Исполнитель сессии. Сокет, поток и таймеры сессии используют его
+// конкретный тип, а не net::any_io_executor: strand не помещается во
+// внутренний буфер any_io_executor, и Asio выделял бы память в куче под
+// каждую копию исполнителя, которую делает асинхронная операция
+using SessionExecutor =
+    boost::asio::strand<boost::asio::io_context::executor_type>;
+using SessionSocket =
+    boost::asio::ip::tcp::socket::rebind_executor<SessionExecutor>::other;
+using SessionStream =
+    boost::beast::basic_stream<boost::asio::ip::tcp, SessionExecutor>;
+using SessionTimer =
+    boost::asio::steady_timer::rebind_executor<SessionExecutor>::other;
+
+// Сколько ждать, пока сокет примет очередную порцию ответа
+inline constexpr auto SEND_TIMEOUT = std::chrono::seconds{30};
+
+// Сколько байт читать за раз в ожидании начала запроса
+inline constexpr std::size_t IDLE_READ_SIZE = 4096;
+
+// Размер начального буфера арены сессии. Его хватает на заголовки обычного
+// запроса и ответа на него
+inline constexpr std::size_t SESSION_ARENA_SIZE = 8 * 1024;
+
+} // namespace http_server
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "sdk.hpp"
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+//
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+namespace http_server {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// Тело HTTP-ответа, ссылающееся на неизменяемый буфер с подсчётом ссылок.
+// Сериализуется без копирования: сериализатор получает const_buffer,
+// указывающий прямо в разделяемый буфер (закешированный JSON, статический
+// файл), а сам буфер живёт, пока на него ссылается хотя бы один ответ.
+struct SharedBufferBody {
+    class value_type {
+      public:
+        value_type() = default;
+
+        explicit value_type(std::shared_ptr<const std::string> data) noexcept
+            : data_(std::move(data)),
+              view_(data_ ? std::string_view{*data_} : std::string_view{}) {}
+
+        // Тело, ссылающееся на часть буфера data
+        value_type(std::shared_ptr<const std::string> data,
+                   std::string_view view) noexcept
+            : data_(std::move(data)), view_(view) {}
+
+        // Тело из нескольких участков, каждый из которых ссылается на data
+        // или extra (например, части multipart/byteranges и их заголовки).
+        // Участки отправляются подряд, без склеивания в один буфер
+        value_type(std::shared_ptr<const std::string> data,
+                   std::shared_ptr<const std::string> extra,
+                   std::vector<std::string_view> pieces) noexcept
+            : data_(std::move(data)), extra_(std::move(extra)),
+              pieces_(std::move(pieces)) {
+            for (const auto piece : pieces_) {
+                size_ += piece.size();
+            }
+        }
+
+        std::size_t Size() const noexcept {
+            return pieces_.empty() ? view_.size() : size_;
+        }
+
+        std::size_t PieceCount() const noexcept {
+            return pieces_.empty() ? 1 : pieces_.size();
+        }
+
+        std::string_view Piece(std::size_t index) const noexcept {
+            return pieces_.empty() ? view_ : pieces_[index];
+        }
+
+      private:
+        std::shared_ptr<const std::string> data_;
+        std::string_view view_;
+
+        std::shared_ptr<const std::string> extra_;
+        std::vector<std::string_view> pieces_;
+        std::size_t size_ = 0;
+    };
+
+    static std::uint64_t size(const value_type &body) noexcept {
+        return body.Size();
+    }
+
+    class writer {
+      public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template <bool isRequest, class Fields>
+        writer(const http::header<isRequest, Fields> &,
+               const value_type &body) noexcept
+            : body_(body) {}
+
+        void init(beast::error_code &ec) noexcept { ec = {}; }
+
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code &ec) noexcept {
+            ec = {};
+            const auto piece = body_.Piece(index_++);
+            return {{boost::asio::buffer(piece.data(), piece.size()),
+                     index_ < body_.PieceCount()}};
+        }
+
+      private:
+        const value_type &body_;
+        std::size_t index_ = 0;
+    };
+};
+
+} // namespace http_server
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "conditional_request.hpp"
+#include "worker_topology.hpp"
+
+namespace http_cache {
+
+// Кодирование (сжатие), в котором хранится содержимое статического файла
+enum class ContentEncoding : char {
+    IDENTITY,
+    GZIP,
+    BROTLI,
+};
+
+// Содержимое статического файла вместе с метаданными, нужными для ответа
+struct StaticFile {
+    std::shared_ptr<const std::string> content;
+    std::string content_type;
+    // ETag, построенный по времени модификации и размеру файла
+    std::string etag;
+    std::filesystem::file_time_type last_write_time;
+    // Значение заголовка Last-Modified
+    std::string last_modified_date;
+    // Путь к исходному (несжатому) файлу относительно корня статики. По нему
+    // находятся записи, которые нужно сбросить при изменении файла
+    std::filesystem::path relative_path;
+    // Для сжатых версий content хранит содержимое соседнего файла
+    // foo.js.gz или foo.js.br
+    ContentEncoding encoding = ContentEncoding::IDENTITY;
+    // Для файла могут существовать сжатые версии, поэтому ответ зависит от
+    // заголовка Accept-Encoding
+    bool vary_by_encoding = false;
+
+    std::size_t Size() const noexcept { return content->size(); }
+
+    HttpTime LastModified() const { return ToHttpTime(last_write_time); }
+};
+
+// Исходный статический файл вместе со всеми его сжатыми версиями. Кешируется
+// и вытесняется целиком, поэтому отсутствие в наборе сжатой версии значит,
+// что её нет на диске
+struct StaticFileSet {
+    using FilePtr = std::shared_ptr<const StaticFile>;
+
+    // Индекс - ContentEncoding. Исходный файл есть всегда
+    std::array<FilePtr, 3> files;
+
+    const FilePtr &Get(ContentEncoding encoding) const noexcept {
+        return files[static_cast<std::size_t>(encoding)];
+    }
+
+    void Set(FilePtr file) {
+        files[static_cast<std::size_t>(file->encoding)] = std::move(file);
+    }
+
+    const std::filesystem::path &RelativePath() const noexcept {
+        return Get(ContentEncoding::IDENTITY)->relative_path;
+    }
+
+    std::size_t Size() const noexcept;
+};
+
+// Кеш статических файлов в памяти с ограничением на суммарный размер и
+// вытеснением давно не использовавшихся записей.
+// Ключ - декодированный путь из запроса, значение - исходный файл вместе со
+// сжатыми версиями.
+// Записи разложены по сегментам со своими мьютексами чтения-записи, поэтому
+// поиски в разных потоках не мешают друг другу. Поиск не переупорядочивает
+// записи, а лишь отмечает запись использованной, и вытеснение работает по
+// алгоритму CLOCK - приближению LRU.
+// Фоновый поток следит за каталогом статики через inotify и сбрасывает
+// записи изменённых файлов, поэтому правки файлов видны без перезапуска
+// сервера.
+class StaticContentCache {
+  public:
+    using FilePtr = StaticFileSet::FilePtr;
+    using FileSetPtr = std::shared_ptr<const StaticFileSet>;
+    // Номер изменения кеша. Увеличивается при каждом сбросе записей
+    using Generation = std::uint64_t;
+
+    StaticContentCache(std::filesystem::path content_root,
+                       std::size_t byte_budget);
+
+    // Возвращает закешированные версии файла и отмечает их как недавно
+    // использованные. Берёт мьютекс сегмента только на чтение
+    FileSetPtr Find(std::string_view request_path);
+
+    // Чтение файла с диска для вставки в кеш. Запоминает номер изменения
+    // до чтения. Пока билет жив, кеш помнит файлы, сброшенные после его
+    // получения, чтобы не вставить их устаревшее содержимое
+    class ReadTicket {
+      public:
+        ReadTicket() = default;
+        ReadTicket(ReadTicket &&other) noexcept
+            : cache_{std::exchange(other.cache_, nullptr)},
+              generation_{other.generation_} {}
+        ReadTicket &operator=(ReadTicket &&other) noexcept {
+            if (this != &other) {
+                Release();
+                cache_ = std::exchange(other.cache_, nullptr);
+                generation_ = other.generation_;
+            }
+            return *this;
+        }
+        ~ReadTicket() { Release(); }
+
+        Generation GetGeneration() const noexcept { return generation_; }
+
+      private:
+        friend class StaticContentCache;
+
+        ReadTicket(StaticContentCache *cache, Generation generation)
+            : cache_{cache}, generation_{generation} {}
+
+        void Release() noexcept;
+
+        StaticContentCache *cache_ = nullptr;
+        Generation generation_ = 0;
+    };
+
+    // Получается до чтения файла с диска и передаётся в Insert
+    ReadTicket BeginRead();
+
+    // Помещает версии файла в кеш. Наборы больше бюджета не кешируются.
+    // Набор не кешируется и в том случае, если после получения билета
+    // файл был сброшен: тогда прочитанное содержимое могло устареть ещё до
+    // вставки
+    void Insert(std::string request_path, FileSetPtr files,
+                const ReadTicket &ticket);
+
+    // Сбрасывает все записи, ссылающиеся на файл relative_path. Изменение
+    // сжатой версии foo.js.gz сбрасывает и записи файла foo.js
+    void Invalidate(const std::filesystem::path &relative_path);
+
+    void Clear();
+
+    // Запускает фоновое наблюдение за изменениями в каталоге статики.
+    // Поток наблюдения при запуске вызывает setup_thread, если она задана
+    void StartWatching(worker_topology::ThreadSetup setup_thread = {});
+
+  private:
+    StaticContentCache(const StaticContentCache &) = delete;
+    StaticContentCache &operator=(const StaticContentCache &) = delete;
+
+    struct KeyHasher {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view key) const noexcept {
+            return std::hash<std::string_view>{}(key);
+        }
+    };
+
+    static constexpr std::size_t SHARD_COUNT = 16;
+
+    // Ключи сегмента по кругу. Стрелка вытеснения обходит круг и вытесняет
+    // первую запись, не использованную с прошлого обхода
+    using Clock = std::list<std::string>;
+
+    struct Entry {
+        FileSetPtr files;
+        Clock::iterator clock_position;
+        // Выставляется поиском под мьютексом сегмента на чтение
+        std::atomic<bool> referenced{false};
+    };
+
+    using Entries = std::unordered_map<std::string, Entry, KeyHasher,
+                                       std::equal_to<>>;
+
+    struct Shard {
+        std::shared_mutex mutex;
+        Entries entries;
+        Clock clock;
+        Clock::iterator hand = clock.end();
+    };
+
+    Shard &GetShard(std::string_view request_path) noexcept;
+    // Требуют мьютекса кеша и мьютекса сегмента на запись
+    void EraseLocked(Shard &shard, Entries::iterator it);
+    // Вытесняет первую неиспользованную запись от стрелки до конца круга.
+    // Возвращает false, если стрелка дошла до конца круга
+    bool EvictOneLocked(Shard &shard);
+    void EndRead(Generation generation) noexcept;
+    // Забывает сброшенные файлы, которые не застало ни одно незавершённое
+    // чтение. Требует мьютекса кеша
+    void PruneInvalidatedLocked();
+    void Watch(std::stop_token stop_token);
+
+  private:
+    const std::filesystem::path content_root_;
+    const std::size_t byte_budget_;
+
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    // Защищает поля ниже. Вставка и сброс записей берут его раньше
+    // мьютексов сегментов, поэтому сброс не пересекается со вставкой
+    std::mutex mutex_;
+    std::size_t used_bytes_ = 0;
+    // Сегмент, с которого начнётся следующее вытеснение
+    std::size_t evict_shard_ = 0;
+    Generation generation_ = 0;
+    // Номер изменения, при котором был сброшен каждый файл (по пути
+    // относительно корня статики). Нужен, лишь пока идут чтения, начатые
+    // раньше сброса
+    std::unordered_map<std::string, Generation> invalidated_;
+    // Число незавершённых чтений по номеру изменения, при котором они
+    // начались
+    std::map<Generation, std::size_t> reads_in_flight_;
+    // Номер изменения, при котором кеш был очищен целиком
+    Generation cleared_ = 0;
+
+    // Объявлен последним, чтобы при разрушении кеша поток наблюдения
+    // останавливался раньше, чем разрушаются используемые им поля
+    std::jthread watcher_;
+};
+
+// Вычисляет ETag статического файла по времени модификации и размеру
+std::string MakeFileETag(std::filesystem::file_time_type last_write_time,
+                         std::uintmax_t size);
+
+} // namespace http_cache
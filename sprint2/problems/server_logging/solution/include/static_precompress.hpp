@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace http_handler {
+
+// Создаёт рядом со сжимаемыми статическими файлами их gzip-версии
+// (foo.js -> foo.js.gz), если те отсутствуют или старше исходного файла.
+// Сжатая версия сохраняется, только если она меньше исходного файла.
+// Возвращает количество созданных файлов
+std::size_t PrecompressStaticFiles(const std::filesystem::path &content_root);
+
+} // namespace http_handler
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace worker_topology {
+
+// Размещение рабочих потоков сервера
+struct Options {
+    // Привязать каждый рабочий поток к своему ядру
+    bool pin_threads = false;
+    // Число первых доступных процессу ядер, на которые рабочие потоки не
+    // назначаются. Их занимают ОС, служебные потоки сервера (вывод лога,
+    // блокирующий ввод-вывод, наблюдение за статикой) и прочие процессы
+    unsigned reserved_cores = 0;
+    // Выделять память потока преимущественно на узле NUMA его ядра
+    bool numa_local = false;
+};
+
+// Настраивает только что запущенный служебный поток с именем name.
+// Передаётся компонентам, которые запускают свои потоки
+using ThreadSetup = std::function<void(std::string_view name)>;
+
+// Назначает рабочим потокам ядра из множества, доступного процессу
+// (sched_getaffinity учитывает taskset и ограничения cgroup).
+// Если ядер меньше, чем потоков, ядра назначаются по кругу.
+// Служебные потоки размещаются на зарезервированных ядрах
+class WorkerTopology {
+  public:
+    // Выбрасывает std::runtime_error, если при включённой привязке
+    // зарезервированы все доступные ядра и рабочим потокам не осталось ни
+    // одного
+    explicit WorkerTopology(const Options &options);
+
+    // Настраивает текущий поток как рабочий поток с номером index: задаёт
+    // имя, видимое в top и perf, привязывает к ядру и узлу NUMA.
+    // Ошибки настройки логируются и не прерывают работу потока
+    void Apply(unsigned index) const;
+
+    // Настраивает текущий поток как служебный: задаёт имя и при
+    // pin_threads привязывает ко всем зарезервированным ядрам сразу, чтобы
+    // служебные потоки не вытесняли рабочие с их ядер
+    void ApplyService(std::string_view name) const;
+
+    // ThreadSetup, вызывающий ApplyService у копии размещения, поэтому
+    // не зависящий от времени жизни этого объекта
+    ThreadSetup MakeServiceSetup() const;
+
+  private:
+    Options options_;
+    std::vector<int> cpus_;
+    std::vector<int> reserved_cpus_;
+};
+
+} // namespace worker_topology
@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# Создаёт сжатые версии (foo.js.gz, foo.js.br) для сжимаемых статических файлов.
+# Сервер отдаёт их клиентам, поддерживающим соответствующий Content-Encoding.
+# Использование: ./precompress_static.sh [static-content-directory]
+
+STATIC_DIR=${1:-$(dirname "$0")/static}
+
+find "$STATIC_DIR" -type f \
+  \( -iname '*.htm' -o -iname '*.html' -o -iname '*.css' -o -iname '*.txt' \
+  -o -iname '*.js' -o -iname '*.json' -o -iname '*.xml' -o -iname '*.svg' \) \
+  -print0 |
+while IFS= read -r -d '' file; do
+  gzip -k -f -9 -n "$file"
+  if command -v brotli > /dev/null; then
+    brotli -k -f -q 11 "$file"
+  fi
+done
@@ -0,0 +1,197 @@
+#include "admission.hpp"
+
+#include <boost/beast/http/field.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "metrics.hpp"
+
+namespace http_server {
+
+using namespace std::literals;
+namespace http = boost::beast::http;
+
+size_t AdmissionControl::AddressHasher::operator()(
+    const boost::asio::ip::address &address) const noexcept {
+    if (address.is_v4()) {
+        return std::hash<std::uint32_t>{}(address.to_v4().to_uint());
+    }
+    const auto bytes = address.to_v6().to_bytes();
+    return std::hash<std::string_view>{}(
+        {reinterpret_cast<const char *>(bytes.data()), bytes.size()});
+}
+
+AdmissionControl::AdmissionControl() : AdmissionControl(Limits{}) {}
+
+AdmissionControl::SessionPermit::SessionPermit(SessionPermit &&other) noexcept
+    : control_(std::exchange(other.control_, nullptr)),
+      address_(std::move(other.address_)) {}
+
+AdmissionControl::SessionPermit &
+AdmissionControl::SessionPermit::operator=(SessionPermit &&other) noexcept {
+    if (this != &other) {
+        if (control_) {
+            control_->ReleaseSession(address_);
+        }
+        control_ = std::exchange(other.control_, nullptr);
+        address_ = std::move(other.address_);
+    }
+    return *this;
+}
+
+AdmissionControl::SessionPermit::~SessionPermit() {
+    if (control_) {
+        control_->ReleaseSession(address_);
+    }
+}
+
+AdmissionControl::RequestPermit &
+AdmissionControl::RequestPermit::operator=(RequestPermit &&other) noexcept {
+    if (this != &other) {
+        if (control_) {
+            control_->ReleaseRequest();
+        }
+        control_ = std::exchange(other.control_, nullptr);
+    }
+    return *this;
+}
+
+AdmissionControl::RequestPermit::~RequestPermit() {
+    if (control_) {
+        control_->ReleaseRequest();
+    }
+}
+
+bool AdmissionControl::TryAcquire(std::atomic<std::size_t> &counter,
+                                  std::size_t limit) noexcept {
+    if (limit == 0) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    auto value = counter.load(std::memory_order_relaxed);
+    do {
+        if (value >= limit) {
+            return false;
+        }
+    } while (!counter.compare_exchange_weak(value, value + 1,
+                                            std::memory_order_relaxed));
+    return true;
+}
+
+bool AdmissionControl::WaitForSessionSlot(std::function<void()> on_slot) {
+    if (limits_.max_sessions == 0) {
+        return false;
+    }
+
+    // Проверка и постановка в очередь выполняются под мьютексом, который
+    // захватывает и ReleaseSession после уменьшения sessions_, поэтому
+    // освобождение места не может проскочить между ними незамеченным
+    std::lock_guard lock{mutex_};
+    if (stopped_) {
+        return true;
+    }
+    if (sessions_.load(std::memory_order_relaxed) < limits_.max_sessions) {
+        return false;
+    }
+    waiters_.push_back(std::move(on_slot));
+    metrics::Increment(metrics::Counter::ACCEPT_PAUSES);
+    return true;
+}
+
+void AdmissionControl::Stop() {
+    std::vector<std::function<void()>> waiters;
+    {
+        std::lock_guard lock{mutex_};
+        stopped_ = true;
+        waiters.swap(waiters_);
+    }
+}
+
+AdmissionControl::SessionPermit
+AdmissionControl::AdmitSession(const boost::asio::ip::address &address) {
+    // Несколько acceptor'ов могут одновременно принять по соединению, когда
+    // осталось одно место
+    if (!TryAcquire(sessions_, limits_.max_sessions)) {
+        metrics::Increment(metrics::Counter::REJECTED_SESSIONS);
+        return {};
+    }
+
+    if (limits_.max_sessions_per_ip != 0) {
+        bool admitted = false;
+        {
+            std::lock_guard lock{mutex_};
+            auto &count = sessions_per_ip_[address];
+            if (count < limits_.max_sessions_per_ip) {
+                ++count;
+                admitted = true;
+            }
+        }
+        if (!admitted) {
+            metrics::Increment(metrics::Counter::REJECTED_SESSIONS_PER_IP);
+            ReleaseSessionSlot();
+            return {};
+        }
+    }
+
+    return SessionPermit{this, address};
+}
+
+void AdmissionControl::ReleaseSession(const boost::asio::ip::address &address) {
+    if (limits_.max_sessions_per_ip != 0) {
+        std::lock_guard lock{mutex_};
+        if (auto it = sessions_per_ip_.find(address);
+            it != sessions_per_ip_.end() && --it->second == 0) {
+            sessions_per_ip_.erase(it);
+        }
+    }
+
+    ReleaseSessionSlot();
+}
+
+void AdmissionControl::ReleaseSessionSlot() {
+    sessions_.fetch_sub(1, std::memory_order_relaxed);
+    if (limits_.max_sessions == 0) {
+        return;
+    }
+
+    std::vector<std::function<void()>> waiters;
+    {
+        std::lock_guard lock{mutex_};
+        waiters.swap(waiters_);
+    }
+
+    for (auto &waiter : waiters) {
+        waiter();
+    }
+}
+
+AdmissionControl::RequestPermit AdmissionControl::AdmitRequest() noexcept {
+    if (!TryAcquire(in_flight_, limits_.max_in_flight)) {
+        metrics::Increment(metrics::Counter::REJECTED_REQUESTS);
+        return RequestPermit{};
+    }
+    return RequestPermit{this};
+}
+
+void AdmissionControl::ReleaseRequest() noexcept {
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+http::response<http::string_body>
+AdmissionControl::MakeRejection(unsigned http_version) const {
+    http::response<http::string_body> response{
+        http::status::service_unavailable, http_version};
+    response.set(http::field::content_type, "application/json"sv);
+    response.set(http::field::retry_after,
+                 std::to_string(limits_.retry_after.count()));
+    response.body() =
+        R"({"code":"serviceUnavailable","message":"Server is overloaded"})"sv;
+    response.prepare_payload();
+    response.keep_alive(false);
+    return response;
+}
+
+} // namespace http_server
@@ -0,0 +1,69 @@
+#include "blocking_io_pool.hpp"
+
+#include <string>
+
+namespace http_handler {
+
+BlockingIoPool::BlockingIoPool(const Options &options,
+                               worker_topology::ThreadSetup setup_thread)
+    : max_queued_(options.max_queued) {
+    threads_.reserve(options.threads);
+    for (unsigned i = 0; i < options.threads; ++i) {
+        threads_.emplace_back([this, i, setup_thread](
+                                  std::stop_token stop_token) {
+            if (setup_thread) {
+                setup_thread("blocking-io-" + std::to_string(i));
+            }
+            Work(std::move(stop_token));
+        });
+    }
+}
+
+bool BlockingIoPool::Submit(std::function<void()> job) {
+    if (threads_.empty()) {
+        job();
+        metrics::Increment(metrics::Counter::BLOCKING_IO_JOBS);
+        return true;
+    }
+
+    {
+        std::lock_guard lock{mutex_};
+        if (jobs_.size() >= max_queued_) {
+            metrics::Increment(metrics::Counter::BLOCKING_IO_REJECTED);
+            return false;
+        }
+        jobs_.push_back(std::move(job));
+        queued_.fetch_add(1, std::memory_order_relaxed);
+    }
+    has_jobs_.notify_one();
+    return true;
+}
+
+metrics::BlockingIoGauges BlockingIoPool::GetGauges() const noexcept {
+    return {.queued = queued_.load(std::memory_order_relaxed),
+            .busy = busy_.load(std::memory_order_relaxed)};
+}
+
+void BlockingIoPool::Work(std::stop_token stop_token) {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock{mutex_};
+            // Оставшиеся в очереди задания при остановке не выполняются
+            if (!has_jobs_.wait(lock, stop_token,
+                                [this] { return !jobs_.empty(); })) {
+                return;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        busy_.fetch_add(1, std::memory_order_relaxed);
+        job();
+        busy_.fetch_sub(1, std::memory_order_relaxed);
+        metrics::Increment(metrics::Counter::BLOCKING_IO_JOBS);
+    }
+}
+
+} // namespace http_handler
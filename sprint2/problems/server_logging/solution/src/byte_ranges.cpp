@@ -0,0 +1,158 @@
+#include "byte_ranges.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <charconv>
+#include <optional>
+#include <random>
+
+namespace http_handler {
+
+using namespace std::string_view_literals;
+
+namespace {
+
+// Большее число диапазонов в одном запросе не обслуживается: такие запросы
+// почти всегда означают попытку нагрузить сервер
+constexpr std::size_t MAX_RANGES = 16;
+
+std::optional<std::uint64_t> ParseNumber(std::string_view str) {
+    std::uint64_t value = 0;
+    const char *str_end = str.data() + str.size();
+    auto [end, ec] = std::from_chars(str.data(), str_end, value);
+    if (str.empty() || ec != std::errc{} || end != str_end) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::string MakeBoundary() {
+    thread_local std::mt19937_64 generator{std::random_device{}()};
+
+    constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+
+    std::string boundary = "byteranges_";
+    for (auto value = generator(); value != 0; value >>= 4) {
+        boundary += HEX_DIGITS[value & 0xF];
+    }
+    return boundary;
+}
+
+} // namespace
+
+RangeRequest ParseRange(std::string_view range, std::uint64_t size) {
+    constexpr auto UNIT = "bytes="sv;
+
+    range = boost::algorithm::trim_copy(range);
+    if (!boost::algorithm::istarts_with(range, UNIT)) {
+        return {};
+    }
+    range.remove_prefix(UNIT.size());
+
+    RangeRequest request;
+    std::size_t specs_count = 0;
+
+    while (!range.empty()) {
+        const auto comma = range.find(',');
+        const auto spec = boost::algorithm::trim_copy(range.substr(0, comma));
+        range.remove_prefix(comma == std::string_view::npos ? range.size()
+                                                            : comma + 1);
+
+        if (++specs_count > MAX_RANGES) {
+            return {};
+        }
+
+        const auto dash = spec.find('-');
+        if (dash == std::string_view::npos) {
+            return {};
+        }
+
+        const auto first_str = spec.substr(0, dash);
+        const auto last_str = spec.substr(dash + 1);
+
+        if (first_str.empty()) {
+            // "-N" - последние N байт
+            const auto suffix_length = ParseNumber(last_str);
+            if (!suffix_length) {
+                return {};
+            }
+            if (*suffix_length > 0 && size > 0) {
+                request.ranges.push_back(
+                    {.first = size - std::min(*suffix_length, size),
+                     .last = size - 1});
+            }
+            continue;
+        }
+
+        const auto first = ParseNumber(first_str);
+        const auto last =
+            last_str.empty() ? std::optional{size - 1} : ParseNumber(last_str);
+        if (!first || !last || (!last_str.empty() && *last < *first)) {
+            return {};
+        }
+
+        if (*first < size) {
+            request.ranges.push_back(
+                {.first = *first, .last = std::min(*last, size - 1)});
+        }
+    }
+
+    if (specs_count == 0) {
+        return {};
+    }
+
+    request.status = request.ranges.empty()
+                         ? RangeRequest::Status::NOT_SATISFIABLE
+                         : RangeRequest::Status::SATISFIABLE;
+    return request;
+}
+
+std::string MakeContentRange(const ByteRange &range, std::uint64_t size) {
+    return "bytes " + std::to_string(range.first) + '-' +
+           std::to_string(range.last) + '/' + std::to_string(size);
+}
+
+std::string MakeUnsatisfiedContentRange(std::uint64_t size) {
+    return "bytes */" + std::to_string(size);
+}
+
+std::uint64_t
+MultipartFraming::BodySize(const std::vector<ByteRange> &ranges) const {
+    std::uint64_t body_size = closing.size();
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        body_size += part_headers[i].size() + ranges[i].Size();
+    }
+    return body_size;
+}
+
+MultipartFraming MakeMultipartFraming(const std::vector<ByteRange> &ranges,
+                                      std::string_view content_type,
+                                      std::uint64_t size) {
+    const auto boundary = MakeBoundary();
+
+    MultipartFraming framing{
+        .content_type = "multipart/byteranges; boundary=" + boundary,
+        .part_headers = {},
+        .closing = "\r\n--" + boundary + "--\r\n",
+    };
+
+    framing.part_headers.reserve(ranges.size());
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        // Первая часть начинается сразу с разделителя, остальные - с перевода
+        // строки, завершающего предыдущую часть
+        std::string header = i == 0 ? "--" : "\r\n--";
+        header += boundary;
+        header += "\r\nContent-Type: ";
+        header += content_type;
+        header += "\r\nContent-Range: ";
+        header += MakeContentRange(ranges[i], size);
+        header += "\r\n\r\n";
+
+        framing.part_headers.push_back(std::move(header));
+    }
+
+    return framing;
+}
+
+} // namespace http_handler
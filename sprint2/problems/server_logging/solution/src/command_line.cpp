@@ -0,0 +1,257 @@
+#include "command_line.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+
+namespace command_line {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr std::size_t DEFAULT_STATIC_CACHE_SIZE = 64 * 1024 * 1024;
+constexpr std::uintmax_t DEFAULT_SENDFILE_THRESHOLD = 1024 * 1024;
+
+logs::OverflowPolicy ParseOverflowPolicy(std::string_view policy) {
+    if (policy == "block"sv) {
+        return logs::OverflowPolicy::BLOCK;
+    }
+    if (policy == "drop"sv) {
+        return logs::OverflowPolicy::DROP;
+    }
+    if (policy == "sample"sv) {
+        return logs::OverflowPolicy::SAMPLE;
+    }
+    throw std::runtime_error("Unknown log overflow policy: "s +
+                             std::string{policy});
+}
+
+http_server::SessionEngine ParseSessionEngine(std::string_view engine) {
+    if (engine == "callbacks"sv) {
+        return http_server::SessionEngine::CALLBACKS;
+    }
+    if (engine == "coroutines"sv) {
+        return http_server::SessionEngine::COROUTINES;
+    }
+    throw std::runtime_error("Unknown session engine: "s + std::string{engine});
+}
+
+http_handler::FileIo ParseFileIo(std::string_view file_io) {
+    if (file_io == "sync"sv) {
+        return http_handler::FileIo::SYNC;
+    }
+    if (file_io == "uring"sv) {
+        if (!http_handler::IsUringFileIoSupported()) {
+            throw std::runtime_error(
+                "io_uring support is not built in, rebuild with "
+                "-DGAME_SERVER_IO_URING=ON"s);
+        }
+        return http_handler::FileIo::URING;
+    }
+    throw std::runtime_error("Unknown file I/O mode: "s + std::string{file_io});
+}
+
+} // namespace
+
+std::optional<Args> ParseCommandLine(int argc, const char *const argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description desc{
+        "Usage: game_server <game-config-json> <static-content-directory> "
+        "[options]\nAllowed options"s};
+
+    Args args;
+    std::string log_overflow;
+    std::string session_engine;
+    std::string file_io;
+    unsigned request_log_slow_ms = 0;
+    unsigned request_log_interval = 0;
+    unsigned idle_timeout = 0;
+    unsigned header_timeout = 0;
+    unsigned body_timeout = 0;
+    unsigned retry_after = 0;
+    // clang-format off
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("config-file,c", po::value(&args.config_file)->value_name("file"),
+            "set config file path")
+        ("www-root,w", po::value(&args.www_root)->value_name("dir"),
+            "set static files root")
+        ("static-cache-size",
+            po::value(&args.static_cache_size)
+                ->default_value(DEFAULT_STATIC_CACHE_SIZE)
+                ->value_name("bytes"),
+            "set static files cache size limit")
+        ("sendfile-threshold",
+            po::value(&args.sendfile_threshold)
+                ->default_value(DEFAULT_SENDFILE_THRESHOLD)
+                ->value_name("bytes"),
+            "send static files of at least this size with sendfile")
+        ("file-io",
+            po::value(&file_io)
+                ->default_value("sync"s)
+                ->value_name("sync|uring"),
+            "read static files missing from the cache in blocking I/O "
+            "threads or asynchronously with io_uring")
+        ("blocking-io-threads",
+            po::value(&args.blocking_io.threads)
+                ->default_value(args.blocking_io.threads)
+                ->value_name("count"),
+            "set number of threads looking up and reading static files "
+            "(0 - in io threads)")
+        ("blocking-io-queue",
+            po::value(&args.blocking_io.max_queued)
+                ->default_value(args.blocking_io.max_queued)
+                ->value_name("jobs"),
+            "answer 503 to static file requests while this many wait for a "
+            "blocking I/O thread")
+        ("precompress-static",
+            po::bool_switch(&args.precompress_static),
+            "create gzip versions of compressible static files on start")
+        ("threads",
+            po::value(&args.threads)->default_value(0)->value_name("count"),
+            "set number of worker threads (0 - one per hardware thread)")
+        ("reuse-port",
+            po::bool_switch(&args.reuse_port),
+            "run an io_context and a SO_REUSEPORT acceptor per worker thread")
+        ("session-engine",
+            po::value(&session_engine)
+                ->default_value("callbacks"s)
+                ->value_name("callbacks|coroutines"),
+            "serve connections with completion handler chains or with a "
+            "coroutine per connection (slower, see README.md)")
+        ("max-sessions",
+            po::value(&args.admission.max_sessions)
+                ->default_value(0)
+                ->value_name("count"),
+            "stop accepting connections at this many open sessions "
+            "(0 - no limit)")
+        ("max-sessions-per-ip",
+            po::value(&args.admission.max_sessions_per_ip)
+                ->default_value(0)
+                ->value_name("count"),
+            "reject connections from a client address with this many open "
+            "sessions (0 - no limit)")
+        ("max-in-flight",
+            po::value(&args.admission.max_in_flight)
+                ->default_value(0)
+                ->value_name("count"),
+            "reject requests while this many are being handled (0 - no limit)")
+        ("pipeline-depth",
+            po::value(&args.admission.max_pipeline_depth)
+                ->default_value(args.admission.max_pipeline_depth)
+                ->value_name("count"),
+            "set max number of pipelined requests of a connection waiting "
+            "for responses")
+        ("idle-timeout",
+            po::value(&idle_timeout)->default_value(30)->value_name("seconds"),
+            "close keep-alive connections idle for this long")
+        ("header-timeout",
+            po::value(&header_timeout)
+                ->default_value(30)
+                ->value_name("seconds"),
+            "set time limit for reading request headers")
+        ("body-timeout",
+            po::value(&body_timeout)->default_value(30)->value_name("seconds"),
+            "set time limit for reading a request body")
+        ("retry-after",
+            po::value(&retry_after)->default_value(1)->value_name("seconds"),
+            "set Retry-After of responses to rejected connections and requests")
+        ("pin-threads",
+            po::bool_switch(&args.topology.pin_threads),
+            "pin each worker thread to its own core")
+        ("reserved-cores",
+            po::value(&args.topology.reserved_cores)
+                ->default_value(0)
+                ->value_name("count"),
+            "reserve this many first available cores for log, file I/O and "
+            "static watcher threads")
+        ("numa-local",
+            po::bool_switch(&args.topology.numa_local),
+            "prefer allocating worker memory on the core's NUMA node")
+        ("log-queue-size",
+            po::value(&args.log.queue_size)
+                ->default_value(args.log.queue_size)
+                ->value_name("records"),
+            "set max number of log records per thread waiting for output")
+        ("log-overflow",
+            po::value(&log_overflow)
+                ->default_value("block"s)
+                ->value_name("block|drop|sample"),
+            "set what to do with log records when the log queue is full")
+        ("log-sample-rate",
+            po::value(&args.log.sample_rate)
+                ->default_value(args.log.sample_rate)
+                ->value_name("n"),
+            "keep every n-th log record when sampling")
+        ("request-log-rate",
+            po::value(&args.request_log.default_rate)
+                ->default_value(args.request_log.default_rate)
+                ->value_name("n"),
+            "log every n-th request (errors and slow ones are always logged)")
+        ("request-log-slow",
+            po::value(&request_log_slow_ms)
+                ->default_value(args.request_log.slow_threshold.count())
+                ->value_name("ms"),
+            "always log requests handled at least this long")
+        ("request-log-interval",
+            po::value(&request_log_interval)
+                ->default_value(args.request_log.aggregate_interval.count())
+                ->value_name("seconds"),
+            "set how often to log summaries of requests left out of the log")
+        ("admin-token",
+            po::value(&args.admin_token)->value_name("token"),
+            "enable /admin/ endpoints accessible with this bearer token");
+    // clang-format on
+
+    // Для совместимости путь к конфигу и каталог статики можно передать
+    // позиционными аргументами
+    po::positional_options_description positional;
+    positional.add("config-file", 1).add("www-root", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv)
+                  .options(desc)
+                  .positional(positional)
+                  .run(),
+              vm);
+    po::notify(vm);
+
+    if (vm.contains("help"s)) {
+        std::cout << desc;
+        return std::nullopt;
+    }
+
+    if (!vm.contains("config-file"s)) {
+        throw std::runtime_error("Config file path is not specified"s);
+    }
+
+    if (!vm.contains("www-root"s)) {
+        throw std::runtime_error("Static files root is not specified"s);
+    }
+
+    if (args.admission.max_pipeline_depth == 0) {
+        throw std::runtime_error("Pipeline depth must be positive"s);
+    }
+    if (request_log_interval == 0) {
+        throw std::runtime_error("Request log interval must be positive"s);
+    }
+    args.session_engine = ParseSessionEngine(session_engine);
+    args.file_io = ParseFileIo(file_io);
+    args.admission.idle_timeout = std::chrono::seconds{idle_timeout};
+    args.admission.header_timeout = std::chrono::seconds{header_timeout};
+    args.admission.body_timeout = std::chrono::seconds{body_timeout};
+    args.admission.retry_after = std::chrono::seconds{retry_after};
+    args.log.overflow = ParseOverflowPolicy(log_overflow);
+    args.request_log.slow_threshold =
+        std::chrono::milliseconds{request_log_slow_ms};
+    args.request_log.aggregate_interval =
+        std::chrono::seconds{request_log_interval};
+
+    return args;
+}
+
+} // namespace command_line
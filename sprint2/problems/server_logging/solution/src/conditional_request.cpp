@@ -0,0 +1,91 @@
+#include "conditional_request.hpp"
+
+#include <boost/algorithm/string/trim.hpp>
+
+#include <ctime>
+
+namespace http_cache {
+
+using namespace std::string_view_literals;
+
+namespace {
+
+constexpr auto HTTP_DATE_FORMAT = "%a, %d %b %Y %H:%M:%S GMT";
+
+std::string_view WithoutWeakPrefix(std::string_view etag) {
+    if (etag.starts_with("W/"sv)) {
+        etag.remove_prefix(2);
+    }
+    return etag;
+}
+
+} // namespace
+
+HttpTime ToHttpTime(std::filesystem::file_time_type file_time) {
+    return std::chrono::floor<std::chrono::seconds>(
+        std::chrono::file_clock::to_sys(file_time));
+}
+
+std::string FormatHttpDate(HttpTime time) {
+    const std::time_t t = std::chrono::system_clock::to_time_t(time);
+
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+
+    char buffer[64];
+    const auto length =
+        std::strftime(buffer, sizeof(buffer), HTTP_DATE_FORMAT, &tm);
+
+    return std::string(buffer, length);
+}
+
+std::optional<HttpTime> ParseHttpDate(std::string_view date) {
+    // strptime требует строку, завершающуюся нулём
+    const std::string date_str{boost::algorithm::trim_copy(date)};
+
+    std::tm tm{};
+    const char *end = strptime(date_str.c_str(), HTTP_DATE_FORMAT, &tm);
+    if (end == nullptr || *end != '\0') {
+        return std::nullopt;
+    }
+
+    return HttpTime{std::chrono::seconds{timegm(&tm)}};
+}
+
+bool MatchesIfNoneMatch(std::string_view if_none_match,
+                        std::string_view etag) {
+    etag = WithoutWeakPrefix(etag);
+
+    while (!if_none_match.empty()) {
+        const auto comma = if_none_match.find(',');
+        const auto candidate = WithoutWeakPrefix(
+            boost::algorithm::trim_copy(if_none_match.substr(0, comma)));
+
+        if (candidate == "*"sv || candidate == etag) {
+            return true;
+        }
+
+        if_none_match.remove_prefix(comma == std::string_view::npos
+                                        ? if_none_match.size()
+                                        : comma + 1);
+    }
+
+    return false;
+}
+
+bool IsNotModified(std::string_view if_none_match,
+                   std::string_view if_modified_since, std::string_view etag,
+                   std::optional<HttpTime> last_modified) {
+    if (!if_none_match.empty()) {
+        return !etag.empty() && MatchesIfNoneMatch(if_none_match, etag);
+    }
+
+    if (!if_modified_since.empty() && last_modified) {
+        const auto since = ParseHttpDate(if_modified_since);
+        return since && *last_modified <= *since;
+    }
+
+    return false;
+}
+
+} // namespace http_cache
@@ -0,0 +1,176 @@
+#include "coroutine_session.hpp"
+#include "errors.hpp"
+
+namespace http_server {
+
+using namespace std::string_view_literals;
+
+CoroutineSessionBase::CoroutineSessionBase(
+    SessionSocket &&socket, const tcp::endpoint &client_endpoint,
+    std::shared_ptr<AdmissionControl> admission,
+    AdmissionControl::SessionPermit permit)
+    : stream_(std::move(socket)), client_endpoint_(client_endpoint), arena_(SESSION_ARENA_SIZE),
+      admission_(std::move(admission)), session_permit_(std::move(permit)),
+      response_ready_(stream_.get_executor()),
+      send_timer_(stream_.get_executor()) {
+    metrics::Add(metrics::Gauge::ACTIVE_SESSIONS, 1);
+}
+
+CoroutineSessionBase::~CoroutineSessionBase() {
+    metrics::Add(metrics::Gauge::ACTIVE_SESSIONS, -1);
+}
+
+auto CoroutineSessionBase::ReadRequest()
+    -> Awaitable<std::optional<HttpRequest>> {
+    const auto &limits = admission_->GetLimits();
+    beast::error_code ec;
+
+    // Ответ на предыдущий запрос отправлен, объектов в арене не осталось
+    parser_.reset();
+    arena_.Reset();
+
+    // Начало следующего запроса уже могло быть прочитано вместе с предыдущим
+    if (buffer_.size() == 0) {
+        stream_.expires_after(limits.idle_timeout);
+        const auto bytes_read = co_await stream_.async_read_some(
+            buffer_.prepare(IDLE_READ_SIZE),
+            net::redirect_error(use_awaitable, ec));
+        metrics::Increment(metrics::Counter::BYTES_RECEIVED, bytes_read);
+
+        // Закрытие простаивающего соединения клиентом или по таймауту -
+        // штатная ситуация
+        if (ec == net::error::eof) {
+            Close();
+            co_return std::nullopt;
+        }
+        if (ec == beast::error::timeout) {
+            co_return std::nullopt;
+        }
+        if (ec) {
+            Close();
+            error::Report(ec, "read"sv);
+            co_return std::nullopt;
+        }
+        buffer_.commit(bytes_read);
+    }
+
+    parser_.emplace(std::piecewise_construct,
+                    std::make_tuple(arena_.GetAllocator()),
+                    std::make_tuple(arena_.GetAllocator()));
+
+    stream_.expires_after(limits.header_timeout);
+    auto bytes_read = co_await http::async_read_header(
+        stream_, buffer_, *parser_,
+        net::redirect_error(use_awaitable, ec));
+    metrics::Increment(metrics::Counter::BYTES_RECEIVED, bytes_read);
+
+    // У большинства запросов нет тела
+    if (!ec && !parser_->is_done()) {
+        stream_.expires_after(limits.body_timeout);
+        bytes_read = co_await http::async_read(
+            stream_, buffer_, *parser_,
+            net::redirect_error(use_awaitable, ec));
+        metrics::Increment(metrics::Counter::BYTES_RECEIVED, bytes_read);
+    }
+
+    if (ec == http::error::end_of_stream) {
+        Close();
+        co_return std::nullopt;
+    }
+    if (ec) {
+        Close();
+        error::Report(ec, "read"sv);
+        co_return std::nullopt;
+    }
+
+    co_return parser_->release();
+}
+
+CoroutineSessionBase::Awaitable<bool> CoroutineSessionBase::WriteResponse() {
+    while (!response_) {
+        // Обработчик ответит асинхронно. SetResponse отменит ожидание
+        beast::error_code ec;
+        response_ready_.expires_at(net::steady_timer::time_point::max());
+        co_await response_ready_.async_wait(
+            net::redirect_error(use_awaitable, ec));
+    }
+
+    const bool keep_open = co_await write_response_(*this, response_.get());
+    response_.reset();
+    co_return keep_open;
+}
+
+CoroutineSessionBase::Awaitable<bool>
+CoroutineSessionBase::Write(FileResponse &response) {
+    http::response_serializer<SendfileBody, ArenaFields> serializer{response};
+    beast::error_code ec;
+
+    stream_.expires_after(SEND_TIMEOUT);
+    const auto header_written = co_await http::async_write_header(
+        stream_, serializer, net::redirect_error(use_awaitable, ec));
+    metrics::Increment(metrics::Counter::BYTES_SENT, header_written);
+
+    auto &socket = stream_.socket();
+    if (!ec) {
+        socket.native_non_blocking(true, ec);
+    }
+
+    std::uint64_t sent = 0;
+    while (!ec) {
+        const auto status =
+            SendBody(socket.native_handle(), response.body(), sent, ec);
+        if (status == SendBodyStatus::DONE) {
+            break;
+        }
+        if (status == SendBodyStatus::PARTIAL) {
+            // Следующая часть отправляется после обработчиков других сессий
+            co_await net::post(stream_.get_executor(), use_awaitable);
+            continue;
+        }
+
+        // Буфер отправки сокета заполнен - продолжим, когда он освободится.
+        // При уничтожении сессии таймер вызывает обработчик с ошибкой, поэтому
+        // захватывать указатель на сессию безопасно
+        send_timer_.expires_after(SEND_TIMEOUT);
+        send_timer_.async_wait([this](beast::error_code ec) {
+            if (!ec) {
+                stream_.socket().cancel();
+            }
+        });
+
+        co_await socket.async_wait(tcp::socket::wait_write,
+                                   net::redirect_error(use_awaitable, ec));
+        send_timer_.cancel();
+    }
+
+    co_return OnWrite(response.need_eof(), ec, sent);
+}
+
+bool CoroutineSessionBase::OnWrite(bool close, beast::error_code ec,
+                                   std::size_t bytes_written) {
+    metrics::Increment(metrics::Counter::BYTES_SENT, bytes_written);
+
+    if (ec) {
+        beast::error_code close_ec;
+        stream_.socket().close(close_ec);
+        error::Report(ec, "write"sv);
+        return false;
+    }
+
+    if (close) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CoroutineSessionBase::Close() {
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+
+    if (ec) {
+        return error::Report(ec, "read"sv);
+    }
+}
+
+} // namespace http_server
@@ -1,15 +1,20 @@
 #include <string_view>
 
 #include "logs.hpp"
+#include "metrics.hpp"
 
 namespace error {
 
+using namespace std::literals;
+
 void Report(boost::system::error_code ec, std::string_view what) {
-    json::object data;
+    metrics::Increment(metrics::Counter::ERRORS_REPORTED);
 
-    data["code"] = ec.value();
-    data["text"] = std::move(ec.message());
-    data["where"] = std::string(what);
+    std::string data;
+    logs::JsonObjectWriter{data}
+        .Add("code"sv, ec.value())
+        .Add("text"sv, ec.message())
+        .Add("where"sv, what);
 
     BOOST_LOG_TRIVIAL(info)
         << logging::add_value(additional_data, std::move(data)) << "error";
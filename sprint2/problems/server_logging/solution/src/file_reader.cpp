@@ -0,0 +1,128 @@
+#include "file_reader.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/asio/post.hpp>
+
+#if defined(BOOST_ASIO_HAS_FILE)
+#include <boost/asio/random_access_file.hpp>
+#include <boost/asio/read_at.hpp>
+#endif
+
+namespace http_handler {
+
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+
+bool IsUringFileIoSupported() noexcept {
+#if defined(BOOST_ASIO_HAS_FILE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ReadFile(const fs::path &path, const ReadFileHandler &handler) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return handler(
+            std::make_error_code(std::errc::no_such_file_or_directory), {});
+    }
+
+    std::string content((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    handler({}, std::move(content));
+}
+
+OpenedFile::OpenedFile(OpenedFile &&other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      size_(std::exchange(other.size_, 0)) {}
+
+OpenedFile &OpenedFile::operator=(OpenedFile &&other) noexcept {
+    if (this != &other) {
+        if (fd_ != -1) {
+            ::close(fd_);
+        }
+        fd_ = std::exchange(other.fd_, -1);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+OpenedFile::~OpenedFile() {
+    if (fd_ != -1) {
+        ::close(fd_);
+    }
+}
+
+OpenedFile OpenedFile::Open(const fs::path &path, std::error_code &ec) {
+    OpenedFile file;
+    file.fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file.fd_ == -1) {
+        ec.assign(errno, std::system_category());
+        return file;
+    }
+
+    struct stat st {};
+    if (::fstat(file.fd_, &st) == -1) {
+        ec.assign(errno, std::system_category());
+        return OpenedFile{};
+    }
+    file.size_ = static_cast<std::uint64_t>(st.st_size);
+    ec.clear();
+    return file;
+}
+
+int OpenedFile::Release() noexcept {
+    size_ = 0;
+    return std::exchange(fd_, -1);
+}
+
+void ReadOpenedFile(const net::any_io_executor &executor,
+                    [[maybe_unused]] OpenedFile file, ReadFileHandler handler) {
+#if defined(BOOST_ASIO_HAS_FILE)
+    struct Read {
+        net::random_access_file file;
+        std::string content;
+        ReadFileHandler handler;
+    };
+    auto read = std::make_shared<Read>(
+        Read{net::random_access_file{executor}, {}, std::move(handler)});
+
+    read->content.resize(static_cast<std::size_t>(file.Size()));
+    const int fd = file.Release();
+    boost::system::error_code ec;
+    read->file.assign(fd, ec);
+    if (ec) {
+        ::close(fd);
+        return net::post(executor, [read, ec] {
+            read->handler(static_cast<std::error_code>(ec), {});
+        });
+    }
+
+    net::async_read_at(
+        read->file, 0, net::buffer(read->content),
+        [read](const boost::system::error_code &ec, std::size_t bytes_read) {
+            // Файл мог стать короче с момента открытия
+            read->content.resize(bytes_read);
+            if (ec && ec != net::error::eof) {
+                return read->handler(static_cast<std::error_code>(ec), {});
+            }
+            read->handler({}, std::move(read->content));
+        });
+#else
+    // Режим FileIo::URING не включается без поддержки в сборке
+    net::post(executor, [handler = std::move(handler)] {
+        handler(std::make_error_code(std::errc::operation_not_supported), {});
+    });
+#endif
+}
+
+} // namespace http_handler
@@ -0,0 +1,27 @@
+#include "handler_memory.hpp"
+
+#include <new>
+
+namespace http_server {
+
+void *HandlerMemory::Allocate(std::size_t size) {
+    if (size <= BLOCK_SIZE) {
+        for (std::size_t i = 0; i < BLOCK_COUNT; ++i) {
+            if (!used_[i].exchange(true, std::memory_order_acquire)) {
+                return blocks_[i].data;
+            }
+        }
+    }
+    return ::operator new(size);
+}
+
+void HandlerMemory::Deallocate(void *pointer) noexcept {
+    for (std::size_t i = 0; i < BLOCK_COUNT; ++i) {
+        if (pointer == blocks_[i].data) {
+            return used_[i].store(false, std::memory_order_release);
+        }
+    }
+    ::operator delete(pointer);
+}
+
+} // namespace http_server
@@ -1,41 +1,233 @@
 #include "http_server.hpp"
 #include "errors.hpp"
+#include "session_settings.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <span>
 
 namespace http_server {
 
 using namespace std::string_view_literals;
 
+namespace {
+
+// Готовые ответы объединяются в одну запись, пока их суммарный размер не
+// превышает этого значения
+constexpr std::size_t COALESCE_LIMIT = 64 * 1024;
+
+// Пока в арене выделено больше, следующие запросы не читаются до отправки
+// ответов на уже прочитанные и сброса арены. Иначе клиент, непрерывно
+// отправляющий запросы конвейером, не дал бы арене сброситься никогда
+constexpr std::size_t ARENA_PIPELINE_LIMIT = 256 * 1024;
+
+} // namespace
+
 void SessionBase::Run() {
     net::dispatch(
         stream_.get_executor(),
         beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
 }
 
-SessionBase::SessionBase(tcp::socket &&socket) : stream_(std::move(socket)) {}
+SessionBase::SessionBase(SessionSocket &&socket,
+                         const tcp::endpoint &client_endpoint,
+                         std::shared_ptr<AdmissionControl> admission,
+                         AdmissionControl::SessionPermit permit)
+    : stream_(std::move(socket)), client_endpoint_(client_endpoint),
+      arena_(SESSION_ARENA_SIZE), admission_(std::move(admission)),
+      session_permit_(std::move(permit)),
+      pending_(admission_->GetLimits().max_pipeline_depth),
+      idle_timer_(stream_.get_executor()), send_timer_(stream_.get_executor()) {
+    metrics::Add(metrics::Gauge::ACTIVE_SESSIONS, 1);
+}
+
+SessionBase::~SessionBase() {
+    metrics::Add(metrics::Gauge::ACTIVE_SESSIONS, -1);
+}
 
 void SessionBase::Read() {
-    using namespace std::literals;
-    request_ = {};
-    stream_.expires_after(30s);
+    reading_ = true;
+
+    // Начало следующего запроса уже могло быть прочитано вместе с предыдущим
+    if (buffer_.size() != 0) {
+        // Если на все запросы уже ответили, ReadHeader сбросит арену. Объекты
+        // из арены, захваченные обработчиком завершившейся записи, будут
+        // уничтожены только после выхода из него, поэтому ReadHeader
+        // вызывается отдельным обработчиком
+        if (PendingCount() == 0) {
+            return net::post(
+                stream_.get_executor(),
+                BindHandlerMemory(
+                    handler_memory_,
+                    beast::bind_front_handler(&SessionBase::ReadHeader,
+                                              GetSharedThis())));
+        }
+        return ReadHeader();
+    }
+
+    waiting_for_request_ = true;
+    idle_timer_.expires_after(admission_->GetLimits().idle_timeout);
+    idle_timer_.async_wait(BindHandlerMemory(
+        handler_memory_, beast::bind_front_handler(&SessionBase::OnIdleTimeout,
+                                                   GetSharedThis())));
+
+    // Читаем напрямую из сокета, чтобы таймаут tcp_stream не закрыл
+    // соединение посреди отправки ответов на предыдущие запросы
+    stream_.socket().async_read_some(
+        buffer_.prepare(IDLE_READ_SIZE),
+        BindHandlerMemory(handler_memory_,
+                          beast::bind_front_handler(&SessionBase::OnIdleRead,
+                                                    GetSharedThis())));
+}
+
+void SessionBase::OnIdleRead(beast::error_code ec, std::size_t bytes_read) {
+    metrics::Increment(metrics::Counter::BYTES_RECEIVED, bytes_read);
+    waiting_for_request_ = false;
+    idle_timer_.cancel();
+
+    // Закрытие простаивающего соединения клиентом или по таймауту - штатная
+    // ситуация
+    if (ec == net::error::eof) {
+        return StopReading();
+    }
+    if (ec == net::error::operation_aborted) {
+        reading_ = false;
+        read_stopped_ = true;
+        return;
+    }
+
+    if (ec) {
+        StopReading();
+        return error::Report(ec, "read"sv);
+    }
+
+    buffer_.commit(bytes_read);
+    ReadHeader();
+}
+
+void SessionBase::OnIdleTimeout(beast::error_code ec) {
+    if (ec == net::error::operation_aborted || !waiting_for_request_ ||
+        idle_timer_.expiry() > net::steady_timer::clock_type::now()) {
+        return;
+    }
+
+    // Пока отправляются ответы на предыдущие запросы, соединение не считается
+    // простаивающим
+    if (PendingCount() != 0) {
+        idle_timer_.expires_after(admission_->GetLimits().idle_timeout);
+        idle_timer_.async_wait(BindHandlerMemory(
+            handler_memory_,
+            beast::bind_front_handler(&SessionBase::OnIdleTimeout,
+                                      GetSharedThis())));
+        return;
+    }
+
+    beast::error_code cancel_ec;
+    stream_.socket().cancel(cancel_ec);
+}
+
+void SessionBase::ReadHeader() {
+    // Разбор нового запроса. Когда ответы на все прочитанные запросы
+    // отправлены, объектов в арене не осталось и её можно сбросить
+    parser_.reset();
+    if (PendingCount() == 0) {
+        arena_.Reset();
+    }
+    parser_.emplace(std::piecewise_construct,
+                    std::make_tuple(arena_.GetAllocator()),
+                    std::make_tuple(arena_.GetAllocator()));
+
+    stream_.expires_after(admission_->GetLimits().header_timeout);
+    http::async_read_header(
+        stream_, buffer_, *parser_,
+        BindHandlerMemory(handler_memory_,
+                          beast::bind_front_handler(&SessionBase::OnReadHeader,
+                                                    GetSharedThis())));
+}
+
+void SessionBase::OnReadHeader(beast::error_code ec, std::size_t bytes_read) {
+    metrics::Increment(metrics::Counter::BYTES_RECEIVED, bytes_read);
+
+    if (ec == http::error::end_of_stream) {
+        return StopReading();
+    }
+
+    if (ec) {
+        StopReading();
+        return error::Report(ec, "read"sv);
+    }
+
+    // У большинства запросов нет тела
+    if (parser_->is_done()) {
+        return OnRead({}, 0);
+    }
+
+    stream_.expires_after(admission_->GetLimits().body_timeout);
     http::async_read(
-        stream_, buffer_, request_,
-        beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
+        stream_, buffer_, *parser_,
+        BindHandlerMemory(handler_memory_,
+                          beast::bind_front_handler(&SessionBase::OnRead,
+                                                    GetSharedThis())));
 }
 
-void SessionBase::OnRead(beast::error_code ec,
-                         [[maybe_unused]] std::size_t bytes_read) {
-    using namespace std::literals;
+void SessionBase::OnRead(beast::error_code ec, std::size_t bytes_read) {
+    metrics::Increment(metrics::Counter::BYTES_RECEIVED, bytes_read);
+
     if (ec == http::error::end_of_stream) {
-        return Close();
+        return StopReading();
     }
 
     if (ec) {
+        StopReading();
         return error::Report(ec, "read"sv);
     }
 
-    HandleRequest(std::move(request_));
+    reading_ = false;
+    if (!parser_->get().keep_alive()) {
+        read_stopped_ = true;
+    }
+
+    const auto sequence = next_sequence_++;
+    auto &pending = GetPendingResponse(sequence);
+
+    pending.permit = admission_->AdmitRequest();
+    if (pending.permit) {
+        HandleRequest(parser_->release(), sequence);
+    } else {
+        Write(sequence, admission_->MakeRejection(parser_->get().version()));
+    }
+
+    ContinueReading();
+}
+
+void SessionBase::ContinueReading() {
+    if (reading_ || read_stopped_) {
+        return;
+    }
+    const bool can_pipeline = PendingCount() < pending_.size() &&
+                              arena_.BytesAllocated() < ARENA_PIPELINE_LIMIT;
+    if (PendingCount() == 0 || can_pipeline) {
+        Read();
+    }
+}
+
+void SessionBase::StopReading() {
+    reading_ = false;
+    read_stopped_ = true;
+
+    if (PendingCount() == 0) {
+        Close();
+    }
+}
+
+void SessionBase::StopWriting() {
+    write_stopped_ = true;
+    for (auto sequence = first_sequence_; sequence != next_sequence_;
+         ++sequence) {
+        if (auto &pending = GetPendingResponse(sequence); pending.ready) {
+            pending.Clear();
+        }
+    }
 }
 
 void SessionBase::Close() {
@@ -47,17 +239,222 @@ void SessionBase::Close() {
     }
 }
 
+std::size_t SessionBase::PendingResponse::Size() const noexcept {
+    return header.size() + net::buffer_size(body);
+}
+
+void SessionBase::PendingResponse::Clear() noexcept {
+    permit = {};
+    ready = false;
+    need_eof = false;
+    header.clear();
+    body.clear();
+    storage.reset();
+    write_alone = nullptr;
+}
+
+void SessionBase::AppendBodyBuffers(std::vector<net::const_buffer> &out,
+                                    const std::string &body) {
+    if (!body.empty()) {
+        out.push_back(net::buffer(body));
+    }
+}
+
+void SessionBase::AppendBodyBuffers(std::vector<net::const_buffer> &out,
+                                    const SharedBufferBody::value_type &body) {
+    for (std::size_t i = 0; i < body.PieceCount(); ++i) {
+        const auto piece = body.Piece(i);
+        if (!piece.empty()) {
+            out.push_back(net::buffer(piece.data(), piece.size()));
+        }
+    }
+}
+
+void SessionBase::OnResponseReady(PendingResponse &pending) {
+    // Сокет уже закрыт для записи, и ответ некуда отправить
+    if (write_stopped_) {
+        return pending.Clear();
+    }
+
+    pending.ready = true;
+    if (pending.need_eof) {
+        read_stopped_ = true;
+    }
+
+    if (writing_count_ == 0) {
+        WriteNext();
+    }
+}
+
+void SessionBase::WriteNext() {
+    if (PendingCount() == 0 || !GetPendingResponse(first_sequence_).ready) {
+        return;
+    }
+
+    StartSendTimer();
+
+    if (auto &front = GetPendingResponse(first_sequence_);
+        front.write_alone) {
+        writing_count_ = 1;
+        return front.write_alone(*this, front.storage.get());
+    }
+
+    // Собираем готовые ответы, идущие подряд, в одну запись
+    write_buffers_.clear();
+    std::size_t size = 0;
+    bool close = false;
+    for (auto sequence = first_sequence_; sequence != next_sequence_;
+         ++sequence) {
+        const auto &pending = GetPendingResponse(sequence);
+        if (!pending.ready || pending.write_alone ||
+            (writing_count_ != 0 && size + pending.Size() > COALESCE_LIMIT)) {
+            break;
+        }
+
+        write_buffers_.push_back(net::buffer(pending.header));
+        write_buffers_.insert(write_buffers_.end(), pending.body.begin(),
+                              pending.body.end());
+        size += pending.Size();
+        ++writing_count_;
+
+        // Ответы после закрывающего соединение не отправляются
+        if (pending.need_eof) {
+            close = true;
+            break;
+        }
+    }
+
+    // Операция записи хранит копию последовательности буферов, поэтому ей
+    // передаётся не вектор, а ссылающийся на него span
+    net::async_write(
+        stream_.socket(), std::span<const net::const_buffer>{write_buffers_},
+        BindHandlerMemory(handler_memory_,
+                          [close, self = GetSharedThis()](
+                              beast::error_code ec, std::size_t bytes_written) {
+                              self->OnWrite(close, ec, bytes_written);
+                          }));
+}
+
+void SessionBase::Write(std::uint64_t sequence, FileResponse &&response) {
+    auto &pending = GetPendingResponse(sequence);
+    pending.need_eof = response.need_eof();
+    pending.storage = std::allocate_shared<FileResponse>(arena_.GetAllocator(),
+                                                         std::move(response));
+    pending.write_alone = [](SessionBase &self, void *response) {
+        self.WriteFile(*static_cast<FileResponse *>(response));
+    };
+
+    OnResponseReady(pending);
+}
+
+void SessionBase::WriteFile(FileResponse &response) {
+    // Ответ остаётся в очереди, а сериализатор - в сессии до вызова OnWrite,
+    // поэтому обработчики захватывают только указатель на сессию
+    file_serializer_.emplace(response);
+
+    http::async_write_header(
+        stream_.socket(), *file_serializer_,
+        BindHandlerMemory(handler_memory_, [self = GetSharedThis()](
+                                               beast::error_code ec,
+                                               std::size_t bytes_written) {
+            metrics::Increment(metrics::Counter::BYTES_SENT, bytes_written);
+            if (ec) {
+                return self->OnWrite(self->file_serializer_->get().need_eof(),
+                                     ec, 0);
+            }
+            // Отправка тела ограничивается по времени каждого ожидания сокета
+            self->send_timer_.cancel();
+            self->SendFileBody(0);
+        }));
+}
+
+void SessionBase::SendFileBody(std::uint64_t sent) {
+    auto &socket = stream_.socket();
+    const auto &response = file_serializer_->get();
+
+    beast::error_code ec;
+    socket.native_non_blocking(true, ec);
+
+    const auto status =
+        ec ? SendBodyStatus::DONE
+           : SendBody(socket.native_handle(), response.body(), sent, ec);
+
+    if (status == SendBodyStatus::PARTIAL) {
+        // Следующая часть отправляется после обработчиков других сессий
+        return net::post(stream_.get_executor(),
+                         BindHandlerMemory(handler_memory_,
+                                           [sent, self = GetSharedThis()] {
+                                               self->SendFileBody(sent);
+                                           }));
+    }
+
+    if (status == SendBodyStatus::WOULD_BLOCK) {
+        // Буфер отправки сокета заполнен - продолжим, когда он освободится
+        StartSendTimer();
+
+        socket.async_wait(
+            tcp::socket::wait_write,
+            BindHandlerMemory(handler_memory_, [sent, self = GetSharedThis()](
+                                                   beast::error_code ec) {
+                self->send_timer_.cancel();
+                if (ec) {
+                    return self->OnWrite(true, ec, sent);
+                }
+                self->SendFileBody(sent);
+            }));
+        return;
+    }
+
+    OnWrite(response.need_eof(), ec, sent);
+}
+
+void SessionBase::StartSendTimer() {
+    send_timer_.expires_after(SEND_TIMEOUT);
+    send_timer_.async_wait(BindHandlerMemory(
+        handler_memory_, [self = GetSharedThis()](beast::error_code ec) {
+            // Таймер могли перезапустить после того, как он сработал
+            if (ec || self->send_timer_.expiry() >
+                          net::steady_timer::clock_type::now()) {
+                return;
+            }
+            beast::error_code cancel_ec;
+            self->stream_.socket().cancel(cancel_ec);
+        }));
+}
+
 void SessionBase::OnWrite(bool close, beast::error_code ec,
-                          [[maybe_unused]] std::size_t bytes_written) {
+                          std::size_t bytes_written) {
+    metrics::Increment(metrics::Counter::BYTES_SENT, bytes_written);
+    send_timer_.cancel();
+
+    // Отправленные ответы освобождают место в конвейере и право на обработку
+    // запроса. Сериализатор ссылается на отправленный ответ
+    file_serializer_.reset();
+    for (; writing_count_ != 0; --writing_count_) {
+        GetPendingResponse(first_sequence_++).Clear();
+    }
+
     if (ec) {
+        // Прерываем ожидание следующего запроса
+        read_stopped_ = true;
+        StopWriting();
+        beast::error_code close_ec;
+        stream_.socket().close(close_ec);
         return error::Report(ec, "write"sv);
     }
 
     if (close) {
+        read_stopped_ = true;
+        StopWriting();
         return Close();
     }
 
-    Read();
+    WriteNext();
+
+    if (read_stopped_ && PendingCount() == 0 && !reading_) {
+        return Close();
+    }
+    ContinueReading();
 }
 
 } // namespace http_server
@@ -0,0 +1,69 @@
+#include "json_writer.hpp"
+
+#include <algorithm>
+
+namespace logs {
+
+namespace {
+
+bool NeedsEscape(char c) {
+    return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+void AppendEscaped(std::string &out, char c) {
+    switch (c) {
+    case '"':
+        out += "\\\"";
+        break;
+    case '\\':
+        out += "\\\\";
+        break;
+    case '\b':
+        out += "\\b";
+        break;
+    case '\f':
+        out += "\\f";
+        break;
+    case '\n':
+        out += "\\n";
+        break;
+    case '\r':
+        out += "\\r";
+        break;
+    case '\t':
+        out += "\\t";
+        break;
+    default: {
+        constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+        const auto code = static_cast<unsigned char>(c);
+        out += "\\u00";
+        out += HEX_DIGITS[code >> 4];
+        out += HEX_DIGITS[code & 0xF];
+    }
+    }
+}
+
+} // namespace
+
+void AppendJsonString(std::string &out, std::string_view str) {
+    out += '"';
+
+    // Обычно экранировать нечего, и строка копируется целыми участками
+    while (!str.empty()) {
+        const auto special = std::ranges::find_if(str, NeedsEscape);
+        const auto plain_length =
+            static_cast<std::size_t>(special - str.begin());
+
+        out.append(str.data(), plain_length);
+        if (plain_length == str.size()) {
+            break;
+        }
+
+        AppendEscaped(out, str[plain_length]);
+        str.remove_prefix(plain_length + 1);
+    }
+
+    out += '"';
+}
+
+} // namespace logs
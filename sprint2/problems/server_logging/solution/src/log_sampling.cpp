@@ -0,0 +1,171 @@
+#include "log_sampling.hpp"
+#include "logs.hpp"
+
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace http_handler {
+
+using namespace std::literals;
+namespace json = boost::json;
+
+namespace {
+
+unsigned ToRate(const json::value &value) {
+    if (!value.is_int64() || value.as_int64() < 0 ||
+        value.as_int64() > std::numeric_limits<unsigned>::max()) {
+        throw std::invalid_argument(
+            "Rate must be a non-negative integer that fits in unsigned");
+    }
+    return static_cast<unsigned>(value.as_int64());
+}
+
+} // namespace
+
+LogSampler::LogSampler(const Settings &settings)
+    : default_rate_(settings.default_rate),
+      slow_threshold_ms_(settings.slow_threshold.count()),
+      aggregate_interval_(settings.aggregate_interval),
+      unmatched_(std::make_unique<RouteState>()) {}
+
+void LogSampler::AddRoute(std::string_view route) {
+    routes_.try_emplace(std::string{route}, std::make_unique<RouteState>());
+}
+
+LogSampler::RouteState &
+LogSampler::GetState(std::string_view route) const noexcept {
+    if (auto it = routes_.find(route); it != routes_.end()) {
+        return *it->second;
+    }
+    return *unmatched_;
+}
+
+bool LogSampler::Sample(std::string_view route) noexcept {
+    auto &state = GetState(route);
+
+    unsigned rate = state.rate.load(std::memory_order_relaxed);
+    if (rate == 0) {
+        rate = default_rate_.load(std::memory_order_relaxed);
+    }
+
+    return rate <= 1 ||
+           state.counter.fetch_add(1, std::memory_order_relaxed) % rate == 0;
+}
+
+bool LogSampler::MustLog(
+    unsigned code, std::chrono::milliseconds response_time) const noexcept {
+    return code >= 400 ||
+           response_time.count() >=
+               slow_threshold_ms_.load(std::memory_order_relaxed);
+}
+
+void LogSampler::Aggregate(std::string_view route, unsigned code,
+                           std::uint64_t bytes,
+                           std::chrono::microseconds response_time) {
+    auto &state = GetState(route);
+    std::lock_guard lock{state.mutex};
+
+    auto &summary = state.summaries[code];
+    ++summary.count;
+    summary.bytes += bytes;
+    summary.total_time += response_time;
+    summary.max_time = std::max(summary.max_time, response_time);
+}
+
+void LogSampler::Flush() {
+    auto flush_route = [](std::string_view route, RouteState &state) {
+        std::map<unsigned, Summary> summaries;
+        {
+            std::lock_guard lock{state.mutex};
+            summaries.swap(state.summaries);
+        }
+
+        for (const auto &[code, summary] : summaries) {
+            std::string data;
+            logs::JsonObjectWriter{data}
+                .Add("route"sv, route)
+                .Add("code"sv, code)
+                .Add("count"sv, summary.count)
+                .Add("bytes"sv, summary.bytes)
+                .Add("response_time_avg_us"sv,
+                     summary.total_time.count() /
+                         static_cast<std::chrono::microseconds::rep>(
+                             summary.count))
+                .Add("response_time_max_us"sv, summary.max_time.count());
+
+            BOOST_LOG_TRIVIAL(info)
+                << logging::add_value(additional_data, std::move(data))
+                << "requests aggregated"sv;
+        }
+    };
+
+    for (const auto &[route, state] : routes_) {
+        flush_route(route, *state);
+    }
+    flush_route({}, *unmatched_);
+}
+
+std::string LogSampler::SettingsToJson() const {
+    std::string routes;
+    {
+        logs::JsonObjectWriter writer{routes};
+        for (const auto &[route, state] : routes_) {
+            writer.Add(route, state->rate.load(std::memory_order_relaxed));
+        }
+    }
+
+    std::string settings;
+    logs::JsonObjectWriter{settings}
+        .Add("default_rate"sv, default_rate_.load(std::memory_order_relaxed))
+        .Add("slow_threshold_ms"sv,
+             slow_threshold_ms_.load(std::memory_order_relaxed))
+        .AddRaw("routes"sv, routes);
+
+    return settings;
+}
+
+void LogSampler::ApplySettings(const json::object &settings) {
+    // Сначала проверяем все настройки, затем применяем их
+    std::optional<unsigned> default_rate;
+    std::optional<std::chrono::milliseconds::rep> slow_threshold_ms;
+    std::vector<std::pair<RouteState *, unsigned>> route_rates;
+
+    for (const auto &[key, value] : settings) {
+        if (key == "default_rate"sv) {
+            default_rate = ToRate(value);
+        } else if (key == "slow_threshold_ms"sv) {
+            if (!value.is_int64() || value.as_int64() < 0) {
+                throw std::invalid_argument(
+                    "Slow threshold must be a non-negative integer");
+            }
+            slow_threshold_ms = value.as_int64();
+        } else if (key == "routes"sv) {
+            if (!value.is_object()) {
+                throw std::invalid_argument("Routes must be an object");
+            }
+            for (const auto &[route, rate] : value.as_object()) {
+                auto it = routes_.find(std::string_view{route});
+                if (it == routes_.end()) {
+                    throw std::invalid_argument("Unknown route");
+                }
+                route_rates.emplace_back(it->second.get(), ToRate(rate));
+            }
+        } else {
+            throw std::invalid_argument("Unknown setting");
+        }
+    }
+
+    if (default_rate) {
+        default_rate_.store(std::max(*default_rate, 1u));
+    }
+    if (slow_threshold_ms) {
+        slow_threshold_ms_.store(*slow_threshold_ms);
+    }
+    for (auto [state, rate] : route_rates) {
+        state->rate.store(rate);
+    }
+}
+
+} // namespace http_handler
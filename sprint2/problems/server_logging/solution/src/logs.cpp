@@ -3,37 +3,440 @@
 #include <boost/date_time.hpp>
 #include <boost/log/core.hpp> // для logging::core
 #include <boost/log/expressions.hpp> // для выражения, задающего фильтр
+#include <boost/log/sinks/basic_sink_backend.hpp>
+#include <boost/log/sinks/unlocked_frontend.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/utility/setup/console.hpp>
 #include <boost/log/utility/setup/file.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <memory>
+#include <mutex>
 #include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
 
 namespace logs {
 
 using namespace std::literals;
 namespace keywords = boost::log::keywords;
 namespace expr = boost::log::expressions;
+namespace sinks = boost::log::sinks;
+
+namespace {
+
+// Дописывает к out число value ровно из width цифр, дополняя его нулями
+void AppendDigits(std::string &out, long value, int width) {
+    char buffer[8];
+    for (int i = width - 1; i >= 0; --i) {
+        buffer[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    out.append(buffer, width);
+}
+
+// Дописывает к out время в формате to_iso_extended_string:
+// "2023-01-31T12:34:56.789012". Дата и время с точностью до миллисекунды
+// форматируются заново только при смене миллисекунды
+void AppendTimestamp(std::string &out, const boost::posix_time::ptime &ts) {
+    if (ts.is_special()) {
+        out += to_iso_extended_string(ts);
+        return;
+    }
+
+    thread_local long long cached_millisecond = -1;
+    // "YYYY-MM-DDTHH:MM:SS.mmm"
+    thread_local std::string cached_prefix;
+
+    static const boost::posix_time::ptime epoch{
+        boost::gregorian::date{1970, 1, 1}};
+
+    const auto time = ts.time_of_day();
+    const long fraction = static_cast<long>(time.fractional_seconds());
+    const long long millisecond = (ts - epoch).total_milliseconds();
+
+    if (millisecond != cached_millisecond) {
+        const auto date = ts.date().year_month_day();
+
+        cached_prefix.clear();
+        AppendDigits(cached_prefix, date.year, 4);
+        cached_prefix += '-';
+        AppendDigits(cached_prefix, date.month, 2);
+        cached_prefix += '-';
+        AppendDigits(cached_prefix, date.day, 2);
+        cached_prefix += 'T';
+        AppendDigits(cached_prefix, time.hours(), 2);
+        cached_prefix += ':';
+        AppendDigits(cached_prefix, time.minutes(), 2);
+        cached_prefix += ':';
+        AppendDigits(cached_prefix, time.seconds(), 2);
+        cached_prefix += '.';
+        AppendDigits(cached_prefix, fraction / 1000, 3);
+
+        cached_millisecond = millisecond;
+    }
+
+    // Как и to_iso_extended_string, нулевую дробную часть не выводим
+    if (fraction == 0) {
+        out.append(cached_prefix, 0, cached_prefix.size() - 4);
+        return;
+    }
+
+    out += cached_prefix;
+    AppendDigits(out, fraction % 1000, 3);
+}
+
+void AppendRecord(std::string &out, const boost::posix_time::ptime &ts,
+                  std::string_view data, std::string_view message) {
+    out += R"({"timestamp":")";
+    AppendTimestamp(out, ts);
+    out += '"';
+    if (!data.empty()) {
+        out += R"(,"data":)";
+        out += data;
+    }
+    out += R"(,"message":)";
+    AppendJsonString(out, message);
+    out += "}\n";
+}
 
-void MyFormatter(logging::record_view const &rec,
-                 logging::formatting_ostream &strm) {
-    json::object obj;
+} // namespace
 
-    auto ts = *rec[timestamp];
-    obj["timestamp"] = to_iso_extended_string(ts);
+void FormatRecord(const logging::record_view &rec, std::string &out) {
+    std::string_view data;
     if (auto data_ptr = rec[additional_data].get_ptr()) {
-        obj["data"] = *data_ptr;
+        data = *data_ptr;
     }
-    obj["message"] = rec[expr::smessage].get();
 
-    strm << obj;
+    const auto ts = rec[timestamp];
+    AppendRecord(out, ts ? ts.get() : boost::posix_time::ptime{}, data,
+                 rec[expr::smessage].get());
 }
 
-void init() {
+namespace {
+
+// Ограниченная кольцевая очередь записей одного потока. Записи в неё кладёт
+// только поток-владелец, а забирает только поток вывода, поэтому очередь
+// обходится без блокировок
+class RecordRing {
+  public:
+    explicit RecordRing(std::size_t capacity)
+        : records_(std::bit_ceil(std::max<std::size_t>(capacity, 1))),
+          mask_(records_.size() - 1) {}
+
+    std::size_t Capacity() const noexcept { return records_.size(); }
+
+    std::size_t Size() const noexcept {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
+    }
+
+    // Вызывается только потоком-владельцем
+    bool TryPush(const logging::record_view &rec) {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == records_.size()) {
+            return false;
+        }
+        records_[tail & mask_] = rec;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Вызывается только потоком-владельцем. Возвращает управление, когда
+    // поток вывода заберёт из заполненной очереди хотя бы одну запись
+    void WaitForSpace() const {
+        const auto head = head_.load(std::memory_order_acquire);
+        if (tail_.load(std::memory_order_relaxed) - head == records_.size()) {
+            head_.wait(head, std::memory_order_acquire);
+        }
+    }
+
+    // Вызывается только потоком вывода
+    void Drain(std::vector<logging::record_view> &out) {
+        auto head = head_.load(std::memory_order_relaxed);
+        const auto tail = tail_.load(std::memory_order_acquire);
+        if (head == tail) {
+            return;
+        }
+        for (; head != tail; ++head) {
+            out.push_back(std::move(records_[head & mask_]));
+        }
+        head_.store(head, std::memory_order_release);
+        head_.notify_one();
+    }
+
+    // Отброшенные записи считает владелец, а забирает поток вывода
+    std::atomic<std::uint64_t> dropped{0};
+    // Используется только владельцем
+    std::uint64_t sample_counter = 0;
+    // Сбрасывается, когда поток-владелец завершается. Пустую очередь без
+    // владельца получает следующий новый поток
+    std::atomic<bool> owned{true};
+
+  private:
+    std::vector<logging::record_view> records_;
+    const std::size_t mask_;
+
+    // Разнесены по разным кэш-линиям, чтобы владелец и поток вывода не
+    // мешали друг другу
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+// Бэкенд, передающий записи потоку вывода через очереди потоков, которые
+// их создают. consume лишь копирует record_view (счётчик ссылок) в очередь
+// своего потока без блокировок, поэтому io-потоки не ждут ни друг друга, ни
+// форматирования, ни write(2).
+// Поток вывода забирает из всех очередей накопившиеся записи и выводит их
+// одним вызовом write(2). Записи одного потока выводятся в порядке
+// создания, записи разных потоков - в порядке, в котором их забрал поток
+// вывода
+class AsyncBatchingBackend
+    : public sinks::basic_sink_backend<sinks::concurrent_feeding> {
+  public:
+    AsyncBatchingBackend(const Options &options,
+                         worker_topology::ThreadSetup setup_writer)
+        : options_(options),
+          writer_([this, setup = std::move(setup_writer)] {
+              if (setup) {
+                  setup("log-writer"sv);
+              }
+              Run();
+          }) {}
+
+    ~AsyncBatchingBackend() { Stop(); }
+
+    void consume(const logging::record_view &rec) {
+        auto &ring = GetLocalRing();
+        if (!Admit(ring, rec)) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        WakeWriter();
+    }
+
+    // Останавливает поток вывода, предварительно выведя все очереди
+    void Stop() {
+        if (stopped_.exchange(true)) {
+            return;
+        }
+        writer_idle_.store(false);
+        writer_idle_.notify_one();
+
+        if (writer_.joinable()) {
+            writer_.join();
+        }
+    }
+
+  private:
+    // Очередь потока, вызвавшего consume. После logs::init поток получает
+    // очередь нового бэкенда, поэтому рядом хранится номер бэкенда
+    struct LocalRing {
+        std::shared_ptr<RecordRing> ring;
+        std::uint64_t backend_id = 0;
+
+        ~LocalRing() {
+            if (ring) {
+                ring->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static std::uint64_t NextId() {
+        static std::atomic<std::uint64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    RecordRing &GetLocalRing() {
+        thread_local LocalRing local;
+        if (local.backend_id != id_) {
+            if (local.ring) {
+                local.ring->owned.store(false, std::memory_order_release);
+            }
+            local.ring = AcquireRing();
+            local.backend_id = id_;
+        }
+        return *local.ring;
+    }
+
+    std::shared_ptr<RecordRing> AcquireRing() {
+        std::lock_guard lock{rings_mutex_};
+        for (const auto &ring : rings_) {
+            if (!ring->owned.load(std::memory_order_acquire) &&
+                ring->Size() == 0) {
+                ring->owned.store(true, std::memory_order_relaxed);
+                ring->sample_counter = 0;
+                return ring;
+            }
+        }
+        return rings_.emplace_back(
+            std::make_shared<RecordRing>(options_.queue_size));
+    }
+
+    bool Admit(RecordRing &ring, const logging::record_view &rec) {
+        if (stopped_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+
+        switch (options_.overflow) {
+        case OverflowPolicy::BLOCK:
+            while (!ring.TryPush(rec)) {
+                if (stopped_.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                WakeWriter();
+                ring.WaitForSpace();
+            }
+            return true;
+        case OverflowPolicy::DROP:
+            return ring.TryPush(rec);
+        case OverflowPolicy::SAMPLE:
+            if (ring.Size() >= ring.Capacity() / 2 &&
+                ++ring.sample_counter % std::max(options_.sample_rate, 1u) !=
+                    0) {
+                return false;
+            }
+            return ring.TryPush(rec);
+        }
+        return true;
+    }
+
+    // Будит поток вывода, если он ждёт записей. Барьер парный барьеру в
+    // Run: либо поток вывода увидит новую запись, либо этот поток увидит,
+    // что поток вывода уснул
+    void WakeWriter() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writer_idle_.load(std::memory_order_relaxed)) {
+            writer_idle_.store(false);
+            writer_idle_.notify_one();
+        }
+    }
+
+    // Забирает записи всех очередей и число отброшенных записей
+    std::uint64_t DrainRings(std::vector<logging::record_view> &batch) {
+        std::uint64_t dropped = 0;
+        std::lock_guard lock{rings_mutex_};
+        for (const auto &ring : rings_) {
+            ring->Drain(batch);
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+    bool HasRecords() {
+        std::lock_guard lock{rings_mutex_};
+        return std::any_of(rings_.begin(), rings_.end(), [](const auto &ring) {
+            return ring->Size() != 0 ||
+                   ring->dropped.load(std::memory_order_relaxed) != 0;
+        });
+    }
+
+    void Run() {
+        std::vector<logging::record_view> batch;
+        std::string output;
+
+        for (;;) {
+            // Остановка проверяется до того, как забрать записи, чтобы
+            // записи, сделанные до Stop, успели попасть в вывод
+            const bool stopping = stopped_.load();
+            const std::uint64_t dropped = DrainRings(batch);
+
+            if (!batch.empty() || dropped != 0) {
+                for (const auto &rec : batch) {
+                    FormatRecord(rec, output);
+                }
+                batch.clear();
+
+                if (dropped != 0) {
+                    FormatDropped(output, dropped);
+                }
+
+                Write(output);
+                output.clear();
+                continue;
+            }
+            if (stopping) {
+                break;
+            }
+
+            writer_idle_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (HasRecords() || stopped_.load()) {
+                writer_idle_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            writer_idle_.wait(true);
+        }
+    }
+
+    // Запись о потерянных при переполнении очереди записях в том же
+    // формате, что и остальные
+    static void FormatDropped(std::string &out, std::uint64_t dropped) {
+        std::string data;
+        JsonObjectWriter{data}.Add("dropped"sv, dropped);
+
+        AppendRecord(out, boost::posix_time::microsec_clock::local_time(),
+                     data, "log records dropped"sv);
+    }
+
+    static void Write(std::string_view data) {
+        while (!data.empty()) {
+            const ssize_t written =
+                ::write(STDOUT_FILENO, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // Выводить ошибку вывода лога некуда
+                return;
+            }
+            data.remove_prefix(written);
+        }
+    }
+
+    const Options options_;
+    const std::uint64_t id_ = NextId();
+
+    // Защищает список очередей, но не сами очереди: io-поток берёт его
+    // лишь однажды, получая свою очередь
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<RecordRing>> rings_;
+
+    std::atomic<bool> writer_idle_{false};
+    std::atomic<bool> stopped_{false};
+
+    // Объявлен последним, чтобы стартовать после инициализации очередей
+    std::thread writer_;
+};
+
+using AsyncBatchingSink = sinks::unlocked_sink<AsyncBatchingBackend>;
+
+boost::shared_ptr<AsyncBatchingSink> sink;
+
+} // namespace
+
+void init(const Options &options, worker_topology::ThreadSetup setup_writer) {
     logging::add_common_attributes();
 
-    logging::add_console_log(std::cout, keywords::format = &MyFormatter,
-                             keywords::auto_flush = true);
+    auto backend = boost::make_shared<AsyncBatchingBackend>(
+        options, std::move(setup_writer));
+    sink = boost::make_shared<AsyncBatchingSink>(backend);
+    logging::core::get()->add_sink(sink);
+}
+
+void shutdown() {
+    if (!sink) {
+        return;
+    }
+
+    logging::core::get()->remove_sink(sink);
+    sink->locked_backend()->Stop();
+    sink.reset();
 }
 
-} // namespace logs
\ No newline at end of file
+} // namespace logs
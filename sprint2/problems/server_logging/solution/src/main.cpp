@@ -2,15 +2,19 @@
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <iostream>
 #include <thread>
 
+#include "command_line.hpp"
 #include "http_server.hpp"
 #include "json_loader.hpp"
 #include "logs.hpp"
 #include "model.hpp"
 #include "request_handler.hpp"
+#include "static_precompress.hpp"
+#include "worker_topology.hpp"
 
 namespace {
 
@@ -19,23 +23,39 @@ using namespace std::literals;
 namespace sys = boost::system;
 namespace http = boost::beast::http;
 
-// Запускает функцию fn на n потоках, включая текущий
+// Запускает функцию fn(index) на n потоках, включая текущий, который
+// получает индекс 0
 template <typename Fn> void RunWorkers(unsigned n, const Fn &fn) {
     n = std::max(1u, n);
     std::vector<std::jthread> workers;
     workers.reserve(n - 1);
     // Запускаем n-1 рабочих потоков, выполняющих функцию fn
     while (--n) {
-        workers.emplace_back(fn);
+        workers.emplace_back(fn, n);
     }
-    fn();
+    fn(0u);
 }
 
-void OnExit(int exit_status, std::string message) {
-    json::object data;
+// Раз в interval выводит сводки выборочного логирования, чтобы они
+// появлялись и тогда, когда новых запросов нет
+void ScheduleLogFlush(net::steady_timer &timer,
+                      http_handler::LogSampler &sampler,
+                      std::chrono::seconds interval) {
+    timer.expires_after(interval);
+    timer.async_wait([&timer, &sampler, interval](const sys::error_code &ec) {
+        if (ec) {
+            return;
+        }
+        sampler.Flush();
+        ScheduleLogFlush(timer, sampler, interval);
+    });
+}
 
-    data["code"] = exit_status;
-    data["exception"] = std::move(message);
+void OnExit(int exit_status, std::string message) {
+    std::string data;
+    logs::JsonObjectWriter{data}
+        .Add("code"sv, exit_status)
+        .Add("exception"sv, message);
 
     BOOST_LOG_TRIVIAL(info)
         << logging::add_value(additional_data, std::move(data))
@@ -45,15 +65,21 @@ void OnExit(int exit_status, std::string message) {
 } // namespace
 
 int main(int argc, const char *argv[]) {
-    if (argc != 3) {
-        std::cerr
-            << "Usage: game_server <game-config-json> <static-content-directory>"sv
-            << std::endl;
+    command_line::Args args;
+    try {
+        if (auto parsed = command_line::ParseCommandLine(argc, argv)) {
+            args = std::move(*parsed);
+        } else {
+            return EXIT_SUCCESS;
+        }
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << std::endl;
         return EXIT_FAILURE;
     }
+
     try {
         // Проверяем папку со статическими файлами сервера
-        const std::string static_content = argv[2];
+        const std::string static_content = args.www_root;
 
         if (!std::filesystem::is_directory(static_content)) {
             std::cerr
@@ -62,55 +88,130 @@ int main(int argc, const char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        // Размещение потоков по ядрам. Создаётся раньше логов, так как
+        // поток вывода лога занимает зарезервированные ядра
+        const worker_topology::WorkerTopology topology{args.topology};
+
         // Инициализация логов
-        logs::init();
+        logs::init(args.log, topology.MakeServiceSetup());
+
+        if (args.precompress_static) {
+            std::string data;
+            logs::JsonObjectWriter{data}.Add(
+                "created"sv,
+                http_handler::PrecompressStaticFiles(static_content));
+
+            BOOST_LOG_TRIVIAL(info)
+                << logging::add_value(additional_data, std::move(data))
+                << "static files precompressed"sv;
+        }
 
         // Загружаем карту из файла и строим модель игры
-        model::Game game = json_loader::LoadGame(argv[1]);
+        model::Game game = json_loader::LoadGame(args.config_file);
+
+        for (const auto &map : game.GetMaps()) {
+            const auto stats = map.GetRoadGraph().GetStats();
+            std::string data;
+            logs::JsonObjectWriter{data}
+                .Add("map"sv, *map.GetId())
+                .Add("roads"sv, stats.source_roads)
+                .Add("merged_roads"sv, stats.roads)
+                .Add("nodes"sv, stats.nodes)
+                .Add("edges"sv, stats.edges);
 
-        // Инициализируем io_context
-        const unsigned num_threads = std::thread::hardware_concurrency();
-        net::io_context ioc(num_threads);
+            BOOST_LOG_TRIVIAL(info)
+                << logging::add_value(additional_data, std::move(data))
+                << "map compiled"sv;
+        }
+
+        const unsigned num_threads =
+            args.threads ? args.threads
+                         : std::max(1u, std::thread::hardware_concurrency());
+
+        // Общие для всех acceptor'ов ограничения. Создаются раньше
+        // io_context'ов, так как сессии, уничтожаемые вместе с ними,
+        // освобождают свои места
+        const auto admission =
+            std::make_shared<http_server::AdmissionControl>(args.admission);
+
+        // В режиме reuse_port у каждого рабочего потока свой io_context, и
+        // сессия обслуживается тем потоком, который принял соединение.
+        // Иначе все потоки обслуживают общий io_context
+        std::vector<std::unique_ptr<net::io_context>> contexts;
+        if (args.reuse_port) {
+            for (unsigned i = 0; i < num_threads; ++i) {
+                // Подсказка 1 позволяет io_context обходиться без блокировок
+                // внутри планировщика
+                contexts.push_back(std::make_unique<net::io_context>(1));
+            }
+        } else {
+            contexts.push_back(std::make_unique<net::io_context>(num_threads));
+        }
 
         // Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
         // Подписываемся на сигналы и при их получении завершаем работу сервера
-        net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc](const sys::error_code &ec,
-                                  [[maybe_unused]] int signal_number) {
+        net::signal_set signals(*contexts.front(), SIGINT, SIGTERM);
+        signals.async_wait([&contexts](const sys::error_code &ec,
+                                       [[maybe_unused]] int signal_number) {
             if (!ec) {
-                ioc.stop();
+                for (auto &ioc : contexts) {
+                    ioc->stop();
+                }
             }
             OnExit(EXIT_SUCCESS, {});
         });
 
+        http_handler::LogSampler log_sampler{args.request_log};
+        net::steady_timer log_flush_timer{*contexts.front()};
+        ScheduleLogFlush(log_flush_timer, log_sampler,
+                         log_sampler.GetAggregateInterval());
+
         // Создаём контекст HTTP-запросов
         http_handler::RequestHandler::Context context{
             .game = game,
             .static_content_directory_path = std::move(static_content),
+            .static_cache_size = args.static_cache_size,
+            .sendfile_threshold = args.sendfile_threshold,
+            .log_sampler = log_sampler,
+            .admin_token = args.admin_token,
+            .file_io = args.file_io,
+            .blocking_io = args.blocking_io,
+            .retry_after = admission->GetLimits().retry_after,
+            .setup_service_thread = topology.MakeServiceSetup(),
         };
 
         // Создаём обработчик HTTP-запросов и связываем его с контекстом
         http_handler::RequestHandler handler(context);
 
-        http_handler::LoggingRequestHandler logging_handler{handler};
+        http_handler::LoggingRequestHandler logging_handler{handler,
+                                                            log_sampler};
 
         // Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
 
-        http_server::ServeHttp(
-            ioc, {address, port},
-            [&logging_handler](auto &&endpoint, auto &&req, auto &&sender) {
-                logging_handler(std::forward<decltype(endpoint)>(endpoint),
-                                std::forward<decltype(req)>(req),
-                                std::forward<decltype(sender)>(sender));
-            });
+        // Обработчик запросов общий для всех потоков: модель игры и кеш
+        // ответов после старта только читаются, а кеш статики защищён
+        // мьютексом
+        for (auto &ioc : contexts) {
+            http_server::ServeHttp(
+                *ioc, {address, port},
+                [&logging_handler](auto &&endpoint, auto &&req,
+                                   auto &&sender) {
+                    logging_handler(std::forward<decltype(endpoint)>(endpoint),
+                                    std::forward<decltype(req)>(req),
+                                    std::forward<decltype(sender)>(sender));
+                },
+                {.reuse_port = args.reuse_port,
+                 .admission = admission,
+                 .engine = args.session_engine});
+        }
 
         {
-            json::object data;
-
-            data["port"] = port;
-            data["address"] = address.to_string();
+            std::string data;
+            logs::JsonObjectWriter{data}
+                .Add("port"sv, port)
+                .Add("address"sv, address.to_string());
 
             BOOST_LOG_TRIVIAL(info)
                 << logging::add_value(additional_data, std::move(data))
@@ -118,11 +219,21 @@ int main(int argc, const char *argv[]) {
         }
 
         // Запускаем обработку асинхронных операций
-        RunWorkers(std::max(1u, num_threads), [&ioc] { ioc.run(); });
+        RunWorkers(num_threads, [&contexts, &topology](unsigned index) {
+            topology.Apply(index);
+            contexts[index % contexts.size()]->run();
+        });
+        admission->Stop();
+
+        // Выводим сводки по запросам, накопленные с последнего вывода
+        log_sampler.Flush();
     } catch (const std::exception &ex) {
         std::cerr << ex.what() << std::endl;
 
         OnExit(EXIT_FAILURE, ex.what());
+        logs::shutdown();
         return EXIT_FAILURE;
     }
+
+    logs::shutdown();
 }
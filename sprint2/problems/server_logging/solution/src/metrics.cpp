@@ -0,0 +1,332 @@
+#include "metrics.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace metrics {
+
+using namespace std::literals;
+
+namespace {
+
+constexpr std::size_t COUNTER_COUNT =
+    static_cast<std::size_t>(Counter::BLOCKING_IO_REJECTED) + 1;
+constexpr std::size_t GAUGE_COUNT =
+    static_cast<std::size_t>(Gauge::ACTIVE_SESSIONS) + 1;
+
+// Интервалы гистограммы: [0, 1) и [1, 2) мкс, затем по два интервала на
+// каждую степень двойки: [2^k, 1.5 * 2^k) и [1.5 * 2^k, 2^(k+1)) до
+// 2^MAX_OCTAVE мкс (около двух минут), и последний интервал для всего, что
+// больше
+constexpr unsigned MAX_OCTAVE = 27;
+constexpr std::size_t BUCKET_COUNT = 2 * MAX_OCTAVE + 1;
+
+std::size_t GetBucket(std::uint64_t microseconds) noexcept {
+    if (microseconds < 2) {
+        return microseconds;
+    }
+    const unsigned octave = std::bit_width(microseconds) - 1;
+    if (octave >= MAX_OCTAVE) {
+        return BUCKET_COUNT - 1;
+    }
+    return 2 * octave + ((microseconds >> (octave - 1)) & 1);
+}
+
+// Верхняя граница интервала bucket (не включая её), мкс
+std::uint64_t GetBucketBound(std::size_t bucket) noexcept {
+    if (bucket < 2) {
+        return bucket + 1;
+    }
+    const std::uint64_t base = std::uint64_t{1} << (bucket / 2);
+    return bucket % 2 == 0 ? base + base / 2 : base * 2;
+}
+
+// Увеличивает значение, которое меняет только текущий поток. Другие потоки
+// его лишь читают, поэтому хватает обычных загрузки и сохранения
+template <typename T>
+void AddLocal(std::atomic<T> &value, T delta) noexcept {
+    value.store(value.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+struct Histogram {
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<std::uint64_t> sum_microseconds{0};
+};
+
+struct HistogramKey {
+    // Маршруты сравниваются по адресу строки: шаблоны маршрутов хранятся в
+    // Router в единственном экземпляре. При выводе гистограммы одинаковых
+    // маршрутов всё равно объединяются по содержимому
+    const char *route_data;
+    std::size_t route_size;
+    unsigned code;
+
+    bool operator==(const HistogramKey &) const = default;
+};
+
+struct HistogramKeyHasher {
+    size_t operator()(const HistogramKey &key) const noexcept {
+        return std::hash<const void *>{}(key.route_data) * 31 +
+               key.route_size * 1009 + key.code;
+    }
+};
+
+// Показатели одного потока
+struct Shard {
+    std::array<std::atomic<std::uint64_t>, COUNTER_COUNT> counters{};
+    std::array<std::atomic<std::int64_t>, GAUGE_COUNT> gauges{};
+
+    // Защищает структуру histograms: её меняет только поток-владелец при
+    // вставке, а читает Render
+    std::mutex mutex;
+    std::unordered_map<HistogramKey, std::unique_ptr<Histogram>,
+                       HistogramKeyHasher>
+        histograms;
+};
+
+class Registry {
+  public:
+    static Registry &Instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    Shard &LocalShard() {
+        // Наборы счётчиков не удаляются при завершении потока, чтобы
+        // накопленные им значения не пропали
+        thread_local Shard *shard = AddShard();
+        return *shard;
+    }
+
+    template <typename Fn> void ForEachShard(Fn &&fn) {
+        std::lock_guard lock{mutex_};
+        for (const auto &shard : shards_) {
+            fn(*shard);
+        }
+    }
+
+  private:
+    Shard *AddShard() {
+        std::lock_guard lock{mutex_};
+        return shards_.emplace_back(std::make_unique<Shard>()).get();
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+void AppendLabelValue(std::string &out, std::string_view value) {
+    for (const char c : value) {
+        if (c == '\\' || c == '"') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out += c;
+        }
+    }
+}
+
+void AppendSeconds(std::string &out, std::uint64_t microseconds) {
+    out += std::to_string(microseconds / 1'000'000);
+    out += '.';
+    const auto fraction = std::to_string(microseconds % 1'000'000);
+    out.append(6 - fraction.size(), '0');
+    out += fraction;
+}
+
+void AppendMetric(std::string &out, std::string_view name,
+                  std::string_view type, std::string_view help,
+                  std::string_view value) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+    out += name;
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+} // namespace
+
+void Increment(Counter counter, std::uint64_t value) noexcept {
+    AddLocal(Registry::Instance()
+                 .LocalShard()
+                 .counters[static_cast<std::size_t>(counter)],
+             value);
+}
+
+void Add(Gauge gauge, std::int64_t delta) noexcept {
+    AddLocal(
+        Registry::Instance().LocalShard().gauges[static_cast<std::size_t>(
+            gauge)],
+        delta);
+}
+
+void RecordRequest(std::string_view route, unsigned code,
+                   std::chrono::nanoseconds duration) {
+    auto &shard = Registry::Instance().LocalShard();
+
+    const HistogramKey key{route.data(), route.size(), code};
+    auto it = shard.histograms.find(key);
+    if (it == shard.histograms.end()) {
+        std::lock_guard lock{shard.mutex};
+        it = shard.histograms.emplace(key, std::make_unique<Histogram>())
+                 .first;
+    }
+
+    const auto microseconds = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration)
+            .count());
+
+    auto &histogram = *it->second;
+    AddLocal(histogram.buckets[GetBucket(microseconds)], std::uint64_t{1});
+    AddLocal(histogram.sum_microseconds, microseconds);
+}
+
+std::string Render(const BlockingIoGauges &blocking_io) {
+    struct Merged {
+        std::array<std::uint64_t, BUCKET_COUNT> buckets{};
+        std::uint64_t sum_microseconds = 0;
+    };
+
+    std::array<std::uint64_t, COUNTER_COUNT> counters{};
+    std::array<std::int64_t, GAUGE_COUNT> gauges{};
+    std::map<std::pair<std::string_view, unsigned>, Merged> histograms;
+
+    Registry::Instance().ForEachShard([&](Shard &shard) {
+        for (std::size_t i = 0; i < COUNTER_COUNT; ++i) {
+            counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < GAUGE_COUNT; ++i) {
+            gauges[i] += shard.gauges[i].load(std::memory_order_relaxed);
+        }
+
+        std::lock_guard lock{shard.mutex};
+        for (const auto &[key, histogram] : shard.histograms) {
+            auto &merged = histograms[{
+                std::string_view{key.route_data, key.route_size}, key.code}];
+            for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+                merged.buckets[i] +=
+                    histogram->buckets[i].load(std::memory_order_relaxed);
+            }
+            merged.sum_microseconds +=
+                histogram->sum_microseconds.load(std::memory_order_relaxed);
+        }
+    });
+
+    std::string out;
+
+    constexpr auto DURATION = "http_request_duration_seconds"sv;
+    out += "# HELP http_request_duration_seconds Request handling time\n";
+    out += "# TYPE http_request_duration_seconds histogram\n";
+
+    for (const auto &[key, merged] : histograms) {
+        std::string labels = "route=\"";
+        AppendLabelValue(labels, key.first);
+        labels += "\",code=\"";
+        labels += std::to_string(key.second);
+        labels += '"';
+
+        std::uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+            cumulative += merged.buckets[i];
+            out += DURATION;
+            out += "_bucket{";
+            out += labels;
+            out += ",le=\"";
+            if (i + 1 == BUCKET_COUNT) {
+                out += "+Inf";
+            } else {
+                AppendSeconds(out, GetBucketBound(i));
+            }
+            out += "\"} ";
+            out += std::to_string(cumulative);
+            out += '\n';
+        }
+
+        out += DURATION;
+        out += "_sum{" + labels + "} ";
+        AppendSeconds(out, merged.sum_microseconds);
+        out += '\n';
+
+        out += DURATION;
+        out += "_count{" + labels + "} ";
+        out += std::to_string(cumulative);
+        out += '\n';
+    }
+
+    auto counter = [&counters](Counter c) {
+        return std::to_string(counters[static_cast<std::size_t>(c)]);
+    };
+
+    AppendMetric(out, "http_received_bytes_total"sv, "counter"sv,
+                 "Bytes read from clients"sv,
+                 counter(Counter::BYTES_RECEIVED));
+    AppendMetric(out, "http_sent_bytes_total"sv, "counter"sv,
+                 "Bytes written to clients"sv, counter(Counter::BYTES_SENT));
+    AppendMetric(out, "http_accept_errors_total"sv, "counter"sv,
+                 "Failed accepts of incoming connections"sv,
+                 counter(Counter::ACCEPT_ERRORS));
+    AppendMetric(out, "errors_reported_total"sv, "counter"sv,
+                 "Errors written to the log"sv,
+                 counter(Counter::ERRORS_REPORTED));
+    AppendMetric(out, "http_accept_pauses_total"sv, "counter"sv,
+                 "Times accepting was paused at the session limit"sv,
+                 counter(Counter::ACCEPT_PAUSES));
+
+    out += "# HELP http_rejected_total Connections and requests answered "
+           "with 503\n";
+    out += "# TYPE http_rejected_total counter\n";
+    for (const auto &[reason, c] :
+         {std::pair{"sessions"sv, Counter::REJECTED_SESSIONS},
+          std::pair{"sessions_per_ip"sv, Counter::REJECTED_SESSIONS_PER_IP},
+          std::pair{"in_flight"sv, Counter::REJECTED_REQUESTS}}) {
+        out += "http_rejected_total{reason=\"";
+        out += reason;
+        out += "\"} ";
+        out += counter(c);
+        out += '\n';
+    }
+
+    AppendMetric(out, "http_arena_heap_allocations_total"sv, "counter"sv,
+                 "Heap allocations of session arenas beyond their buffers"sv,
+                 counter(Counter::ARENA_HEAP_ALLOCATIONS));
+    auto gauge = [&gauges](Gauge g) {
+        return std::to_string(gauges[static_cast<std::size_t>(g)]);
+    };
+
+    AppendMetric(out, "http_active_sessions"sv, "gauge"sv,
+                 "Open client connections"sv, gauge(Gauge::ACTIVE_SESSIONS));
+
+    AppendMetric(out, "blocking_io_queue_depth"sv, "gauge"sv,
+                 "Jobs waiting for a blocking I/O thread"sv,
+                 std::to_string(blocking_io.queued));
+    AppendMetric(out, "blocking_io_busy_threads"sv, "gauge"sv,
+                 "Blocking I/O threads running a job"sv,
+                 std::to_string(blocking_io.busy));
+    AppendMetric(out, "blocking_io_jobs_total"sv, "counter"sv,
+                 "Jobs run by blocking I/O threads"sv,
+                 counter(Counter::BLOCKING_IO_JOBS));
+    AppendMetric(out, "blocking_io_rejected_total"sv, "counter"sv,
+                 "Jobs rejected because the blocking I/O queue was full"sv,
+                 counter(Counter::BLOCKING_IO_REJECTED));
+
+    return out;
+}
+
+} // namespace metrics
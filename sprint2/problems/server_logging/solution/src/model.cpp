@@ -22,6 +22,8 @@ void Map::AddOffice(Office office) {
 }
 
 void Game::AddMap(Map map) {
+    map.Compile();
+
     const size_t index = maps_.size();
     if (auto [it, inserted] = map_id_to_index_.emplace(map.GetId(), index); !inserted) {
         throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
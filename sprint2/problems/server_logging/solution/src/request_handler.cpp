@@ -1,39 +1,88 @@
 #include "request_handler.hpp"
+#include "byte_ranges.hpp"
 #include "errors.hpp"
 #include "logs.hpp"
 #include "model.hpp"
 
 #include <boost/algorithm/string.hpp>
-#include <boost/lexical_cast/try_lexical_convert.hpp>
 
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <unordered_map>
 
 namespace http_handler {
 
 using namespace std::string_view_literals;
 
+namespace fs = std::filesystem;
+
 namespace {
 
-StringResponse MakeStringResponse(http::status status, std::string_view body,
-                                  unsigned http_version, bool keep_alive,
-                                  std::string_view content_type) {
-    StringResponse response(status, http_version);
+constexpr auto MAPS_API_PATH = "/api/v1/maps"sv;
+constexpr auto LOG_SAMPLING_PATH = "/admin/log-sampling"sv;
+constexpr auto METRICS_PATH = "/metrics"sv;
 
-    response.set(http::field::content_type, content_type);
-    response.body() = body;
-    response.content_length(body.size());
-    response.keep_alive(keep_alive);
+// Начальный размер буфера для поля data записей лога, которого хватает,
+// чтобы при его заполнении строка не перевыделялась
+constexpr std::size_t LOG_DATA_RESERVE = 96;
+
+// Буфер для IP-адреса в текстовом виде: IPv6 и номер зоны после '%'
+using AddressText = std::array<char, INET6_ADDRSTRLEN + 11>;
+
+// Записывает адрес в buffer так же, как address::to_string, но без
+// выделения памяти. Зона IPv6 записывается номером интерфейса
+std::string_view FormatAddress(const net::ip::address &address,
+                               AddressText &buffer) {
+    if (address.is_v4()) {
+        const auto bytes = address.to_v4().to_bytes();
+        if (!::inet_ntop(AF_INET, bytes.data(), buffer.data(), buffer.size())) {
+            return {};
+        }
+        return buffer.data();
+    }
 
+    const auto v6 = address.to_v6();
+    const auto bytes = v6.to_bytes();
+    if (!::inet_ntop(AF_INET6, bytes.data(), buffer.data(), buffer.size())) {
+        return {};
+    }
+    char *end = buffer.data() + std::char_traits<char>::length(buffer.data());
+    if (v6.scope_id() != 0) {
+        *end++ = '%';
+        end = std::to_chars(end, buffer.data() + buffer.size(), v6.scope_id())
+                  .ptr;
+    }
+    return {buffer.data(), static_cast<std::size_t>(end - buffer.data())};
+}
+
+// Ответ на запрос req без полей и тела. Поля ответа размещаются в той же
+// арене, что и запрос
+template <typename ResponseType>
+ResponseType MakeResponse(const StringRequest &req, http::status status) {
+    ResponseType response{std::piecewise_construct, std::make_tuple(),
+                          std::make_tuple(req.get_allocator())};
+    response.result(status);
+    response.version(req.version());
     return response;
 }
 
 StringResponse TextRespose(const StringRequest &req, http::status status,
                            std::string_view text,
                            std::string_view content_type) {
-    return MakeStringResponse(status, text, req.version(), req.keep_alive(),
-                              content_type);
+    auto response = MakeResponse<StringResponse>(req, status);
+
+    response.set(http::field::content_type, content_type);
+    response.body() = text;
+    response.content_length(text.size());
+    response.keep_alive(req.keep_alive());
+
+    return response;
 }
 
 StringResponse GetBadRequest(StringRequest &&req) {
@@ -42,76 +91,416 @@ StringResponse GetBadRequest(StringRequest &&req) {
                        ContentType::APPLICATION_JSON);
 }
 
+// Ответ на запрос, который сейчас не может быть обработан из-за перегрузки.
+// retry_after - через сколько секунд повторить запрос
+StringResponse GetServiceUnavailable(const StringRequest &req,
+                                     std::string_view retry_after) {
+    auto response = TextRespose(
+        req, http::status::service_unavailable,
+        R"({"code":"serviceUnavailable","message":"Server is overloaded"})"sv,
+        ContentType::APPLICATION_JSON);
+    response.set(http::field::retry_after, retry_after);
+    return response;
+}
+
+StringResponse GetUnauthorized(StringRequest &&req) {
+    auto response = TextRespose(
+        std::move(req), http::status::unauthorized,
+        R"({"code":"invalidToken",)"
+        R"("message":"Authorization header is missing or invalid"})"sv,
+        ContentType::APPLICATION_JSON);
+    response.set(http::field::www_authenticate, "Bearer"sv);
+    return response;
+}
+
+StringResponse GetMethodNotAllowed(StringRequest &&req,
+                                   std::string_view allow) {
+    auto response = TextRespose(
+        std::move(req), http::status::method_not_allowed,
+        R"({"code":"invalidMethod","message":"Invalid method"})"sv,
+        ContentType::APPLICATION_JSON);
+    response.set(http::field::allow, allow);
+    return response;
+}
+
+// Проверяет, что у клиента актуальная версия ресурса
+bool IsNotModified(const StringRequest &req, std::string_view etag,
+                   std::optional<http_cache::HttpTime> last_modified) {
+    using enum http::verb;
+    if (req.method() != get && req.method() != head) {
+        return false;
+    }
+
+    return http_cache::IsNotModified(req[http::field::if_none_match],
+                                     req[http::field::if_modified_since], etag,
+                                     last_modified);
+}
+
+// Ответ 304 Not Modified. Тела нет, а валидаторы передаются, чтобы клиент
+// мог обновить их у себя
+SharedBufferResponse MakeNotModifiedResponse(const StringRequest &req,
+                                             std::string_view etag,
+                                             std::string_view last_modified) {
+    auto response =
+        MakeResponse<SharedBufferResponse>(req, http::status::not_modified);
+
+    response.set(http::field::etag, etag);
+    if (!last_modified.empty()) {
+        response.set(http::field::last_modified, last_modified);
+    }
+    response.keep_alive(req.keep_alive());
+
+    return response;
+}
+
+// Оставляет от ответа только заголовки. Content-Length сохраняется таким же,
+// каким он был бы в ответе на GET
+SharedBufferResponse WithoutBody(Response &&response) {
+    return std::visit(
+        [](auto &&resp) {
+            return SharedBufferResponse{std::move(resp.base())};
+        },
+        std::move(response));
+}
+
+SharedBufferResponse
+MakeCachedResponse(const StringRequest &req,
+                   const http_cache::CachedResponse &cached) {
+    if (IsNotModified(req, cached.etag, cached.last_modified)) {
+        return MakeNotModifiedResponse(req, cached.etag,
+                                       cached.last_modified_date);
+    }
+
+    auto response = MakeResponse<SharedBufferResponse>(req, http::status::ok);
+
+    response.set(http::field::content_type, cached.content_type);
+    response.set(http::field::etag, cached.etag);
+    response.set(http::field::last_modified, cached.last_modified_date);
+    // Тело не копируется: ответ лишь увеличивает счётчик ссылок на буфер
+    response.body() = http_server::SharedBufferBody::value_type{cached.body};
+    response.content_length(cached.ContentLength());
+    response.keep_alive(req.keep_alive());
+
+    return response;
+}
+
+// Проверяет условие If-Range: диапазоны отдаются, только если у клиента та
+// же версия ресурса, что и на сервере. Иначе ресурс отправляется целиком
+bool IsRangeApplicable(const StringRequest &req, std::string_view etag,
+                       http_cache::HttpTime last_modified) {
+    if (req.method() != http::verb::get) {
+        return false;
+    }
+
+    const auto if_range = req[http::field::if_range];
+    if (if_range.empty()) {
+        return true;
+    }
+    if (if_range.starts_with('"')) {
+        // Сильное сравнение: слабый ETag (W/"...") не подходит никогда
+        return if_range == etag;
+    }
+
+    const auto date = http_cache::ParseHttpDate(if_range);
+    return date && *date == last_modified;
+}
+
+RangeRequest GetRangeRequest(const StringRequest &req, std::string_view etag,
+                             http_cache::HttpTime last_modified,
+                             std::uint64_t size) {
+    const auto range = req[http::field::range];
+    if (range.empty() || !IsRangeApplicable(req, etag, last_modified)) {
+        return {};
+    }
+    return ParseRange(range, size);
+}
+
+SharedBufferResponse MakeRangeNotSatisfiableResponse(const StringRequest &req,
+                                                     std::uint64_t size) {
+    auto response = MakeResponse<SharedBufferResponse>(
+        req, http::status::range_not_satisfiable);
+
+    response.set(http::field::content_range, MakeUnsatisfiedContentRange(size));
+    response.content_length(0);
+    response.keep_alive(req.keep_alive());
+
+    return response;
+}
+
+// Тело multipart/byteranges из участков content. Данные частей не
+// копируются: тело ссылается на них и на отдельную строку с заголовками
+http_server::SharedBufferBody::value_type
+MakeMultipartBody(std::shared_ptr<const std::string> content,
+                  const std::vector<ByteRange> &ranges,
+                  const MultipartFraming &framing) {
+    auto text = std::make_shared<std::string>();
+    for (const auto &header : framing.part_headers) {
+        *text += header;
+    }
+    *text += framing.closing;
+
+    std::vector<std::string_view> pieces;
+    pieces.reserve(ranges.size() * 2 + 1);
+
+    const std::string_view all_text = *text;
+    const std::string_view data = *content;
+    std::size_t text_offset = 0;
+
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        const auto header_size = framing.part_headers[i].size();
+        pieces.push_back(all_text.substr(text_offset, header_size));
+        text_offset += header_size;
+
+        pieces.push_back(data.substr(ranges[i].first, ranges[i].Size()));
+    }
+    pieces.push_back(all_text.substr(text_offset));
+
+    return {std::move(content), std::move(text), std::move(pieces)};
+}
+
+// Участки тела multipart/byteranges для отправки файла через sendfile
+std::vector<http_server::SendfileBody::Segment>
+MakeMultipartSegments(const std::vector<ByteRange> &ranges,
+                      MultipartFraming &&framing) {
+    std::vector<http_server::SendfileBody::Segment> segments;
+    segments.reserve(ranges.size() * 2 + 1);
+
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        segments.push_back({.text = std::move(framing.part_headers[i])});
+        segments.push_back(
+            {.offset = ranges[i].first, .size = ranges[i].Size()});
+    }
+    segments.push_back({.text = std::move(framing.closing)});
+
+    return segments;
+}
+
+// Сжатая версия статического файла, лежащая рядом с ним
+struct Precompressed {
+    http_cache::ContentEncoding encoding;
+    // Значение заголовков Accept-Encoding и Content-Encoding
+    std::string_view token;
+    // Расширение, добавляемое к имени исходного файла
+    std::string_view suffix;
+};
+
+// Сжатые версии в порядке предпочтения
+constexpr std::array PRECOMPRESSED{
+    Precompressed{http_cache::ContentEncoding::BROTLI, "br"sv, ".br"sv},
+    Precompressed{http_cache::ContentEncoding::GZIP, "gzip"sv, ".gz"sv},
+};
+
+std::string_view GetEncodingToken(http_cache::ContentEncoding encoding) {
+    for (const auto &precompressed : PRECOMPRESSED) {
+        if (precompressed.encoding == encoding) {
+            return precompressed.token;
+        }
+    }
+    return {};
+}
+
+// Проверяет, принимает ли клиент кодирование token согласно заголовку
+// Accept-Encoding вида "gzip;q=0.8, br, *;q=0"
+bool IsEncodingAccepted(std::string_view accept_encoding,
+                        std::string_view token) {
+    std::optional<bool> accepted;
+    std::optional<bool> accepted_by_wildcard;
+
+    while (!accept_encoding.empty()) {
+        const auto comma = accept_encoding.find(',');
+        auto item = accept_encoding.substr(0, comma);
+        accept_encoding.remove_prefix(comma == std::string_view::npos
+                                          ? accept_encoding.size()
+                                          : comma + 1);
+
+        const auto semicolon = item.find(';');
+        const auto name =
+            boost::algorithm::trim_copy(item.substr(0, semicolon));
+
+        double quality = 1.0;
+        if (semicolon != std::string_view::npos) {
+            auto params = item.substr(semicolon + 1);
+            if (const auto q = params.find("q="sv); q != params.npos) {
+                params.remove_prefix(q + 2);
+                std::from_chars(params.data(), params.data() + params.size(),
+                                quality);
+            }
+        }
+
+        if (boost::algorithm::iequals(name, token)) {
+            accepted = quality > 0;
+        } else if (name == "*"sv) {
+            accepted_by_wildcard = quality > 0;
+        }
+    }
+
+    return accepted.value_or(accepted_by_wildcard.value_or(false));
+}
+
+// Выбирает версию файла, которую принимает клиент, в порядке предпочтения
+http_cache::StaticFileSet::FilePtr
+ChooseEncoding(const http_cache::StaticFileSet &files,
+               std::string_view accept_encoding) {
+    for (const auto &precompressed : PRECOMPRESSED) {
+        const auto &file = files.Get(precompressed.encoding);
+        if (file && IsEncodingAccepted(accept_encoding, precompressed.token)) {
+            return file;
+        }
+    }
+    return files.Get(http_cache::ContentEncoding::IDENTITY);
+}
+
+// Возвращает путь к сжатой версии файла, если она существует и не старше
+// исходного файла
+std::optional<fs::path> FindPrecompressed(const fs::path &full_path,
+                                          std::string_view suffix,
+                                          fs::file_time_type last_write_time) {
+    std::error_code ec;
+    fs::path path = full_path;
+    path += suffix;
+
+    if (fs::is_regular_file(path, ec) &&
+        fs::last_write_time(path, ec) >= last_write_time && !ec) {
+        return path;
+    }
+    return std::nullopt;
+}
+
 } // namespace
 
 RequestHandler::RequestHandler(const Context &c)
-    : game_(c.game), content_root_(std::move(c.static_content_directory_path)) {
+    : game_(c.game), content_root_(std::move(c.static_content_directory_path)),
+      sendfile_threshold_(c.sendfile_threshold), file_io_(c.file_io),
+      static_cache_(std::make_unique<http_cache::StaticContentCache>(
+          content_root_, c.static_cache_size)),
+      log_sampler_(c.log_sampler), admin_token_(c.admin_token),
+      retry_after_(std::to_string(c.retry_after.count())),
+      blocking_io_(std::make_unique<BlockingIoPool>(c.blocking_io,
+                                                    c.setup_service_thread)) {
+    static_cache_->StartWatching(c.setup_service_thread);
+
+    using enum http::verb;
+    // Ответ на HEAD формируется так же, как на GET, а тело отбрасывается в
+    // operator()
+    router_.AddRoute(MAPS_API_PATH, {get, head},
+                     &RequestHandler::MakeAllMapsResponse)
+        .AddRoute("/api/v1/maps/{id}"sv, {get, head},
+                  &RequestHandler::MakeCurrentMapResponse)
+        .AddRoute("/api/{*path}"sv, {}, &RequestHandler::MakeBadRequestResponse)
+        .AddRoute("/{*path}"sv, {}, &RequestHandler::ServeStaticFile);
+
+    // Метрики только читаются, поэтому доступны всегда, а изменять настройки
+    // сервера можно лишь с токеном
+    router_.AddRoute(METRICS_PATH, {get, head}, &RequestHandler::GetMetrics);
+    if (!admin_token_.empty()) {
+        router_
+            .AddRoute(LOG_SAMPLING_PATH, {get, head},
+                      &RequestHandler::GetLogSampling)
+            .AddRoute(LOG_SAMPLING_PATH, {put, post},
+                      &RequestHandler::SetLogSampling);
+    }
+
+    for (const auto pattern : router_.Patterns()) {
+        log_sampler_.AddRoute(pattern);
+    }
+
+    // Модель игры не меняется после загрузки, поэтому ответы API карт
+    // сериализуются один раз при старте сервера
+    response_cache_.Register(std::string{MAPS_API_PATH},
+                             json_loader::GetAllMapsInfoAsJsonString(game_),
+                             ContentType::APPLICATION_JSON);
+
+    for (const auto &map : game_.GetMaps()) {
+        map_responses_.Register(*map.GetId(),
+                                json_loader::GetMapInfoAsJsonString(map),
+                                ContentType::APPLICATION_JSON);
+    }
+}
+
+RequestHandler::Result
+RequestHandler::MakeAllMapsResponse(StringRequest &&req, const RouteParams &) {
+    return MakeCachedResponse(req, *response_cache_.Find(MAPS_API_PATH));
 }
 
-StringResponse RequestHandler::MakeAllMapsResponse(StringRequest &&req) {
-    return TextRespose(std::move(req), http::status::ok,
-                       json_loader::GetAllMapsInfoAsJsonString(game_),
+RequestHandler::Result
+RequestHandler::MakeCurrentMapResponse(StringRequest &&req,
+                                       const RouteParams &params) {
+    if (auto cached = map_responses_.Find(params.Get("id"sv))) {
+        return MakeCachedResponse(req, *cached);
+    }
+
+    return TextRespose(std::move(req), http::status::not_found,
+                       R"({"code":"mapNotFound","message":"Map not found"})"sv,
                        ContentType::APPLICATION_JSON);
 }
 
-StringResponse RequestHandler::MakeCurrentMapResponse(StringRequest &&req) {
-    std::string_view path = req.target();
-    std::vector<std::string> path_segments;
-    boost::split(path_segments, path, boost::is_any_of("/"));
+RequestHandler::Result
+RequestHandler::MakeBadRequestResponse(StringRequest &&req,
+                                       const RouteParams &) {
+    return GetBadRequest(std::move(req));
+}
 
-    if (path_segments.size() < 5) {
-        std::cerr << "Invalid URI format"sv << std::endl;
-        return GetBadRequest(std::move(req));
+bool RequestHandler::IsAdminAuthorized(
+    const StringRequest &req) const noexcept {
+    constexpr auto BEARER = "Bearer "sv;
+
+    std::string_view token = req[http::field::authorization];
+    if (!token.starts_with(BEARER)) {
+        return false;
+    }
+    token.remove_prefix(BEARER.size());
+    if (token.size() != admin_token_.size()) {
+        return false;
     }
 
-    std::string map_id{};
-    if (!boost::conversion::detail::try_lexical_convert(path_segments[4],
-                                                        map_id)) {
-        std::cerr << "Invalid map ID in the URI"sv << std::endl;
-        return GetBadRequest(std::move(req));
+    // Время сравнения не зависит от позиции первого несовпадающего символа
+    unsigned char difference = 0;
+    for (std::size_t i = 0; i < token.size(); ++i) {
+        difference |= static_cast<unsigned char>(token[i] ^ admin_token_[i]);
     }
+    return difference == 0;
+}
 
-    auto map_ptr = game_.FindMap(model::Map::Id(map_id));
-    if (!map_ptr) {
-        return TextRespose(
-            std::move(req), http::status::not_found,
-            R"({"code":"mapNotFound","message":"Map not found"})"sv,
-            ContentType::APPLICATION_JSON);
+RequestHandler::Result
+RequestHandler::GetLogSampling(StringRequest &&req, const RouteParams &) {
+    if (!IsAdminAuthorized(req)) {
+        return GetUnauthorized(std::move(req));
     }
 
-    return TextRespose(std::move(req), http::status::ok,
-                       json_loader::GetMapInfoAsJsonString(*map_ptr),
+    return TextRespose(req, http::status::ok, log_sampler_.SettingsToJson(),
                        ContentType::APPLICATION_JSON);
 }
 
-StringResponse RequestHandler::HandleGetRequest(StringRequest &&req) {
-    auto path = req.target();
-    if ("/api/v1/maps"sv == path) {
-        return MakeAllMapsResponse(std::move(req));
+RequestHandler::Result
+RequestHandler::SetLogSampling(StringRequest &&req, const RouteParams &) {
+    if (!IsAdminAuthorized(req)) {
+        return GetUnauthorized(std::move(req));
     }
 
-    if (path.starts_with("/api/v1/maps/"sv)) {
-        return MakeCurrentMapResponse(std::move(req));
+    try {
+        const auto settings = json::parse(req.body());
+        if (!settings.is_object()) {
+            throw std::invalid_argument("Settings must be an object");
+        }
+        log_sampler_.ApplySettings(settings.as_object());
+    } catch (const std::exception &) {
+        return TextRespose(
+            req, http::status::bad_request,
+            R"({"code":"invalidArgument","message":"Invalid settings"})"sv,
+            ContentType::APPLICATION_JSON);
     }
 
-    return GetBadRequest(std::move(req));
+    return TextRespose(req, http::status::ok, log_sampler_.SettingsToJson(),
+                       ContentType::APPLICATION_JSON);
 }
 
-StringResponse RequestHandler::HandleApiRequest(StringRequest &&req) {
-    switch (req.method()) {
-        using enum http::verb;
-    case get:
-        return HandleGetRequest(std::move(req));
-    case head:
-        // FIX: TODO:
-        return GetBadRequest(std::move(req));
-    default:
-        return GetBadRequest(std::move(req));
-    }
+RequestHandler::Result
+RequestHandler::GetMetrics(StringRequest &&req, const RouteParams &) {
+    return TextRespose(req, http::status::ok,
+                       metrics::Render(blocking_io_->GetGauges()),
+                       ContentType::PROMETHEUS_TEXT);
 }
 
-namespace fs = std::filesystem;
-
 std::string_view GetContentTypeByExtension(std::string extension) {
     boost::to_lower(extension);
 
@@ -146,6 +535,22 @@ std::string_view GetContentTypeByExtension(std::string extension) {
     return ContentType::APPLICATION_OCTET_STREAM;
 }
 
+bool IsCompressibleFile(const fs::path &path) {
+    auto extension = path.extension().string();
+    boost::to_lower(extension);
+
+    // svgz уже сжат, хотя и имеет тип image/svg+xml
+    if (extension == ".svgz"sv) {
+        return false;
+    }
+
+    const auto content_type = GetContentTypeByExtension(std::move(extension));
+    return content_type.starts_with("text/"sv) ||
+           content_type == ContentType::APPLICATION_JSON ||
+           content_type == ContentType::APPLICATION_XML ||
+           content_type == ContentType::IMAGE_SVG;
+}
+
 using namespace std::string_literals;
 
 std::string url_decode(const std::string_view str) {
@@ -172,76 +577,499 @@ std::string url_decode(const std::string_view str) {
     return result;
 }
 
-StringResponse RequestHandler::ServeStaticFile(StringRequest &&req) {
-    std::error_code ec{};
+SharedBufferResponse
+RequestHandler::MakeStaticFileResponse(const StringRequest &req,
+                                       StaticFilePtr file) {
+    if (IsNotModified(req, file->etag, file->LastModified())) {
+        auto response = MakeNotModifiedResponse(req, file->etag,
+                                                file->last_modified_date);
+        if (file->vary_by_encoding) {
+            response.set(http::field::vary, "Accept-Encoding"sv);
+        }
+        return response;
+    }
+
+    const auto range = GetRangeRequest(req, file->etag, file->LastModified(),
+                                       file->Size());
+    if (range.status == RangeRequest::Status::NOT_SATISFIABLE) {
+        return MakeRangeNotSatisfiableResponse(req, file->Size());
+    }
+
+    auto response = MakeResponse<SharedBufferResponse>(req, http::status::ok);
+
+    response.set(http::field::content_type, file->content_type);
+    response.set(http::field::etag, file->etag);
+    response.set(http::field::last_modified, file->last_modified_date);
+    response.set(http::field::accept_ranges, "bytes"sv);
+    if (file->encoding != http_cache::ContentEncoding::IDENTITY) {
+        response.set(http::field::content_encoding,
+                     GetEncodingToken(file->encoding));
+    }
+    if (file->vary_by_encoding) {
+        response.set(http::field::vary, "Accept-Encoding"sv);
+    }
+    response.keep_alive(req.keep_alive());
+
+    if (range.status == RangeRequest::Status::NONE) {
+        response.body() =
+            http_server::SharedBufferBody::value_type{file->content};
+    } else if (range.ranges.size() == 1) {
+        const auto &byte_range = range.ranges.front();
+
+        response.result(http::status::partial_content);
+        response.set(http::field::content_range,
+                     MakeContentRange(byte_range, file->Size()));
+        response.body() = http_server::SharedBufferBody::value_type{
+            file->content, std::string_view{*file->content}.substr(
+                               byte_range.first, byte_range.Size())};
+    } else {
+        const auto framing = MakeMultipartFraming(
+            range.ranges, file->content_type, file->Size());
+
+        response.result(http::status::partial_content);
+        response.set(http::field::content_type, framing.content_type);
+        response.body() =
+            MakeMultipartBody(file->content, range.ranges, framing);
+    }
 
+    response.content_length(response.body().Size());
+
+    return response;
+}
+
+RequestHandler::Result
+RequestHandler::ServeStaticFile(StringRequest &&req, const RouteParams &) {
     auto path = url_decode(req.target());
     if (path.empty()) {
         path = "index.html"sv;
     }
 
-    fs::path full_path = fs::canonical(fs::path(content_root_) / path, ec);
+    const auto accept_encoding = req[http::field::accept_encoding];
+
+    // Закешированный файл отдаётся без обращений к файловой системе.
+    // Сжатые версии кешируются и вытесняются вместе с исходным файлом,
+    // поэтому их отсутствие в наборе означает, что на диске их нет
+    if (const auto cached = static_cache_->Find(path)) {
+        return MakeStaticFileResponse(
+            req, ChooseEncoding(*cached, accept_encoding));
+    }
+
+    // Файл ищется и читается в пуле блокирующего ввода-вывода, чтобы
+    // io-поток тем временем обслуживал другие запросы
+    return StaticFileRead{.req = std::move(req),
+                          .request_path = std::move(path)};
+}
+
+void RequestHandler::LoadStaticFile(std::shared_ptr<StaticFileLoad> state,
+                                    const net::any_io_executor &executor) {
+    auto finish = [this](StaticFileLoad &state) {
+        Response response =
+            MakeLoadedFileResponse(state.read, std::move(state.info));
+        if (state.read.is_head) {
+            response = WithoutBody(std::move(response));
+        }
+        state.Reply(std::move(response));
+    };
+
+    // Поток пула не обращается к запросу: поля запроса размещены в арене
+    // сессии, которой пользуется только её strand
+    const auto &req = state->read.req;
+    StaticFileHeaders headers{
+        .accept_encoding = std::string{req[http::field::accept_encoding]},
+        .if_none_match = {},
+        .if_modified_since = {},
+        .is_head = state->read.is_head,
+    };
+    using enum http::verb;
+    if (req.method() == get || req.method() == head) {
+        headers.if_none_match = req[http::field::if_none_match];
+        headers.if_modified_since = req[http::field::if_modified_since];
+    }
+    auto job = [this, state, executor, finish,
+                headers = std::move(headers)]() mutable {
+        state->info = OpenStaticFile(state->read.request_path, headers);
+
+        // Состояние передаётся в strand целиком, чтобы запрос и сессия
+        // никогда не уничтожались в потоке пула
+        net::post(executor, [this, state = std::move(state), executor,
+                             finish] {
+            auto &files = state->info.files;
+            if (state->info.status != StaticFileInfo::Status::READ ||
+                file_io_ == FileIo::SYNC) {
+                return finish(*state);
+            }
+
+            // Через io_uring файлы читаются одновременно, а ответ
+            // формируется, когда прочитаны все. Обработчики чтения
+            // вызываются через исполнитель сессии по одному, поэтому
+            // счётчик не требует синхронизации
+            state->remaining = std::count_if(
+                files.begin(), files.end(),
+                [](const auto &file) { return file.opened.IsOpen(); });
+            if (state->remaining == 0) {
+                return finish(*state);
+            }
+            for (std::size_t i = 0; i < files.size(); ++i) {
+                if (!files[i].opened.IsOpen()) {
+                    continue;
+                }
+                ReadOpenedFile(executor, std::move(files[i].opened),
+                               [state, finish, i](std::error_code ec,
+                                                  std::string content) {
+                                   if (!ec) {
+                                       state->info.files[i].content =
+                                           std::move(content);
+                                   }
+                                   if (--state->remaining == 0) {
+                                       finish(*state);
+                                   }
+                               });
+            }
+        });
+    };
+
+    if (!blocking_io_->Submit(std::move(job))) {
+        Response response =
+            GetServiceUnavailable(state->read.req, retry_after_);
+        if (state->read.is_head) {
+            response = WithoutBody(std::move(response));
+        }
+        state->Reply(std::move(response));
+    }
+}
+
+RequestHandler::StaticFileInfo
+RequestHandler::OpenStaticFile(const std::string &request_path,
+                               const StaticFileHeaders &headers) const {
+    std::error_code ec{};
+    StaticFileInfo info;
+    info.cache_read = static_cache_->BeginRead();
+
+    fs::path full_path =
+        fs::canonical(fs::path(content_root_) / request_path, ec);
+    // Отсутствующий файл - обычный ответ 404, который и так попадает в лог
+    // запросов
+    if (ec || !fs::is_regular_file(full_path, ec)) {
+        return info;
+    }
+
+    info.relative_path = fs::relative(full_path, content_root_, ec);
+    if (ec) {
+        error::Report({ec.value(), boost::system::system_category()},
+                      "fs::relative"sv);
+        info.status = StaticFileInfo::Status::BAD_REQUEST;
+        return info;
+    }
+    // Путь вида /../secret или ссылка, ведущая за пределы корня статики
+    if (info.relative_path.empty() || *info.relative_path.begin() == ".."sv) {
+        std::string data;
+        logs::JsonObjectWriter{data}.Add("path"sv, request_path);
+
+        BOOST_LOG_TRIVIAL(info)
+            << logging::add_value(additional_data, std::move(data))
+            << "static file outside of content root"sv;
+        info.status = StaticFileInfo::Status::BAD_REQUEST;
+        return info;
+    }
+
+    const auto last_write_time = fs::last_write_time(full_path, ec);
+    info.content_type = GetContentTypeByExtension(full_path.extension());
+    info.compressible = IsCompressibleFile(full_path);
+
+    // Большие файлы не читаются в память, а передаются в сокет ядром.
+    // Открывается одна версия файла: сжатая, если клиент её принимает
+    if (const auto size = fs::file_size(full_path, ec);
+        !ec && size >= sendfile_threshold_) {
+        StaticFileInfo::File file{.path = full_path,
+                                  .last_write_time = {},
+                                  .content = std::nullopt};
+        for (const auto &precompressed : PRECOMPRESSED) {
+            if (!info.compressible ||
+                !IsEncodingAccepted(headers.accept_encoding,
+                                    precompressed.token)) {
+                continue;
+            }
+            if (auto encoded_path = FindPrecompressed(
+                    full_path, precompressed.suffix, last_write_time)) {
+                file.path = std::move(*encoded_path);
+                file.encoding = precompressed.encoding;
+                break;
+            }
+        }
+        file.last_write_time = fs::last_write_time(file.path, ec);
+        file.size = fs::file_size(file.path, ec);
+        if (ec) {
+            return info;
+        }
 
-    if (ec || !fs::exists(full_path) || !fs::is_regular_file(full_path)) {
-        // TODO: USE LOG
-        // error::Report(ec, "File not found: "s.append(path));
-        return TextRespose(std::move(req), http::status::not_found,
-                           "File not found"sv, ContentType::TEXT_PLAIN);
+        // Ответы 304 и ответ на HEAD строятся по времени изменения и
+        // размеру, поэтому файл открывается, только если отправляется тело
+        const auto etag =
+            http_cache::MakeFileETag(file.last_write_time, file.size);
+        const bool not_modified = http_cache::IsNotModified(
+            headers.if_none_match, headers.if_modified_since, etag,
+            http_cache::ToHttpTime(file.last_write_time));
+        if (!headers.is_head && !not_modified) {
+            boost::beast::error_code open_ec;
+            info.sendfile.Open(file.path, open_ec);
+            if (open_ec) {
+                return info;
+            }
+            file.size = info.sendfile.FileSize();
+        }
+        info.status = StaticFileInfo::Status::SENDFILE;
+        info.files.push_back(std::move(file));
+        return info;
     }
 
-    auto relative = fs::relative(full_path, content_root_);
-    if (relative.empty()) {
-        // TODO: USE LOG
-        // error::Report(ec, "File is not in " + content_root_);
-        return GetBadRequest(std::move(req));
+    // Исходный файл и все его сжатые версии читаются и кешируются сразу,
+    // чтобы следующие запросы с любым Accept-Encoding обслуживались из кеша
+    info.status = StaticFileInfo::Status::READ;
+    info.files.push_back({.path = full_path,
+                          .last_write_time = last_write_time,
+                          .content = std::nullopt});
+    if (info.compressible) {
+        for (const auto &precompressed : PRECOMPRESSED) {
+            if (auto encoded_path = FindPrecompressed(
+                    full_path, precompressed.suffix, last_write_time)) {
+                const auto file_time = fs::last_write_time(*encoded_path, ec);
+                info.files.push_back({.path = std::move(*encoded_path),
+                                      .encoding = precompressed.encoding,
+                                      .last_write_time = file_time,
+                                      .content = std::nullopt});
+            }
+        }
     }
 
-    std::ifstream file(full_path.string(), std::ios::binary);
-    std::string content((std::istreambuf_iterator<char>(file)),
-                        std::istreambuf_iterator<char>());
+    // Через io_uring файлы читаются уже из strand сессии, а здесь только
+    // открываются. Файл, который не удалось открыть, считается
+    // непрочитанным
+    for (auto &file : info.files) {
+        if (file_io_ == FileIo::URING) {
+            file.opened = OpenedFile::Open(file.path, ec);
+            continue;
+        }
+        ReadFile(file.path, [&file](std::error_code ec, std::string content) {
+            if (!ec) {
+                file.content = std::move(content);
+            }
+        });
+    }
 
-    std::string_view content_type =
-        GetContentTypeByExtension(full_path.extension());
+    return info;
+}
 
-    return MakeStringResponse(http::status::ok, content, req.version(),
-                              req.keep_alive(), content_type);
+Response RequestHandler::MakeLoadedFileResponse(StaticFileRead &read,
+                                                StaticFileInfo &&info) {
+    const auto &req = read.req;
+    using enum StaticFileInfo::Status;
+
+    if (info.status == BAD_REQUEST) {
+        return GetBadRequest(std::move(read.req));
+    }
+    if (info.status == SENDFILE) {
+        return MakeSendfileResponse(req, std::move(info));
+    }
+    if (info.status == NOT_FOUND || !info.files.front().content) {
+        return TextRespose(req, http::status::not_found, "File not found"sv,
+                           ContentType::TEXT_PLAIN);
+    }
+
+    auto files = std::make_shared<http_cache::StaticFileSet>();
+    for (auto &[file_path, encoding, file_time, file_size, content, opened] :
+         info.files) {
+        if (!content) {
+            continue;
+        }
+
+        auto etag = http_cache::MakeFileETag(file_time, content->size());
+        auto file = std::make_shared<const http_cache::StaticFile>(
+            http_cache::StaticFile{
+                .content =
+                    std::make_shared<const std::string>(std::move(*content)),
+                .content_type = std::string{info.content_type},
+                .etag = std::move(etag),
+                .last_write_time = file_time,
+                .last_modified_date = http_cache::FormatHttpDate(
+                    http_cache::ToHttpTime(file_time)),
+                .relative_path = info.relative_path,
+                .encoding = encoding,
+                .vary_by_encoding = info.compressible,
+            });
+        files->Set(std::move(file));
+    }
+    static_cache_->Insert(read.request_path, files, info.cache_read);
+
+    return MakeStaticFileResponse(
+        req, ChooseEncoding(*files, req[http::field::accept_encoding]));
 }
 
-StringResponse RequestHandler::operator()(StringRequest &&req) {
-    if (req.target().starts_with("/api/")) {
-        return HandleApiRequest(std::move(req));
+Response RequestHandler::MakeSendfileResponse(const StringRequest &req,
+                                              StaticFileInfo &&info) {
+    const auto &file = info.files.front();
+    const auto file_size = file.size;
+    const auto etag = http_cache::MakeFileETag(file.last_write_time, file_size);
+    const auto last_modified = http_cache::ToHttpTime(file.last_write_time);
+    const auto last_modified_date = http_cache::FormatHttpDate(last_modified);
+
+    if (IsNotModified(req, etag, last_modified)) {
+        auto not_modified =
+            MakeNotModifiedResponse(req, etag, last_modified_date);
+        if (info.compressible) {
+            not_modified.set(http::field::vary, "Accept-Encoding"sv);
+        }
+        return not_modified;
     }
 
-    return ServeStaticFile(std::move(req));
+    // Диапазоны отправляются из файла по смещениям, не читая его
+    const auto range = GetRangeRequest(req, etag, last_modified, file_size);
+    if (range.status == RangeRequest::Status::NOT_SATISFIABLE) {
+        return MakeRangeNotSatisfiableResponse(req, file_size);
+    }
+
+    // Для HEAD файл не открывался, поэтому размер тела задаётся явно
+    auto response = MakeResponse<FileResponse>(req, http::status::ok);
+    response.body() = std::move(info.sendfile);
+    response.body().SelectRange(0, file_size);
+
+    response.set(http::field::content_type, info.content_type);
+    response.set(http::field::etag, etag);
+    response.set(http::field::last_modified, last_modified_date);
+    response.set(http::field::accept_ranges, "bytes"sv);
+    if (file.encoding != http_cache::ContentEncoding::IDENTITY) {
+        response.set(http::field::content_encoding,
+                     GetEncodingToken(file.encoding));
+    }
+    if (info.compressible) {
+        response.set(http::field::vary, "Accept-Encoding"sv);
+    }
+    response.keep_alive(req.keep_alive());
+
+    if (range.status == RangeRequest::Status::SATISFIABLE) {
+        response.result(http::status::partial_content);
+
+        if (range.ranges.size() == 1) {
+            const auto &byte_range = range.ranges.front();
+            response.set(http::field::content_range,
+                         MakeContentRange(byte_range, file_size));
+            response.body().SelectRange(byte_range.first, byte_range.Size());
+        } else {
+            auto framing = MakeMultipartFraming(range.ranges,
+                                                info.content_type, file_size);
+            response.set(http::field::content_type, framing.content_type);
+            response.body().SetSegments(
+                MakeMultipartSegments(range.ranges, std::move(framing)));
+        }
+    }
+
+    response.content_length(response.body().Size());
+
+    return response;
+}
+
+RequestHandler::Result RequestHandler::Handle(StringRequest &&req,
+                                              const RouteMatch &match) {
+    const bool is_head = req.method() == http::verb::head;
+
+    Result result;
+    switch (match.status) {
+        using enum Router<RouteHandler>::Match::Status;
+    case FOUND:
+        result = (this->*(*match.handler))(std::move(req), match.params);
+        break;
+    case METHOD_NOT_ALLOWED:
+        result = GetMethodNotAllowed(std::move(req), match.allow);
+        break;
+    case NOT_FOUND:
+        result = GetBadRequest(std::move(req));
+        break;
+    }
+
+    // Ответ на HEAD совпадает с ответом на GET, но не содержит тела. Тело
+    // ответа, который будет сформирован после чтения файла, отбрасывается в
+    // LoadStaticFile
+    if (auto *read = std::get_if<StaticFileRead>(&result)) {
+        read->is_head = is_head;
+    } else if (is_head) {
+        return WithoutBody(std::get<Response>(std::move(result)));
+    }
+
+    return result;
+}
+
+void LoggingRequestHandler::RecordResponse(
+    const http_server::tcp::endpoint endpoint, std::string_view route,
+    bool sampled, std::string_view method, std::string_view target,
+    std::chrono::steady_clock::time_point start_time, const Response &resp) {
+    // Получаем время обработки запроса.
+    const auto elapsed = std::chrono::steady_clock::now() - start_time;
+    auto response_time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+
+    const auto [code, bytes] = std::visit(
+        [](const auto &response) {
+            return std::pair{response.result_int(),
+                             response.payload_size().value_or(0)};
+        },
+        resp);
+
+    metrics::RecordRequest(route, code, elapsed);
+
+    if (sampled) {
+        // Логируем ответ
+        LogResponse(response_time, resp);
+    } else if (sampler_.MustLog(code, response_time)) {
+        LogRequest(endpoint, method, target);
+        LogResponse(response_time, resp);
+    } else {
+        sampler_.Aggregate(
+            route, code, bytes,
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed));
+    }
 }
 
 void LoggingRequestHandler::LogRequest(
-    const http_server::tcp::endpoint endpoint, const StringRequest &req) {
-    json::object request_data;
+    const http_server::tcp::endpoint endpoint, std::string_view method,
+    std::string_view target) {
+    AddressText address;
+    std::string request_data;
+    request_data.reserve(LOG_DATA_RESERVE + target.size());
 
-    request_data["ip"] = endpoint.address().to_string();
-    request_data["URI"] = std::string{req.target()};
-    request_data["method"] = std::string{req.method_string()};
+    logs::JsonObjectWriter{request_data}
+        .Add("ip"sv, FormatAddress(endpoint.address(), address))
+        .Add("URI"sv, target)
+        .Add("method"sv, method);
 
-    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, request_data)
-                            << "request received"sv;
+    BOOST_LOG_TRIVIAL(info)
+        << logging::add_value(additional_data, std::move(request_data))
+        << "request received"sv;
 }
 
 void LoggingRequestHandler::LogResponse(
-    const std::chrono::milliseconds response_time,
-    const StringResponse &response) {
-    json::object request_data;
-    json::string content_type;
-    if (response.has_content_length()) {
-        content_type = std::string{response[http::field::content_type]};
-    }
+    const std::chrono::milliseconds response_time, const Response &response) {
+    std::string_view content_type;
+    unsigned code = 0;
+
+    std::visit(
+        [&content_type, &code](const auto &resp) {
+            if (resp.has_content_length()) {
+                content_type = resp[http::field::content_type];
+            }
+            code = resp.result_int();
+        },
+        response);
+
+    std::string request_data;
+    request_data.reserve(LOG_DATA_RESERVE);
 
-    request_data["response_time"] = response_time.count();
-    request_data["code"] = response.result_int();
-    request_data["content_type"] = content_type;
+    logs::JsonObjectWriter{request_data}
+        .Add("response_time"sv, response_time.count())
+        .Add("code"sv, code)
+        .Add("content_type"sv, content_type);
 
-    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, request_data)
-                            << "response sent"sv;
+    BOOST_LOG_TRIVIAL(info)
+        << logging::add_value(additional_data, std::move(request_data))
+        << "response sent"sv;
 }
 
 } // namespace http_handler
@@ -0,0 +1,56 @@
+#include "response_cache.hpp"
+
+#include <cstdint>
+
+namespace http_cache {
+
+std::string MakeStrongETag(std::string_view body) {
+    // 64-битный FNV-1a: достаточно для различения версий одного ресурса
+    constexpr std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    constexpr std::uint64_t FNV_PRIME = 1099511628211ull;
+
+    std::uint64_t hash = FNV_OFFSET_BASIS;
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= FNV_PRIME;
+    }
+
+    constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+
+    std::string etag(18, '"');
+    for (int i = 16; i > 0; --i) {
+        etag[i] = HEX_DIGITS[hash & 0xF];
+        hash >>= 4;
+    }
+
+    return etag;
+}
+
+const CachedResponse &ResponseCache::Register(std::string target,
+                                              std::string body,
+                                              std::string_view content_type) {
+    const auto now = std::chrono::floor<std::chrono::seconds>(
+        std::chrono::system_clock::now());
+
+    CachedResponse response{
+        .body = nullptr,
+        .content_type = std::string{content_type},
+        .etag = MakeStrongETag(body),
+        .last_modified = now,
+        .last_modified_date = FormatHttpDate(now),
+    };
+    response.body = std::make_shared<const std::string>(std::move(body));
+
+    return entries_.insert_or_assign(std::move(target), std::move(response))
+        .first->second;
+}
+
+const CachedResponse *
+ResponseCache::Find(std::string_view target) const noexcept {
+    if (auto it = entries_.find(target); it != entries_.end()) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+} // namespace http_cache
@@ -0,0 +1,214 @@
+#include "road_graph.hpp"
+#include "model.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace model {
+
+namespace {
+
+// Отрезок на линии с координатой coord поперёк неё: from <= to
+struct Segment {
+    Coord coord;
+    Coord from;
+    Coord to;
+
+    bool Contains(Coord along) const noexcept {
+        return from <= along && along <= to;
+    }
+};
+
+bool operator<(const Segment &lhs, const Segment &rhs) noexcept {
+    return std::tie(lhs.coord, lhs.from) < std::tie(rhs.coord, rhs.from);
+}
+
+bool PointLess(const Point &lhs, const Point &rhs) noexcept {
+    return std::tie(lhs.x, lhs.y) < std::tie(rhs.x, rhs.y);
+}
+
+bool PointEqual(const Point &lhs, const Point &rhs) noexcept {
+    return lhs.x == rhs.x && lhs.y == rhs.y;
+}
+
+bool CoordLess(const Segment &lhs, const Segment &rhs) noexcept {
+    return lhs.coord < rhs.coord;
+}
+
+// Объединяет отрезки одной линии, которые перекрываются или касаются
+std::vector<Segment> Merge(std::vector<Segment> segments) {
+    std::sort(segments.begin(), segments.end());
+
+    std::vector<Segment> merged;
+    for (const auto &segment : segments) {
+        if (!merged.empty() && merged.back().coord == segment.coord &&
+            segment.from <= merged.back().to) {
+            merged.back().to = std::max(merged.back().to, segment.to);
+        } else {
+            merged.push_back(segment);
+        }
+    }
+    return merged;
+}
+
+// Отрезок, покрывающий точку along на линии coord, если он есть
+const Segment *FindCovering(const std::vector<Segment> &segments, Coord coord,
+                            Coord along) {
+    // Первый отрезок, начинающийся дальше along. Отрезки одной линии после
+    // объединения не пересекаются, поэтому покрыть точку может только
+    // предыдущий
+    const auto it = std::upper_bound(segments.begin(), segments.end(),
+                                     Segment{coord, along, along});
+    if (it == segments.begin()) {
+        return nullptr;
+    }
+    const auto &segment = *std::prev(it);
+    return segment.coord == coord && segment.Contains(along) ? &segment
+                                                             : nullptr;
+}
+
+} // namespace
+
+RoadGraph::RoadGraph(const std::vector<Road> &roads)
+    : source_roads_{roads.size()} {
+    std::vector<Segment> horizontal;
+    std::vector<Segment> vertical;
+    std::vector<Point> dots;
+    for (const auto &road : roads) {
+        const auto start = road.GetStart();
+        const auto end = road.GetEnd();
+        if (PointEqual(start, end)) {
+            dots.push_back(start);
+        } else if (road.IsHorizontal()) {
+            const auto [from, to] = std::minmax(start.x, end.x);
+            horizontal.push_back({start.y, from, to});
+        } else {
+            const auto [from, to] = std::minmax(start.y, end.y);
+            vertical.push_back({start.x, from, to});
+        }
+    }
+    horizontal = Merge(std::move(horizontal));
+    vertical = Merge(std::move(vertical));
+
+    // Дорога нулевой длины остаётся отдельной, только если не лежит на
+    // другой дороге
+    std::sort(dots.begin(), dots.end(), PointLess);
+    dots.erase(std::unique(dots.begin(), dots.end(), PointEqual), dots.end());
+    std::erase_if(dots, [&](Point dot) {
+        return FindCovering(horizontal, dot.y, dot.x) ||
+               FindCovering(vertical, dot.x, dot.y);
+    });
+    for (const auto dot : dots) {
+        horizontal.push_back({dot.y, dot.x, dot.x});
+    }
+
+    // Узлы каждой дороги: концы и пересечения с дорогами другого направления.
+    // Для горизонтальной дороги перебираются вертикальные линии в её
+    // пределах, и на каждой двоичным поиском ищется дорога, пересекающая её
+    std::vector<std::vector<Coord>> stops(horizontal.size() + vertical.size());
+    for (std::size_t i = 0; i < horizontal.size(); ++i) {
+        stops[i] = {horizontal[i].from, horizontal[i].to};
+    }
+    for (std::size_t i = 0; i < vertical.size(); ++i) {
+        stops[horizontal.size() + i] = {vertical[i].from, vertical[i].to};
+    }
+    for (std::size_t i = 0; i < horizontal.size(); ++i) {
+        const auto &road = horizontal[i];
+        auto line = std::lower_bound(vertical.begin(), vertical.end(),
+                                     Segment{road.from, 0, 0}, CoordLess);
+        while (line != vertical.end() && line->coord <= road.to) {
+            const auto coord = line->coord;
+            if (const auto *crossing =
+                    FindCovering(vertical, coord, road.coord)) {
+                stops[i].push_back(coord);
+                stops[horizontal.size() + (crossing - vertical.data())]
+                    .push_back(road.coord);
+            }
+            line = std::upper_bound(line, vertical.end(),
+                                    Segment{coord, 0, 0}, CoordLess);
+        }
+    }
+
+    roads_.reserve(horizontal.size() + vertical.size());
+    for (const auto &road : horizontal) {
+        roads_.emplace_back(Road::HORIZONTAL, Point{road.from, road.coord},
+                            road.to);
+    }
+    for (const auto &road : vertical) {
+        roads_.emplace_back(Road::VERTICAL, Point{road.coord, road.from},
+                            road.to);
+    }
+
+    auto to_point = [&](std::size_t road, Coord along) {
+        return road < horizontal.size()
+                   ? Point{along, horizontal[road].coord}
+                   : Point{vertical[road - horizontal.size()].coord, along};
+    };
+
+    for (std::size_t road = 0; road < stops.size(); ++road) {
+        auto &along = stops[road];
+        std::sort(along.begin(), along.end());
+        along.erase(std::unique(along.begin(), along.end()), along.end());
+        for (const auto coord : along) {
+            nodes_.push_back(to_point(road, coord));
+        }
+    }
+    std::sort(nodes_.begin(), nodes_.end(), PointLess);
+    nodes_.erase(std::unique(nodes_.begin(), nodes_.end(), PointEqual),
+                 nodes_.end());
+
+    // Рёбра соединяют соседние узлы дороги. Сначала считаются степени узлов,
+    // затем рёбра раскладываются по местам
+    struct Link {
+        NodeIndex from;
+        NodeIndex to;
+        std::uint32_t road;
+        Dimension length;
+    };
+    std::vector<Link> links;
+    for (std::size_t road = 0; road < stops.size(); ++road) {
+        const auto &along = stops[road];
+        for (std::size_t i = 1; i < along.size(); ++i) {
+            links.push_back({*FindNode(to_point(road, along[i - 1])),
+                             *FindNode(to_point(road, along[i])),
+                             static_cast<std::uint32_t>(road),
+                             along[i] - along[i - 1]});
+        }
+    }
+
+    edge_offsets_.assign(nodes_.size() + 1, 0);
+    for (const auto &link : links) {
+        ++edge_offsets_[link.from + 1];
+        ++edge_offsets_[link.to + 1];
+    }
+    for (std::size_t i = 1; i < edge_offsets_.size(); ++i) {
+        edge_offsets_[i] += edge_offsets_[i - 1];
+    }
+
+    edges_.resize(edge_offsets_.back());
+    std::vector<std::uint32_t> filled(edge_offsets_.begin(),
+                                      edge_offsets_.end() - 1);
+    for (const auto &link : links) {
+        edges_[filled[link.from]++] = {link.to, link.road, link.length};
+        edges_[filled[link.to]++] = {link.from, link.road, link.length};
+    }
+}
+
+std::optional<RoadGraph::NodeIndex>
+RoadGraph::FindNode(Point point) const noexcept {
+    const auto it =
+        std::lower_bound(nodes_.begin(), nodes_.end(), point, PointLess);
+    if (it == nodes_.end() || !PointEqual(*it, point)) {
+        return std::nullopt;
+    }
+    return static_cast<NodeIndex>(it - nodes_.begin());
+}
+
+RoadGraph::Stats RoadGraph::GetStats() const noexcept {
+    return {.source_roads = source_roads_,
+            .roads = roads_.size(),
+            .nodes = nodes_.size(),
+            .edges = edges_.size() / 2};
+}
+
+} // namespace model
@@ -0,0 +1,242 @@
+#include "road_index.hpp"
+#include "model.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace model {
+
+RoadIndex::RoadIndex(const std::vector<Road> &roads) {
+    std::vector<std::pair<Coord, Segment>> horizontal;
+    std::vector<std::pair<Coord, Segment>> vertical;
+    bounds_.reserve(roads.size());
+
+    for (std::size_t i = 0; i < roads.size(); ++i) {
+        const auto start = roads[i].GetStart();
+        const auto end = roads[i].GetEnd();
+        const auto [min_x, max_x] = std::minmax(start.x, end.x);
+        const auto [min_y, max_y] = std::minmax(start.y, end.y);
+
+        bounds_.push_back({min_x - ROAD_HALF_WIDTH, max_x + ROAD_HALF_WIDTH,
+                           min_y - ROAD_HALF_WIDTH, max_y + ROAD_HALF_WIDTH});
+        // Дорога нулевой длины считается горизонтальной
+        if (roads[i].IsHorizontal()) {
+            horizontal.push_back({start.y, {min_x, max_x, i}});
+        } else {
+            vertical.push_back({start.x, {min_y, max_y, i}});
+        }
+    }
+
+    horizontal_ = MakeLines(std::move(horizontal));
+    vertical_ = MakeLines(std::move(vertical));
+}
+
+std::vector<std::size_t> RoadIndex::FindRoadsAt(Position position) const {
+    std::vector<std::size_t> roads;
+    ForEachRoadAt(position, [&roads](std::size_t road) {
+        roads.push_back(road);
+    });
+    return roads;
+}
+
+bool RoadIndex::IsOnRoad(Position position) const {
+    bool on_road = false;
+    ForEachRoadAt(position, [&on_road](std::size_t) { on_road = true; });
+    return on_road;
+}
+
+Position RoadIndex::GetMaxReachable(Position position,
+                                    Direction direction) const {
+    const bool along_x =
+        direction == Direction::WEST || direction == Direction::EAST;
+    const bool forward =
+        direction == Direction::EAST || direction == Direction::SOUTH;
+    double &along = along_x ? position.x : position.y;
+
+    // Точка продвигается до дальней границы дорог, которым принадлежит,
+    // пока там начинаются дороги, ведущие дальше
+    while (true) {
+        double farthest = along;
+        ForEachRoadAt(position, [&](std::size_t road) {
+            const auto &bounds = bounds_[road];
+            if (along_x) {
+                farthest = forward ? std::max(farthest, bounds.max_x)
+                                   : std::min(farthest, bounds.min_x);
+            } else {
+                farthest = forward ? std::max(farthest, bounds.max_y)
+                                   : std::min(farthest, bounds.min_y);
+            }
+        });
+        if (farthest == along) {
+            return position;
+        }
+        along = farthest;
+    }
+}
+
+std::optional<Position>
+RoadIndex::FindNearestRoadPoint(Position position) const {
+    std::optional<Nearest> nearest;
+    FindNearest(horizontal_, position.y, position.x, false, nearest);
+    FindNearest(vertical_, position.x, position.y, true, nearest);
+    if (!nearest) {
+        return std::nullopt;
+    }
+    return nearest->point;
+}
+
+const RoadIndex::Line *RoadIndex::FindLine(const Lines &lines,
+                                           double across) noexcept {
+    const auto coord = static_cast<Coord>(std::lround(across));
+    // Те же выражения, что и у границ дорог в bounds_: иначе точка на краю
+    // дороги, полученная из этих границ, может оказаться вне её
+    if (across < coord - ROAD_HALF_WIDTH || across > coord + ROAD_HALF_WIDTH) {
+        return nullptr;
+    }
+
+    const auto it = std::lower_bound(
+        lines.begin(), lines.end(), coord,
+        [](const Line &line, Coord coord) { return line.coord < coord; });
+    if (it == lines.end() || it->coord != coord) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+std::size_t RoadIndex::CountStartingBefore(const Line &line,
+                                           double along) noexcept {
+    const auto it = std::upper_bound(
+        line.segments.begin(), line.segments.end(), along,
+        [](double along, const Segment &segment) {
+            return along < segment.from - ROAD_HALF_WIDTH;
+        });
+    return static_cast<std::size_t>(it - line.segments.begin());
+}
+
+RoadIndex::Lines
+RoadIndex::MakeLines(std::vector<std::pair<Coord, Segment>> segments) {
+    std::sort(segments.begin(), segments.end(),
+              [](const auto &lhs, const auto &rhs) {
+                  return std::pair{lhs.first, lhs.second.from} <
+                         std::pair{rhs.first, rhs.second.from};
+              });
+
+    Lines lines;
+    for (const auto &[coord, segment] : segments) {
+        if (lines.empty() || lines.back().coord != coord) {
+            lines.push_back({coord, {}, {}, {}, {}, {}});
+        }
+        auto &line = lines.back();
+        line.max_to.push_back(line.max_to.empty()
+                                  ? segment.to
+                                  : std::max(line.max_to.back(), segment.to));
+        line.segments.push_back(segment);
+    }
+    for (auto &line : lines) {
+        BuildTree(line, line.segments);
+    }
+    return lines;
+}
+
+std::uint32_t RoadIndex::BuildTree(Line &line, std::vector<Segment> segments) {
+    if (segments.empty()) {
+        return NO_NODE;
+    }
+
+    // Медиана концов отрезков: по обе стороны от неё целиком лежит не больше
+    // половины отрезков, поэтому глубина дерева - O(log n). Точка целая,
+    // поэтому отрезок с краями полосы содержит её, только если содержит и
+    // сам отрезок
+    std::vector<Coord> ends;
+    ends.reserve(segments.size() * 2);
+    for (const auto &segment : segments) {
+        ends.push_back(segment.from);
+        ends.push_back(segment.to);
+    }
+    const auto median = ends.begin() + ends.size() / 2;
+    std::nth_element(ends.begin(), median, ends.end());
+    const Coord center = *median;
+
+    std::vector<Segment> left, right, middle;
+    for (const auto &segment : segments) {
+        if (segment.to < center) {
+            left.push_back(segment);
+        } else if (segment.from > center) {
+            right.push_back(segment);
+        } else {
+            middle.push_back(segment);
+        }
+    }
+
+    const auto node = static_cast<std::uint32_t>(line.nodes.size());
+    const auto begin = static_cast<std::uint32_t>(line.by_from.size());
+    line.nodes.push_back({center, begin,
+                          begin + static_cast<std::uint32_t>(middle.size())});
+
+    std::sort(middle.begin(), middle.end(),
+              [](const Segment &lhs, const Segment &rhs) {
+                  return lhs.from < rhs.from;
+              });
+    line.by_from.insert(line.by_from.end(), middle.begin(), middle.end());
+    std::sort(middle.begin(), middle.end(),
+              [](const Segment &lhs, const Segment &rhs) {
+                  return lhs.to > rhs.to;
+              });
+    line.by_to.insert(line.by_to.end(), middle.begin(), middle.end());
+
+    // Узлы добавляются при построении поддеревьев, поэтому ссылку на узел
+    // брать нельзя
+    const auto left_node = BuildTree(line, std::move(left));
+    const auto right_node = BuildTree(line, std::move(right));
+    line.nodes[node].left = left_node;
+    line.nodes[node].right = right_node;
+    return node;
+}
+
+void RoadIndex::FindNearest(const Lines &lines, double across, double along,
+                            bool vertical, std::optional<Nearest> &nearest) {
+    // Возвращает false, если эта и все следующие линии в том же направлении
+    // дальше уже найденной точки
+    auto visit = [&](const Line &line) {
+        const double across_gap = std::max(
+            0.0, std::abs(line.coord - across) - ROAD_HALF_WIDTH);
+        if (nearest && across_gap >= nearest->distance) {
+            return false;
+        }
+
+        const double across_point =
+            std::clamp(across, line.coord - ROAD_HALF_WIDTH,
+                       line.coord + ROAD_HALF_WIDTH);
+        auto consider = [&](double along_point) {
+            const double distance =
+                std::hypot(along_point - along, across_point - across);
+            if (!nearest || distance < nearest->distance) {
+                nearest = Nearest{
+                    vertical ? Position{across_point, along_point}
+                             : Position{along_point, across_point},
+                    distance};
+            }
+        };
+
+        // Среди отрезков, начинающихся до точки, ближе всех тот, что
+        // заканчивается дальше всех, а среди остальных - первый
+        const auto count = CountStartingBefore(line, along);
+        if (count > 0) {
+            consider(std::min(along, line.max_to[count - 1] + ROAD_HALF_WIDTH));
+        }
+        if (count < line.segments.size()) {
+            consider(line.segments[count].from - ROAD_HALF_WIDTH);
+        }
+        return true;
+    };
+
+    const auto first_after = std::lower_bound(
+        lines.begin(), lines.end(), across,
+        [](const Line &line, double across) { return line.coord < across; });
+    for (auto it = first_after; it != lines.end() && visit(*it); ++it) {
+    }
+    for (auto it = first_after; it != lines.begin() && visit(*--it);) {
+    }
+}
+
+} // namespace model
@@ -0,0 +1,54 @@
+#include "sendfile_body.hpp"
+
+#include <cerrno>
+
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+namespace http_server {
+
+namespace {
+
+// Максимальный объём данных, передаваемый одним вызовом sendfile. Ограничение
+// не даёт одной сессии надолго занять io-поток
+constexpr std::size_t SENDFILE_CHUNK_SIZE = 1024 * 1024;
+
+} // namespace
+
+SendBodyStatus SendBody(int socket, const SendfileBody::value_type &body,
+                        std::uint64_t &sent, beast::error_code &ec) {
+    while (!ec && sent < body.Size()) {
+        const auto [segment, segment_offset] = body.Locate(sent);
+
+        ssize_t written = 0;
+        if (segment->IsText()) {
+            // Заголовки частей multipart/byteranges отправляются из памяти
+            written = ::send(socket, segment->text.data() + segment_offset,
+                             segment->text.size() - segment_offset,
+                             MSG_NOSIGNAL);
+        } else {
+            off_t offset = static_cast<off_t>(segment->offset + segment_offset);
+            const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(
+                segment->size - segment_offset, SENDFILE_CHUNK_SIZE));
+
+            written = ::sendfile(socket, body.NativeHandle(), &offset, count);
+        }
+
+        if (written > 0) {
+            sent += written;
+            return sent < body.Size() ? SendBodyStatus::PARTIAL
+                                      : SendBodyStatus::DONE;
+        }
+        if (written == 0) {
+            // Файл стал короче, чем было указано в Content-Length
+            ec = http::error::short_read;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return SendBodyStatus::WOULD_BLOCK;
+        } else if (errno != EINTR) {
+            ec = {errno, boost::system::system_category()};
+        }
+    }
+    return SendBodyStatus::DONE;
+}
+
+} // namespace http_server
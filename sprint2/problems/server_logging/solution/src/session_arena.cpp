@@ -0,0 +1,55 @@
+#include "session_arena.hpp"
+
+#include "metrics.hpp"
+
+namespace http_server {
+
+namespace {
+
+// Выделяет память из кучи, когда арене не хватает начального буфера, и
+// учитывает это в показателях: в установившемся режиме таких выделений
+// быть не должно
+class UpstreamResource final : public std::pmr::memory_resource {
+  public:
+    static UpstreamResource &Instance() {
+        static UpstreamResource resource;
+        return resource;
+    }
+
+  private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        metrics::Increment(metrics::Counter::ARENA_HEAP_ALLOCATIONS);
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes,
+                       std::size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+} // namespace
+
+SessionArena::SessionArena(std::size_t initial_size)
+    : initial_buffer_(std::make_unique_for_overwrite<std::byte[]>(
+          initial_size)),
+      resource_(initial_buffer_.get(), initial_size,
+                &UpstreamResource::Instance()) {}
+
+void SessionArena::Reset() noexcept {
+    // После release следующие выделения снова идут из начального буфера
+    resource_.release();
+    allocated_ = 0;
+}
+
+void *SessionArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    allocated_ += bytes;
+    return resource_.allocate(bytes, alignment);
+}
+
+} // namespace http_server
@@ -0,0 +1,338 @@
+#include "static_content_cache.hpp"
+#include "errors.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <unordered_map>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace http_cache {
+
+using namespace std::string_view_literals;
+namespace fs = std::filesystem;
+
+namespace {
+
+// События, после которых закешированное содержимое файла устаревает
+constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB |
+                                IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+// Как часто поток наблюдения проверяет запрос на остановку
+constexpr int WATCH_POLL_INTERVAL_MS = 500;
+
+boost::system::error_code LastError() {
+    return {errno, boost::system::system_category()};
+}
+
+void AppendHex(std::string &out, std::uintmax_t value) {
+    char buffer[sizeof(value) * 2];
+    auto [end, ec] = std::to_chars(std::begin(buffer), std::end(buffer),
+                                   value, 16);
+    out.append(buffer, end);
+}
+
+} // namespace
+
+std::string MakeFileETag(fs::file_time_type last_write_time,
+                         std::uintmax_t size) {
+    const auto modified = std::chrono::file_clock::to_sys(last_write_time);
+
+    std::string etag = "\"";
+    AppendHex(etag, static_cast<std::uintmax_t>(
+                        modified.time_since_epoch().count()));
+    etag += '-';
+    AppendHex(etag, size);
+    etag += '"';
+
+    return etag;
+}
+
+std::size_t StaticFileSet::Size() const noexcept {
+    std::size_t size = 0;
+    for (const auto &file : files) {
+        if (file) {
+            size += file->Size();
+        }
+    }
+    return size;
+}
+
+StaticContentCache::StaticContentCache(fs::path content_root,
+                                       std::size_t byte_budget)
+    : content_root_(fs::canonical(content_root)), byte_budget_(byte_budget) {}
+
+StaticContentCache::FileSetPtr
+StaticContentCache::Find(std::string_view request_path) {
+    auto &shard = GetShard(request_path);
+    std::shared_lock lock{shard.mutex};
+
+    auto it = shard.entries.find(request_path);
+    if (it == shard.entries.end()) {
+        return nullptr;
+    }
+
+    // Запись в общую кеш-линию - только при первом использовании после
+    // обхода стрелкой
+    auto &referenced = it->second.referenced;
+    if (!referenced.load(std::memory_order_relaxed)) {
+        referenced.store(true, std::memory_order_relaxed);
+    }
+    return it->second.files;
+}
+
+StaticContentCache::ReadTicket StaticContentCache::BeginRead() {
+    std::lock_guard lock{mutex_};
+    ++reads_in_flight_[generation_];
+    return ReadTicket{this, generation_};
+}
+
+void StaticContentCache::ReadTicket::Release() noexcept {
+    if (cache_) {
+        cache_->EndRead(generation_);
+        cache_ = nullptr;
+    }
+}
+
+void StaticContentCache::EndRead(Generation generation) noexcept {
+    std::lock_guard lock{mutex_};
+    if (auto it = reads_in_flight_.find(generation);
+        it != reads_in_flight_.end() && --it->second == 0) {
+        reads_in_flight_.erase(it);
+    }
+}
+
+void StaticContentCache::Insert(std::string request_path, FileSetPtr files,
+                                const ReadTicket &ticket) {
+    const auto generation = ticket.GetGeneration();
+    const std::size_t size = files->Size();
+    if (size > byte_budget_) {
+        return;
+    }
+
+    std::lock_guard lock{mutex_};
+
+    // Файл изменился, пока его читали
+    if (cleared_ > generation) {
+        return;
+    }
+    if (auto it = invalidated_.find(files->RelativePath().native());
+        it != invalidated_.end() && it->second > generation) {
+        return;
+    }
+
+    auto &shard = GetShard(request_path);
+    {
+        std::lock_guard shard_lock{shard.mutex};
+        if (auto it = shard.entries.find(request_path);
+            it != shard.entries.end()) {
+            EraseLocked(shard, it);
+        }
+    }
+
+    // Стрелка обходит сегменты по очереди, пока новая запись не поместится.
+    // За два полных обхода стрелка снимает все отметки, поэтому третий
+    // ничего не вытесняет, только если кеш пуст
+    for (std::size_t idle_visits = 0;
+         used_bytes_ + size > byte_budget_ && idle_visits < 3 * SHARD_COUNT;) {
+        auto &victim = shards_[evict_shard_];
+        std::lock_guard victim_lock{victim.mutex};
+        if (EvictOneLocked(victim)) {
+            idle_visits = 0;
+        } else {
+            ++idle_visits;
+            evict_shard_ = (evict_shard_ + 1) % SHARD_COUNT;
+        }
+    }
+
+    std::lock_guard shard_lock{shard.mutex};
+    // Новый ключ ставится перед стрелкой, чтобы она дошла до него последним
+    const auto position = shard.clock.insert(shard.hand, request_path);
+    auto [it, inserted] = shard.entries.try_emplace(std::move(request_path));
+    it->second.files = std::move(files);
+    it->second.clock_position = position;
+    used_bytes_ += size;
+}
+
+void StaticContentCache::Invalidate(const fs::path &relative_path) {
+    // Путь исходного файла для сжатой версии foo.js.gz - foo.js
+    fs::path source_path = relative_path;
+    if (const auto extension = relative_path.extension();
+        extension == ".gz"sv || extension == ".br"sv) {
+        source_path.replace_extension();
+    }
+
+    std::lock_guard lock{mutex_};
+
+    ++generation_;
+    invalidated_[relative_path.native()] = generation_;
+    invalidated_[source_path.native()] = generation_;
+    PruneInvalidatedLocked();
+
+    for (auto &shard : shards_) {
+        std::lock_guard shard_lock{shard.mutex};
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            auto current = it++;
+            const auto &path = current->second.files->RelativePath();
+            if (path == relative_path || path == source_path) {
+                EraseLocked(shard, current);
+            }
+        }
+    }
+}
+
+void StaticContentCache::Clear() {
+    std::lock_guard lock{mutex_};
+
+    for (auto &shard : shards_) {
+        std::lock_guard shard_lock{shard.mutex};
+        shard.entries.clear();
+        shard.clock.clear();
+        shard.hand = shard.clock.end();
+    }
+    used_bytes_ = 0;
+    cleared_ = ++generation_;
+    invalidated_.clear();
+}
+
+void StaticContentCache::PruneInvalidatedLocked() {
+    // Запись нужна, пока идёт чтение, начатое раньше сброса. Без таких
+    // чтений словарь пустеет сразу
+    const auto oldest_read = reads_in_flight_.empty()
+                                 ? generation_
+                                 : reads_in_flight_.begin()->first;
+    std::erase_if(invalidated_, [oldest_read](const auto &item) {
+        return item.second <= oldest_read;
+    });
+}
+
+StaticContentCache::Shard &
+StaticContentCache::GetShard(std::string_view request_path) noexcept {
+    return shards_[std::hash<std::string_view>{}(request_path) % SHARD_COUNT];
+}
+
+void StaticContentCache::EraseLocked(Shard &shard, Entries::iterator it) {
+    used_bytes_ -= it->second.files->Size();
+    if (shard.hand == it->second.clock_position) {
+        ++shard.hand;
+    }
+    shard.clock.erase(it->second.clock_position);
+    shard.entries.erase(it);
+}
+
+bool StaticContentCache::EvictOneLocked(Shard &shard) {
+    while (shard.hand != shard.clock.end()) {
+        auto it = shard.entries.find(*shard.hand);
+        if (it->second.referenced.exchange(false, std::memory_order_relaxed)) {
+            ++shard.hand;
+            continue;
+        }
+        EraseLocked(shard, it);
+        return true;
+    }
+    // Следующий обход сегмента начнётся с начала круга
+    shard.hand = shard.clock.begin();
+    return false;
+}
+
+void StaticContentCache::StartWatching(
+    worker_topology::ThreadSetup setup_thread) {
+    watcher_ = std::jthread([this, setup = std::move(setup_thread)](
+                                std::stop_token stop_token) {
+        if (setup) {
+            setup("static-watch"sv);
+        }
+        Watch(std::move(stop_token));
+    });
+}
+
+void StaticContentCache::Watch(std::stop_token stop_token) {
+    const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return error::Report(LastError(), "inotify_init"sv);
+    }
+
+    // Дескриптор наблюдения -> каталог относительно корня статики
+    std::unordered_map<int, fs::path> watched_dirs;
+
+    auto add_watch = [this, fd, &watched_dirs](const fs::path &relative_dir) {
+        const auto dir = content_root_ / relative_dir;
+        const int wd = inotify_add_watch(fd, dir.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            return error::Report(LastError(), "inotify_add_watch"sv);
+        }
+        watched_dirs[wd] = relative_dir;
+
+        std::error_code ec;
+        for (fs::recursive_directory_iterator it(dir, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            if (it->is_directory(ec)) {
+                const int sub_wd =
+                    inotify_add_watch(fd, it->path().c_str(), WATCH_MASK);
+                if (sub_wd >= 0) {
+                    watched_dirs[sub_wd] =
+                        fs::relative(it->path(), content_root_, ec);
+                }
+            }
+        }
+    };
+
+    add_watch({});
+
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    while (!stop_token.stop_requested()) {
+        pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+        if (poll(&pfd, 1, WATCH_POLL_INTERVAL_MS) <= 0) {
+            continue;
+        }
+
+        const ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            continue;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto *event =
+                reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Часть событий потеряна - доверять кешу больше нельзя
+                Clear();
+                continue;
+            }
+
+            auto it = watched_dirs.find(event->wd);
+            if (it == watched_dirs.end()) {
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                watched_dirs.erase(it);
+                continue;
+            }
+
+            const fs::path relative =
+                event->len ? it->second / event->name : it->second;
+
+            if (event->mask & (IN_ISDIR | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    add_watch(relative);
+                }
+                // Изменение каталога затрагивает все файлы внутри него
+                Clear();
+                continue;
+            }
+
+            Invalidate(relative);
+        }
+    }
+
+    close(fd);
+}
+
+} // namespace http_cache
@@ -0,0 +1,87 @@
+#include "static_precompress.hpp"
+#include "request_handler.hpp"
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <fstream>
+
+namespace http_handler {
+
+namespace fs = std::filesystem;
+namespace io = boost::iostreams;
+using namespace std::string_view_literals;
+
+namespace {
+
+bool IsPrecompressed(const fs::path &path) {
+    const auto extension = path.extension();
+    return extension == ".gz"sv || extension == ".br"sv;
+}
+
+// Сжимает source в target. Файл пишется во временный файл и затем
+// переименовывается, чтобы сервер никогда не увидел его частично записанным
+bool Compress(const fs::path &source, const fs::path &target) {
+    fs::path temp_path = target;
+    temp_path += ".tmp"sv;
+
+    {
+        std::ifstream in(source, std::ios::binary);
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!in || !out) {
+            return false;
+        }
+
+        io::filtering_ostream gzip;
+        gzip.push(io::gzip_compressor(
+            io::gzip_params(io::gzip::best_compression)));
+        gzip.push(out);
+        io::copy(in, gzip);
+    }
+
+    std::error_code ec;
+    if (fs::file_size(temp_path, ec) >= fs::file_size(source, ec) || ec) {
+        // Сжатие не дало выигрыша - клиентам выгоднее получать исходный файл
+        fs::remove(temp_path, ec);
+        return false;
+    }
+
+    fs::rename(temp_path, target, ec);
+    return !ec;
+}
+
+} // namespace
+
+std::size_t PrecompressStaticFiles(const fs::path &content_root) {
+    std::size_t created = 0;
+    std::error_code ec;
+
+    for (fs::recursive_directory_iterator it(content_root, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        const auto &path = it->path();
+        if (!it->is_regular_file(ec) || IsPrecompressed(path) ||
+            !IsCompressibleFile(path)) {
+            continue;
+        }
+
+        fs::path target = path;
+        target += ".gz"sv;
+
+        std::error_code time_ec;
+        if (fs::exists(target, time_ec) &&
+            fs::last_write_time(target, time_ec) >=
+                fs::last_write_time(path, time_ec) &&
+            !time_ec) {
+            continue;
+        }
+
+        if (Compress(path, target)) {
+            ++created;
+        }
+    }
+
+    return created;
+}
+
+} // namespace http_handler
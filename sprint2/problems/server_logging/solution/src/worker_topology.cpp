@@ -0,0 +1,159 @@
+#include "worker_topology.hpp"
+#include "errors.hpp"
+
+#include <charconv>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace worker_topology {
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+namespace {
+
+boost::system::error_code MakeError(int code) {
+    return {code, boost::system::system_category()};
+}
+
+void SetThreadName(std::string_view name) {
+    // Имя потока в Linux ограничено 15 символами
+    const std::string truncated{name.substr(0, 15)};
+    pthread_setname_np(pthread_self(), truncated.c_str());
+}
+
+void PinToCpus(const std::vector<int> &cpus) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : cpus) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    if (const int err =
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)) {
+        error::Report(MakeError(err), "pthread_setaffinity_np"sv);
+    }
+}
+
+// Узел NUMA, к которому относится ядро cpu. В sysfs каталог ядра содержит
+// ссылку nodeN на свой узел
+std::optional<int> GetNumaNode(int cpu) {
+    std::error_code ec;
+    const fs::path cpu_dir =
+        "/sys/devices/system/cpu/cpu"s + std::to_string(cpu);
+
+    for (fs::directory_iterator it(cpu_dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        const auto name = it->path().filename().string();
+        if (!name.starts_with("node"sv)) {
+            continue;
+        }
+
+        int node = 0;
+        auto [ptr, parse_ec] =
+            std::from_chars(name.data() + 4, name.data() + name.size(), node);
+        if (parse_ec == std::errc{} && ptr == name.data() + name.size()) {
+            return node;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void BindMemoryToNode(int node) {
+    constexpr int BITS_PER_WORD = sizeof(unsigned long) * 8;
+    constexpr int MAX_NODES = 1024;
+
+    unsigned long mask[MAX_NODES / BITS_PER_WORD] = {};
+    if (node < 0 || node >= MAX_NODES) {
+        return;
+    }
+    mask[node / BITS_PER_WORD] = 1ul << (node % BITS_PER_WORD);
+
+    // MPOL_PREFERRED, а не MPOL_BIND: если на узле закончится память, она
+    // будет выделена на другом узле вместо завершения процесса по OOM.
+    // libnuma не используется, поэтому системный вызов делается напрямую
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, MAX_NODES + 1) != 0) {
+        error::Report(MakeError(errno), "set_mempolicy"sv);
+    }
+}
+
+} // namespace
+
+WorkerTopology::WorkerTopology(const Options &options) : options_(options) {
+    if (!options_.pin_threads && !options_.numa_local) {
+        return;
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        error::Report(MakeError(errno), "sched_getaffinity"sv);
+        return;
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            auto &cpus = reserved_cpus_.size() < options_.reserved_cores
+                             ? reserved_cpus_
+                             : cpus_;
+            cpus.push_back(cpu);
+        }
+    }
+
+    // Иначе привязка молча отключилась бы
+    if (cpus_.empty()) {
+        throw std::runtime_error(
+            "All "s + std::to_string(reserved_cpus_.size()) +
+            " available cores are reserved, none is left for worker threads"s);
+    }
+}
+
+void WorkerTopology::Apply(unsigned index) const {
+    // Имя главного потока совпадает с именем процесса, поэтому его не меняем,
+    // чтобы процесс по-прежнему находился по имени
+    if (index != 0) {
+        SetThreadName("io-worker-"s + std::to_string(index));
+    }
+
+    if (cpus_.empty()) {
+        return;
+    }
+
+    const int cpu = cpus_[index % cpus_.size()];
+
+    if (options_.pin_threads) {
+        PinToCpus({cpu});
+    }
+
+    if (options_.numa_local) {
+        if (const auto node = GetNumaNode(cpu)) {
+            BindMemoryToNode(*node);
+        }
+    }
+}
+
+void WorkerTopology::ApplyService(std::string_view name) const {
+    SetThreadName(name);
+
+    // Без зарезервированных ядер служебные потоки остаются на всех ядрах
+    if (options_.pin_threads && !reserved_cpus_.empty()) {
+        PinToCpus(reserved_cpus_);
+    }
+}
+
+ThreadSetup WorkerTopology::MakeServiceSetup() const {
+    return [topology = *this](std::string_view name) {
+        topology.ApplyService(name);
+    };
+}
+
+} // namespace worker_topology
@@ -0,0 +1,77 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdio>
+#include <string_view>
+
+#include "allocation_counter.hpp"
+#include "test_server.hpp"
+
+namespace {
+
+using namespace std::literals;
+using namespace test_server;
+
+constexpr std::size_t SENDFILE_THRESHOLD = 16 * 1024;
+constexpr int WARMUP_REQUESTS = 200;
+constexpr int MEASURED_REQUESTS = 2'000;
+
+// Среднее число выделений памяти на запрос к target после прогрева
+double CountAllocationsPerRequest(Client &client, std::string_view target) {
+    for (int i = 0; i < WARMUP_REQUESTS; ++i) {
+        REQUIRE(client.Get(target) == 200);
+    }
+
+    const auto before = GetAllocationCount();
+    for (int i = 0; i < MEASURED_REQUESTS; ++i) {
+        if (client.Get(target) != 200) {
+            FAIL("Request to " << target << " failed");
+        }
+    }
+    return static_cast<double>(GetAllocationCount() - before) /
+           MEASURED_REQUESTS;
+}
+
+} // namespace
+
+// Сессии на корутинах выделяют память под кадры корутин и операции Beast,
+// которые Asio не позволяет разместить в памяти сессии, поэтому их
+// выделения только измеряются в "Allocations per request"
+TEST_CASE("Requests answered from memory do not allocate") {
+    const StaticDirectory static_dir;
+    TestServer server{static_dir.GetPath(), {}};
+    Client client{server.GetPort()};
+
+    for (const auto target :
+         {"/api/v1/maps"sv, "/api/v1/maps/map1"sv, "/index.html"sv}) {
+        INFO(target);
+        CHECK(CountAllocationsPerRequest(client, target) == 0);
+    }
+}
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Файлы, отправляемые через sendfile, не кешируются: каждый запрос ищет файл
+// на диске в пуле, и эти выделения памяти здесь только измеряются
+TEST_CASE("Allocations per request", "[.][benchmark]") {
+    const StaticDirectory static_dir;
+    static_dir.AddFile("big.bin", 4 * SENDFILE_THRESHOLD);
+
+    for (const auto engine : {http_server::SessionEngine::CALLBACKS,
+                              http_server::SessionEngine::COROUTINES}) {
+        TestServer server{static_dir.GetPath(),
+                          {.engine = engine,
+                           .sendfile_threshold = SENDFILE_THRESHOLD}};
+        Client client{server.GetPort()};
+
+        for (const auto target : {"/api/v1/maps"sv, "/api/v1/maps/map1"sv,
+                                  "/index.html"sv, "/big.bin"sv}) {
+            const double allocations =
+                CountAllocationsPerRequest(client, target);
+            std::printf("%-10s %-20.*s %.2f allocations per request\n",
+                        engine == http_server::SessionEngine::CALLBACKS
+                            ? "callbacks"
+                            : "coroutines",
+                        static_cast<int>(target.size()), target.data(),
+                        allocations);
+        }
+    }
+}
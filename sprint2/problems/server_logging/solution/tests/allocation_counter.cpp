@@ -0,0 +1,57 @@
+#include "allocation_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Остальные формы operator new в libstdc++ вызывают заменённые здесь.
+// Замена живёт в отдельной единице трансляции, чтобы компилятор не
+// встраивал её и не принимал free за освобождение памяти встроенного new
+
+namespace {
+
+std::atomic<std::uint64_t> allocation_count{0};
+std::atomic<std::uint64_t> allocated_bytes{0};
+
+void CountAllocation(std::size_t size) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+} // namespace
+
+std::uint64_t GetAllocationCount() noexcept {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+std::uint64_t GetAllocatedBytes() noexcept {
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size) {
+    CountAllocation(size);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    CountAllocation(size);
+    const auto align = static_cast<std::size_t>(alignment);
+    const std::size_t rounded = (size + align - 1) / align * align;
+    if (void *p = std::aligned_alloc(align, rounded)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
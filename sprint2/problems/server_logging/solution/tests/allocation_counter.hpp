@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Число выделений памяти из кучи во всех потоках процесса с его запуска.
+// Считается заменёнными глобальными operator new
+std::uint64_t GetAllocationCount() noexcept;
+
+// Суммарный размер этих выделений, байт
+std::uint64_t GetAllocatedBytes() noexcept;
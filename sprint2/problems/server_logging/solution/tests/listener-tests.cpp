@@ -0,0 +1,146 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "http_server.hpp"
+
+using namespace std::literals;
+
+namespace {
+
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+using tcp = net::ip::tcp;
+
+// Отвечает 200 на любой запрос, в теле - порт клиента
+struct OkHandler {
+    template <typename Request, typename Sender>
+    void operator()(const tcp::endpoint &client, Request &&req,
+                    Sender &&sender) const {
+        http::response<http::string_body> response{http::status::ok,
+                                                   req.version()};
+        response.body() = std::to_string(client.port());
+        response.prepare_payload();
+        response.keep_alive(req.keep_alive());
+        sender(std::move(response));
+    }
+};
+
+// Число открытых процессом файловых дескрипторов
+std::size_t CountOpenDescriptors() {
+    std::size_t count = 0;
+    for ([[maybe_unused]] const auto &entry :
+         std::filesystem::directory_iterator{"/proc/self/fd"}) {
+        ++count;
+    }
+    // Сам обход держит открытым каталог
+    return count - 1;
+}
+
+bool Connect(int fd, unsigned short port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ==
+           0;
+}
+
+// Локальный порт сокета клиента
+unsigned short GetLocalPort(int fd) {
+    sockaddr_in addr{};
+    socklen_t length = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &length);
+    return ntohs(addr.sin_port);
+}
+
+// Отправляет GET-запрос и возвращает начало ответа
+std::string Get(int fd) {
+    constexpr std::string_view request = "GET / HTTP/1.1\r\nHost: test\r\n\r\n";
+    if (::send(fd, request.data(), request.size(), MSG_NOSIGNAL) !=
+        static_cast<ssize_t>(request.size())) {
+        return {};
+    }
+    char buffer[256];
+    const auto n = ::recv(fd, buffer, sizeof(buffer), 0);
+    return n > 0 ? std::string(buffer, n) : std::string{};
+}
+
+} // namespace
+
+TEST_CASE("Listener keeps accepting after running out of descriptors") {
+    net::io_context ioc{1};
+    const tcp::endpoint endpoint{net::ip::address_v4::loopback(), 0};
+    // Свободный порт, выбранный системой
+    tcp::acceptor probe{ioc, endpoint};
+    const auto port = probe.local_endpoint().port();
+    probe.close();
+    http_server::ServeHttp(ioc, {endpoint.address(), port}, OkHandler{});
+    std::jthread worker{[&ioc] { ioc.run(); }};
+
+    constexpr int CLIENTS = 4;
+    std::vector<int> clients;
+    for (int i = 0; i < CLIENTS; ++i) {
+        clients.push_back(::socket(AF_INET, SOCK_STREAM, 0));
+    }
+
+    // Сокеты клиентов созданы заранее, поэтому соединения устанавливаются
+    // ядром, а accept на сервере завершается с EMFILE
+    rlimit saved{};
+    REQUIRE(::getrlimit(RLIMIT_NOFILE, &saved) == 0);
+    rlimit limited = saved;
+    limited.rlim_cur = CountOpenDescriptors();
+    REQUIRE(::setrlimit(RLIMIT_NOFILE, &limited) == 0);
+    for (const int fd : clients) {
+        REQUIRE(Connect(fd, port));
+    }
+    std::this_thread::sleep_for(200ms);
+    REQUIRE(::setrlimit(RLIMIT_NOFILE, &saved) == 0);
+
+    // После паузы сервер принимает соединения, ждавшие в очереди
+    for (const int fd : clients) {
+        CHECK(Get(fd).starts_with("HTTP/1.1 200"sv));
+        ::close(fd);
+    }
+
+    ioc.stop();
+}
+
+TEST_CASE("Sessions pass the client endpoint taken at accept") {
+    for (const auto engine : {http_server::SessionEngine::CALLBACKS,
+                              http_server::SessionEngine::COROUTINES}) {
+        net::io_context ioc{1};
+        const tcp::endpoint endpoint{net::ip::address_v4::loopback(), 0};
+        tcp::acceptor probe{ioc, endpoint};
+        const auto port = probe.local_endpoint().port();
+        probe.close();
+        http_server::ServeHttp(ioc, {endpoint.address(), port}, OkHandler{},
+                               {.reuse_port = false,
+                                .admission = {},
+                                .engine = engine});
+        std::jthread worker{[&ioc] { ioc.run(); }};
+
+        const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(Connect(fd, port));
+        const auto response = Get(fd);
+        CHECK(response.starts_with("HTTP/1.1 200"sv));
+        CHECK(response.ends_with("\r\n\r\n"s +
+                                 std::to_string(GetLocalPort(fd))));
+        ::close(fd);
+
+        ioc.stop();
+    }
+}
@@ -0,0 +1,209 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "file_reader.hpp"
+#include "logs.hpp"
+#include "test_server.hpp"
+
+using namespace std::literals;
+using namespace test_server;
+
+namespace {
+
+constexpr auto LOAD_DURATION = 3s;
+
+void PrintLoad(const char *name, std::string_view target,
+               const LoadResult &load) {
+    std::printf("%-24s %-12.*s %8.0f req/s, p50 %6.1f us, p99 %7.1f us\n",
+                name, static_cast<int>(target.size()), target.data(),
+                load.requests_per_second,
+                std::chrono::duration<double, std::micro>(load.p50).count(),
+                std::chrono::duration<double, std::micro>(load.p99).count());
+}
+
+// Перенаправляет stdout в канал, который, как сборщик логов, читает
+// отдельный поток. Восстанавливает stdout при уничтожении
+class StdoutToPipe {
+  public:
+    StdoutToPipe() {
+        std::cout.flush();
+        std::fflush(stdout);
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        ::dup2(fds[1], STDOUT_FILENO);
+        ::close(fds[1]);
+        reader_ = std::jthread{[fd = fds[0]] {
+            char buffer[64 * 1024];
+            while (::read(fd, buffer, sizeof(buffer)) > 0) {
+            }
+            ::close(fd);
+        }};
+    }
+
+    ~StdoutToPipe() {
+        std::cout.flush();
+        std::fflush(stdout);
+        // Читающий поток получит конец файла, когда закроется последняя
+        // копия конца канала для записи
+        ::dup2(stdout_, STDOUT_FILENO);
+        ::close(stdout_);
+    }
+
+  private:
+    int stdout_ = ::dup(STDOUT_FILENO);
+    std::jthread reader_;
+};
+
+// Синхронный вывод, которым сервер пользовался до асинхронного: каждая
+// запись выводится в std::cout и сбрасывается в потоке, который её создал
+void FormatForConsole(const logging::record_view &rec,
+                      logging::formatting_ostream &strm) {
+    std::string out;
+    logs::FormatRecord(rec, out);
+    out.pop_back();
+    strm << out;
+}
+
+} // namespace
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Сервер и клиенты делят процессоры одной машины, поэтому на машине с
+// небольшим числом ядер сравнение показывает прежде всего накладные расходы
+// режимов, а не их масштабирование
+TEST_CASE("Shared io_context and SO_REUSEPORT under load", "[.][benchmark]") {
+    const StaticDirectory static_dir;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned clients = 4 * threads;
+
+    for (const bool reuse_port : {false, true}) {
+        TestServer server{static_dir.GetPath(),
+                          {.threads = threads, .reuse_port = reuse_port}};
+        for (const auto target : {"/api/v1/maps"sv, "/index.html"sv}) {
+            const auto load =
+                RunLoad(server.GetPort(), target, clients, LOAD_DURATION);
+            CHECK(load.failures == 0);
+            PrintLoad(reuse_port ? "SO_REUSEPORT" : "shared io_context",
+                      target, load);
+        }
+    }
+}
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Каждый запрос логируется двумя записями. Вывод лога уходит в канал,
+// чтобы сравнение учитывало запись в него, но не скорость терминала
+TEST_CASE("Request logging at 20k requests per second", "[.][benchmark]") {
+    constexpr double RATE = 20'000;
+    constexpr unsigned CLIENTS = 16;
+    constexpr auto TARGET = "/api/v1/maps"sv;
+    const StaticDirectory static_dir;
+
+    const auto run = [&static_dir, TARGET](unsigned log_rate) {
+        TestServer server{static_dir.GetPath(), {.log_rate = log_rate}};
+        return RunLoad(server.GetPort(), TARGET, CLIENTS, LOAD_DURATION, RATE);
+    };
+
+    LoadResult without_logs, synchronous, asynchronous;
+    {
+        const StdoutToPipe pipe;
+        without_logs = run(1'000'000);
+
+        logging::add_common_attributes();
+        const auto sink = logging::add_console_log(
+            std::cout, logging::keywords::format = &FormatForConsole,
+            logging::keywords::auto_flush = true);
+        synchronous = run(1);
+        logging::core::get()->remove_sink(sink);
+
+        logs::init();
+        asynchronous = run(1);
+        logs::shutdown();
+    }
+
+    for (const auto &[name, load] :
+         {std::pair{"no request logs", without_logs},
+          std::pair{"synchronous console", synchronous},
+          std::pair{"asynchronous batches", asynchronous}}) {
+        CHECK(load.failures == 0);
+        PrintLoad(name, TARGET, load);
+    }
+}
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Время процессора на запрос учитывает только потоки сервера и служит
+// мерой длины пути обработки запроса в каждом из движков сессий
+TEST_CASE("Session engines under load", "[.][benchmark]") {
+    const StaticDirectory static_dir;
+
+    for (const auto engine : {http_server::SessionEngine::CALLBACKS,
+                              http_server::SessionEngine::COROUTINES}) {
+        const char *name = engine == http_server::SessionEngine::CALLBACKS
+                               ? "callbacks"
+                               : "coroutines";
+        TestServer server{static_dir.GetPath(), {.engine = engine}};
+
+        for (const unsigned clients : {1u, 4u}) {
+            const auto cpu_before = server.GetCpuTime();
+            const auto load = RunLoad(server.GetPort(), "/api/v1/maps"sv,
+                                      clients, LOAD_DURATION);
+            const std::chrono::duration<double, std::micro> cpu =
+                server.GetCpuTime() - cpu_before;
+
+            CHECK(load.failures == 0);
+            char label[32];
+            std::snprintf(label, sizeof(label), "%s, %u clients", name,
+                          clients);
+            PrintLoad(label, "/api/v1/maps"sv, load);
+            std::printf("%-24s server CPU %.2f us per request\n", label,
+                        cpu.count() / load.requests);
+        }
+    }
+}
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Реактор сокетов Asio выбирается при сборке, поэтому для сравнения epoll
+// и io_uring тест запускается в двух сборках (GAME_SERVER_IO_URING_SOCKETS).
+// Статика не кешируется, чтобы каждый запрос к ней читал файл
+TEST_CASE("Network backend under load", "[.][benchmark]") {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    constexpr const char *BACKEND = "io_uring";
+#else
+    constexpr const char *BACKEND = "epoll";
+#endif
+    const StaticDirectory static_dir;
+    const unsigned clients =
+        4 * std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<http_handler::FileIo> file_modes{http_handler::FileIo::SYNC};
+    if (http_handler::IsUringFileIoSupported()) {
+        file_modes.push_back(http_handler::FileIo::URING);
+    }
+
+    for (const auto file_io : file_modes) {
+        TestServer server{static_dir.GetPath(),
+                          {.static_cache_size = 0, .file_io = file_io}};
+        for (const auto target : {"/api/v1/maps"sv, "/index.html"sv}) {
+            const auto cpu_before = server.GetCpuTime();
+            const auto load =
+                RunLoad(server.GetPort(), target, clients, LOAD_DURATION);
+            const std::chrono::duration<double, std::micro> cpu =
+                server.GetCpuTime() - cpu_before;
+
+            CHECK(load.failures == 0);
+            char label[40];
+            std::snprintf(label, sizeof(label), "%s, %s file reads", BACKEND,
+                          file_io == http_handler::FileIo::SYNC ? "sync"
+                                                                : "uring");
+            PrintLoad(label, target, load);
+            std::printf("%-24s server CPU %.2f us per request\n", label,
+                        cpu.count() / load.requests);
+        }
+    }
+}
@@ -0,0 +1,209 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/log/sinks/basic_sink_backend.hpp>
+#include <boost/log/sinks/sync_frontend.hpp>
+
+#include "logs.hpp"
+
+using namespace std::literals;
+
+namespace {
+
+namespace sinks = logging::sinks;
+
+// Сохраняет записи лога, выведенные за время своей жизни
+class CapturedRecords {
+  public:
+    CapturedRecords() {
+        logging::add_common_attributes();
+        logging::core::get()->add_sink(sink_);
+    }
+
+    ~CapturedRecords() { logging::core::get()->remove_sink(sink_); }
+
+    const std::vector<logging::record_view> &Get() const {
+        return sink_->locked_backend()->records;
+    }
+
+  private:
+    struct Backend : sinks::basic_sink_backend<sinks::synchronized_feeding> {
+        void consume(const logging::record_view &rec) {
+            records.push_back(rec);
+        }
+
+        std::vector<logging::record_view> records;
+    };
+
+    boost::shared_ptr<sinks::synchronous_sink<Backend>> sink_ =
+        boost::make_shared<sinks::synchronous_sink<Backend>>();
+};
+
+// Данные записи об ответе, как в LoggingRequestHandler::LogResponse
+std::string MakeResponseData() {
+    std::string data;
+    logs::JsonObjectWriter{data}
+        .Add("ip"sv, "127.0.0.1"sv)
+        .Add("response_time"sv, 42)
+        .Add("code"sv, 200)
+        .Add("content_type"sv, "application/json"sv);
+    return data;
+}
+
+// Запись в том виде, в котором её собирал прежний форматтер: дерево
+// json::object с временем из to_iso_extended_string
+std::string FormatWithJsonObject(const boost::posix_time::ptime &ts,
+                                 std::string_view message) {
+    json::object data;
+    data["ip"] = "127.0.0.1";
+    data["response_time"] = 42;
+    data["code"] = 200;
+    data["content_type"] = "application/json";
+
+    json::object record;
+    record["timestamp"] = to_iso_extended_string(ts);
+    record["data"] = std::move(data);
+    record["message"] = message;
+    return json::serialize(record);
+}
+
+// Собирает всё, что выводится в stdout за время своей жизни
+class CapturedStdout {
+  public:
+    CapturedStdout() {
+        std::cout.flush();
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        ::dup2(fds[1], STDOUT_FILENO);
+        ::close(fds[1]);
+        reader_ = std::thread{[this, fd = fds[0]] {
+            char buffer[64 * 1024];
+            ssize_t size = 0;
+            while ((size = ::read(fd, buffer, sizeof(buffer))) > 0) {
+                output_.append(buffer, size);
+            }
+            ::close(fd);
+        }};
+    }
+
+    ~CapturedStdout() { Stop(); }
+
+    // Возвращает stdout на место и отдаёт собранный вывод
+    const std::string &Stop() {
+        if (reader_.joinable()) {
+            std::cout.flush();
+            ::dup2(stdout_, STDOUT_FILENO);
+            ::close(stdout_);
+            reader_.join();
+        }
+        return output_;
+    }
+
+  private:
+    int stdout_ = ::dup(STDOUT_FILENO);
+    std::string output_;
+    std::thread reader_;
+};
+
+} // namespace
+
+TEST_CASE("Asynchronous log outputs records of every thread in order") {
+    constexpr int THREADS = 4;
+    constexpr int RECORDS = 1000;
+
+    CapturedStdout captured;
+    // Маленькие очереди заставляют потоки ждать поток вывода
+    logs::init({.queue_size = 8, .overflow = logs::OverflowPolicy::BLOCK});
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < THREADS; ++thread) {
+        threads.emplace_back([thread] {
+            for (int i = 0; i < RECORDS; ++i) {
+                BOOST_LOG_TRIVIAL(info) << "t" << thread << " r" << i;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    logs::shutdown();
+    const auto &output = captured.Stop();
+
+    std::vector<int> next(THREADS, 0);
+    std::size_t lines = 0;
+    for (std::size_t pos = 0; (pos = output.find(R"("message":"t)", pos)) !=
+                              std::string::npos;
+         ++lines) {
+        pos += std::string_view{R"("message":"t)"}.size();
+        const int thread = output[pos] - '0';
+        const int record = std::stoi(output.substr(pos + 3));
+        REQUIRE(thread < THREADS);
+        CHECK(record == next[thread]++);
+    }
+    CHECK(lines == THREADS * RECORDS);
+}
+
+TEST_CASE("FormatRecord writes timestamp, data and message") {
+    const CapturedRecords captured;
+    BOOST_LOG_TRIVIAL(info)
+        << logging::add_value(additional_data, MakeResponseData())
+        << "response \"sent\""sv;
+    REQUIRE(captured.Get().size() == 1);
+    const auto &rec = captured.Get().front();
+
+    std::string out;
+    logs::FormatRecord(rec, out);
+
+    CHECK(out == R"({"timestamp":")" +
+                     to_iso_extended_string(rec[timestamp].get()) +
+                     R"(","data":{"ip":"127.0.0.1","response_time":42,)"
+                     R"("code":200,"content_type":"application/json"},)"
+                     R"("message":"response \"sent\""})"
+                     "\n");
+}
+
+TEST_CASE("FormatRecord omits missing data") {
+    const CapturedRecords captured;
+    BOOST_LOG_TRIVIAL(info) << "server started"sv;
+    REQUIRE(captured.Get().size() == 1);
+
+    std::string out;
+    logs::FormatRecord(captured.Get().front(), out);
+
+    CHECK(out.ends_with(R"(","message":"server started"})"
+                        "\n"sv));
+    CHECK(out.find(R"("data")") == std::string::npos);
+}
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Сравнение с json::object имеет смысл только с настоящим Boost.JSON
+TEST_CASE("Log record formatting", "[.][benchmark]") {
+    const CapturedRecords captured;
+    BOOST_LOG_TRIVIAL(info)
+        << logging::add_value(additional_data, MakeResponseData())
+        << "response sent"sv;
+    const auto &rec = captured.Get().front();
+    const auto ts = rec[timestamp].get();
+
+    std::string out;
+    out.reserve(1024);
+
+    BENCHMARK("JsonObjectWriter: response data") {
+        return MakeResponseData().size();
+    };
+    BENCHMARK("FormatRecord") {
+        out.clear();
+        logs::FormatRecord(rec, out);
+        return out.size();
+    };
+    BENCHMARK("json::object: response data and record") {
+        return FormatWithJsonObject(ts, "response sent"sv).size();
+    };
+}
@@ -0,0 +1,103 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <latch>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "blocking_io_pool.hpp"
+#include "metrics.hpp"
+
+using namespace std::literals;
+
+namespace {
+
+// Показатели общие для всего процесса, поэтому каждый тест пишет в
+// собственный маршрут
+bool HasLine(const std::string &text, std::string_view line) {
+    return text.find("\n"s.append(line).append("\n")) != std::string::npos;
+}
+
+} // namespace
+
+TEST_CASE("RecordRequest counts durations in histogram buckets") {
+    constexpr auto ROUTE = "/test/buckets"sv;
+    metrics::RecordRequest(ROUTE, 200, 500ns);
+    metrics::RecordRequest(ROUTE, 200, 3us);
+    metrics::RecordRequest(ROUTE, 200, 3'900ns);
+    metrics::RecordRequest(ROUTE, 200, 10ms);
+    metrics::RecordRequest(ROUTE, 404, 1us);
+
+    const auto text = metrics::Render();
+    constexpr auto BUCKET = R"(http_request_duration_seconds_bucket{)"
+                            R"(route="/test/buckets",code="200",)"sv;
+
+    CHECK(HasLine(text, std::string{BUCKET} + R"(le="0.000001"} 1)"));
+    CHECK(HasLine(text, std::string{BUCKET} + R"(le="0.000003"} 1)"));
+    CHECK(HasLine(text, std::string{BUCKET} + R"(le="0.000004"} 3)"));
+    CHECK(HasLine(text, std::string{BUCKET} + R"(le="+Inf"} 4)"));
+    CHECK(HasLine(text, R"(http_request_duration_seconds_sum{)"
+                        R"(route="/test/buckets",code="200"} 0.010006)"));
+    CHECK(HasLine(text, R"(http_request_duration_seconds_count{)"
+                        R"(route="/test/buckets",code="404"} 1)"));
+}
+
+TEST_CASE("Render merges the shards of all threads") {
+    constexpr auto ROUTE = "/test/threads"sv;
+    constexpr int THREADS = 4;
+    constexpr int REQUESTS = 1'000;
+
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < THREADS; ++i) {
+        threads.emplace_back([ROUTE] {
+            for (int j = 0; j < REQUESTS; ++j) {
+                metrics::RecordRequest(ROUTE, 200, 100us);
+            }
+        });
+    }
+    threads.clear();
+
+    CHECK(HasLine(metrics::Render(),
+                  R"(http_request_duration_seconds_count{)"
+                  R"(route="/test/threads",code="200"} 4000)"));
+}
+
+TEST_CASE("Render shows the gauges of the blocking I/O pool") {
+    http_handler::BlockingIoPool pool{{.threads = 1, .max_queued = 4}};
+    std::latch started{1};
+    std::latch release{1};
+    REQUIRE(pool.Submit([&] {
+        started.count_down();
+        release.wait();
+    }));
+    started.wait();
+    REQUIRE(pool.Submit([] {}));
+
+    const auto gauges = pool.GetGauges();
+    CHECK(gauges.queued == 1);
+    CHECK(gauges.busy == 1);
+    const auto text = metrics::Render(gauges);
+    CHECK(HasLine(text, "blocking_io_queue_depth 1"));
+    CHECK(HasLine(text, "blocking_io_busy_threads 1"));
+
+    release.count_down();
+}
+
+// Запускается явно: game_server_tests "[benchmark]"
+TEST_CASE("Metrics recording overhead", "[.][benchmark]") {
+    constexpr auto ROUTE = "/test/benchmark"sv;
+    metrics::RecordRequest(ROUTE, 200, 1us);
+
+    auto duration = 0ns;
+    BENCHMARK("RecordRequest") {
+        duration += 37ns;
+        metrics::RecordRequest(ROUTE, 200, duration);
+    };
+    BENCHMARK("Increment") {
+        metrics::Increment(metrics::Counter::BYTES_SENT, 100);
+    };
+    BENCHMARK("Add") { metrics::Add(metrics::Gauge::ACTIVE_SESSIONS, 1); };
+}
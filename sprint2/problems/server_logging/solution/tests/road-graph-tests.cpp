@@ -0,0 +1,297 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "model.hpp"
+
+using namespace model;
+
+namespace {
+
+using Cell = std::pair<Coord, Coord>;
+
+bool Covers(const Road &road, Coord x, Coord y) {
+    const auto start = road.GetStart();
+    const auto end = road.GetEnd();
+    return std::min(start.x, end.x) <= x && x <= std::max(start.x, end.x) &&
+           std::min(start.y, end.y) <= y && y <= std::max(start.y, end.y);
+}
+
+bool CoversAny(const std::vector<Road> &roads, Coord x, Coord y) {
+    return std::any_of(roads.begin(), roads.end(), [x, y](const Road &road) {
+        return Covers(road, x, y);
+    });
+}
+
+Coord GetLength(const Road &road) {
+    return std::abs(road.GetEnd().x - road.GetStart().x) +
+           std::abs(road.GetEnd().y - road.GetStart().y);
+}
+
+// Узлы, найденные перебором целых точек: концы объединённых дорог и точки,
+// через которые проходят и горизонтальная, и вертикальная дорога
+std::set<Cell> FindNodesBruteForce(const std::vector<Road> &roads, Coord min,
+                                   Coord max) {
+    std::set<Cell> nodes;
+    for (Coord x = min; x <= max; ++x) {
+        for (Coord y = min; y <= max; ++y) {
+            bool end = false;
+            bool horizontal = false;
+            bool vertical = false;
+            for (const auto &road : roads) {
+                if (!Covers(road, x, y)) {
+                    continue;
+                }
+                const auto start = road.GetStart();
+                const auto finish = road.GetEnd();
+                end = end || (start.x == x && start.y == y) ||
+                      (finish.x == x && finish.y == y);
+                horizontal = horizontal || start.x != finish.x;
+                vertical = vertical || start.y != finish.y;
+            }
+            if (end || (horizontal && vertical)) {
+                nodes.insert({x, y});
+            }
+        }
+    }
+    return nodes;
+}
+
+std::vector<Road> MakeRandomRoads(std::mt19937 &random, std::size_t count,
+                                  Coord extent, Coord max_length) {
+    std::uniform_int_distribution<Coord> coord{0, extent};
+    std::uniform_int_distribution<Coord> length{-max_length, max_length};
+    std::bernoulli_distribution horizontal{0.5};
+
+    std::vector<Road> roads;
+    for (std::size_t i = 0; i < count; ++i) {
+        const Point start{coord(random), coord(random)};
+        if (horizontal(random)) {
+            roads.emplace_back(Road::HORIZONTAL, start, start.x + length(random));
+        } else {
+            roads.emplace_back(Road::VERTICAL, start, start.y + length(random));
+        }
+    }
+    return roads;
+}
+
+// Сетка из lines горизонтальных и вертикальных линий длиной size, каждая из
+// которых нарисована pieces касающимися отрезками, как в конфигурациях,
+// составленных вручную
+std::vector<Road> MakeGridInPieces(std::mt19937 &random, Coord lines,
+                                   Coord spacing, int pieces) {
+    const Coord size = (lines - 1) * spacing;
+    std::uniform_int_distribution<Coord> cut{1, size - 1};
+
+    std::vector<Road> roads;
+    for (Coord line = 0; line < lines; ++line) {
+        std::vector<Coord> cuts{0, size};
+        for (int i = 1; i < pieces; ++i) {
+            cuts.push_back(cut(random));
+        }
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+        for (std::size_t i = 1; i < cuts.size(); ++i) {
+            roads.emplace_back(Road::HORIZONTAL,
+                               Point{cuts[i - 1], line * spacing}, cuts[i]);
+            roads.emplace_back(Road::VERTICAL,
+                               Point{line * spacing, cuts[i - 1]}, cuts[i]);
+        }
+    }
+    return roads;
+}
+
+} // namespace
+
+TEST_CASE("RoadGraph merges collinear roads") {
+    SECTION("overlapping and touching roads become one") {
+        const RoadGraph graph{{
+            {Road::HORIZONTAL, {0, 0}, 5},
+            {Road::HORIZONTAL, {8, 0}, 3},
+            {Road::HORIZONTAL, {8, 0}, 12},
+            {Road::HORIZONTAL, {13, 0}, 20},
+        }};
+
+        REQUIRE(graph.GetRoads().size() == 2);
+        CHECK(graph.GetRoads()[0].GetStart().x == 0);
+        CHECK(graph.GetRoads()[0].GetEnd().x == 12);
+        CHECK(graph.GetRoads()[1].GetStart().x == 13);
+        CHECK(graph.GetRoads()[1].GetEnd().x == 20);
+    }
+
+    SECTION("roads on different lines are not merged") {
+        const RoadGraph graph{{
+            {Road::HORIZONTAL, {0, 0}, 5},
+            {Road::HORIZONTAL, {0, 1}, 5},
+            {Road::VERTICAL, {5, 0}, 5},
+        }};
+
+        CHECK(graph.GetRoads().size() == 3);
+    }
+
+    SECTION("zero-length roads are kept only off other roads") {
+        const RoadGraph graph{{
+            {Road::HORIZONTAL, {0, 0}, 5},
+            {Road::HORIZONTAL, {3, 0}, 3},
+            {Road::VERTICAL, {7, 7}, 7},
+            {Road::VERTICAL, {7, 7}, 7},
+        }};
+
+        const auto stats = graph.GetStats();
+        CHECK(stats.source_roads == 4);
+        CHECK(stats.roads == 2);
+        CHECK(stats.nodes == 3);
+        CHECK(stats.edges == 1);
+        const auto dot = graph.FindNode({7, 7});
+        REQUIRE(dot);
+        CHECK(graph.GetEdges(*dot).empty());
+    }
+}
+
+TEST_CASE("RoadGraph connects junctions") {
+    // Горизонтальная дорога, пересечённая вертикальной посередине, и
+    // вертикальная, примыкающая к её концу
+    const RoadGraph graph{{
+        {Road::HORIZONTAL, {0, 0}, 10},
+        {Road::VERTICAL, {4, -3}, 3},
+        {Road::VERTICAL, {10, 0}, 6},
+    }};
+
+    const auto stats = graph.GetStats();
+    CHECK(stats.roads == 3);
+    CHECK(stats.nodes == 6);
+    CHECK(stats.edges == 5);
+
+    const auto crossing = graph.FindNode({4, 0});
+    REQUIRE(crossing);
+    const auto edges = graph.GetEdges(*crossing);
+    REQUIRE(edges.size() == 4);
+    std::multiset<Coord> lengths;
+    for (const auto &edge : edges) {
+        lengths.insert(edge.length);
+    }
+    CHECK(lengths == std::multiset<Coord>{3, 3, 4, 6});
+
+    const auto corner = graph.FindNode({10, 0});
+    REQUIRE(corner);
+    CHECK(graph.GetEdges(*corner).size() == 2);
+    CHECK_FALSE(graph.FindNode({5, 0}));
+}
+
+TEST_CASE("RoadGraph matches checking every point") {
+    std::mt19937 random{42};
+
+    for (int map = 0; map < 200; ++map) {
+        const auto roads = MakeRandomRoads(random, 1 + map % 40, 15, 8);
+        const RoadGraph graph{roads};
+        const auto &merged = graph.GetRoads();
+
+        std::set<Cell> nodes;
+        for (const auto node : graph.GetNodes()) {
+            nodes.insert({node.x, node.y});
+        }
+
+        for (Coord x = -10; x <= 25; ++x) {
+            for (Coord y = -10; y <= 25; ++y) {
+                REQUIRE(CoversAny(roads, x, y) == CoversAny(merged, x, y));
+            }
+        }
+        REQUIRE(nodes == FindNodesBruteForce(merged, -10, 25));
+
+        // Рёбра идут вдоль осей, хранятся в обоих концах и вместе покрывают
+        // каждую дорогу ровно один раз
+        long total_length = 0;
+        for (RoadGraph::NodeIndex node = 0; node < graph.GetNodes().size();
+             ++node) {
+            const auto from = graph.GetNodes()[node];
+            for (const auto &edge : graph.GetEdges(node)) {
+                const auto to = graph.GetNodes()[edge.to];
+                REQUIRE((from.x == to.x || from.y == to.y));
+                REQUIRE(std::abs(from.x - to.x) + std::abs(from.y - to.y) ==
+                        edge.length);
+                REQUIRE(Covers(merged[edge.road], to.x, to.y));
+                const auto back = graph.GetEdges(edge.to);
+                REQUIRE(std::any_of(back.begin(), back.end(),
+                                    [node](const auto &edge) {
+                                        return edge.to == node;
+                                    }));
+                total_length += edge.length;
+            }
+        }
+        long roads_length = 0;
+        for (const auto &road : merged) {
+            roads_length += GetLength(road);
+        }
+        REQUIRE(total_length == 2 * roads_length);
+    }
+}
+
+TEST_CASE("Map builds its road index over merged roads") {
+    Map map{Map::Id{"map"}, "Map"};
+    map.AddRoad({Road::HORIZONTAL, {0, 0}, 5});
+    map.AddRoad({Road::HORIZONTAL, {5, 0}, 10});
+    map.AddRoad({Road::VERTICAL, {10, 0}, 10});
+    map.Compile();
+
+    CHECK(map.GetRoads().size() == 3);
+    CHECK(map.GetRoadGraph().GetRoads().size() == 2);
+    CHECK(map.GetRoadIndex().FindRoadsAt({5, 0}) == std::vector<std::size_t>{0});
+    CHECK(map.GetRoadIndex().GetMaxReachable({1, 0}, Direction::EAST) ==
+          Position{10 + ROAD_HALF_WIDTH, 0});
+}
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Такта в этом сервере нет, поэтому время такта оценивается временем, за
+// которое 10'000 собак находят, докуда могут дойти, по индексу исходных и
+// объединённых дорог
+TEST_CASE("Merged roads in a movement tick", "[.][benchmark]") {
+    constexpr std::size_t DOG_COUNT = 10'000;
+    constexpr Coord LINES = 101;
+    constexpr Coord SPACING = 10;
+
+    std::mt19937 random{42};
+    for (const int pieces : {1, 2, 4, 8}) {
+        const auto roads = MakeGridInPieces(random, LINES, SPACING, pieces);
+        const RoadIndex raw_index{roads};
+        const RoadGraph graph{roads};
+        const RoadIndex merged_index{graph.GetRoads()};
+
+        std::uniform_int_distribution<Coord> line{0, LINES - 1};
+        std::uniform_real_distribution<double> along{0.0,
+                                                     1.0 * (LINES - 1) * SPACING};
+        std::uniform_int_distribution<int> direction{0, 3};
+        std::vector<std::pair<Position, Direction>> dogs(DOG_COUNT);
+        for (auto &[position, dog_direction] : dogs) {
+            const double on_line = line(random) * SPACING;
+            position = direction(random) % 2 ? Position{along(random), on_line}
+                                             : Position{on_line, along(random)};
+            dog_direction = static_cast<Direction>(direction(random));
+        }
+
+        auto tick = [&dogs](const RoadIndex &index) {
+            double sum = 0;
+            for (const auto &[position, dog_direction] : dogs) {
+                const auto reached =
+                    index.GetMaxReachable(position, dog_direction);
+                sum += reached.x + reached.y;
+            }
+            return sum;
+        };
+        REQUIRE(tick(raw_index) == tick(merged_index));
+
+        const auto stats = graph.GetStats();
+        const auto name = std::to_string(stats.source_roads) + " -> " +
+                          std::to_string(stats.roads) + " roads";
+
+        BENCHMARK("Build graph: " + name) { return RoadGraph{roads}; };
+        BENCHMARK("Tick, config roads: " + name) { return tick(raw_index); };
+        BENCHMARK("Tick, merged roads: " + name) {
+            return tick(merged_index);
+        };
+    }
+}
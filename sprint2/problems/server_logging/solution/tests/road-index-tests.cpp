@@ -0,0 +1,290 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "model.hpp"
+
+using namespace model;
+
+namespace {
+
+constexpr Direction DIRECTIONS[] = {Direction::NORTH, Direction::SOUTH,
+                                    Direction::WEST, Direction::EAST};
+
+struct Bounds {
+    double min_x, max_x, min_y, max_y;
+};
+
+// Границы полосы дороги, вычисленные независимо от RoadIndex
+Bounds GetBounds(const Road &road) {
+    const auto start = road.GetStart();
+    const auto end = road.GetEnd();
+    return {std::min(start.x, end.x) - ROAD_HALF_WIDTH,
+            std::max(start.x, end.x) + ROAD_HALF_WIDTH,
+            std::min(start.y, end.y) - ROAD_HALF_WIDTH,
+            std::max(start.y, end.y) + ROAD_HALF_WIDTH};
+}
+
+bool Covers(const Bounds &bounds, Position position) {
+    return position.x >= bounds.min_x && position.x <= bounds.max_x &&
+           position.y >= bounds.min_y && position.y <= bounds.max_y;
+}
+
+std::vector<std::size_t> FindRoadsAtBruteForce(const std::vector<Road> &roads,
+                                               Position position) {
+    std::vector<std::size_t> result;
+    for (std::size_t i = 0; i < roads.size(); ++i) {
+        if (Covers(GetBounds(roads[i]), position)) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+// Продвигает точку до дальней границы дорог, которым она принадлежит, пока
+// это что-то меняет
+Position GetMaxReachableBruteForce(const std::vector<Road> &roads,
+                                   Position position, Direction direction) {
+    const bool along_x =
+        direction == Direction::WEST || direction == Direction::EAST;
+    const bool forward =
+        direction == Direction::EAST || direction == Direction::SOUTH;
+    double &along = along_x ? position.x : position.y;
+    while (true) {
+        double farthest = along;
+        for (const auto road : FindRoadsAtBruteForce(roads, position)) {
+            const auto bounds = GetBounds(roads[road]);
+            const double min = along_x ? bounds.min_x : bounds.min_y;
+            const double max = along_x ? bounds.max_x : bounds.max_y;
+            farthest =
+                forward ? std::max(farthest, max) : std::min(farthest, min);
+        }
+        if (farthest == along) {
+            return position;
+        }
+        along = farthest;
+    }
+}
+
+double GetDistanceToRoadsBruteForce(const std::vector<Road> &roads,
+                                    Position position) {
+    double distance = INFINITY;
+    for (const auto &road : roads) {
+        const auto bounds = GetBounds(road);
+        const double dx = std::max({0.0, bounds.min_x - position.x,
+                                    position.x - bounds.max_x});
+        const double dy = std::max({0.0, bounds.min_y - position.y,
+                                    position.y - bounds.max_y});
+        distance = std::min(distance, std::hypot(dx, dy));
+    }
+    return distance;
+}
+
+// Дороги длиной до max_length со случайными началами в квадрате extent
+std::vector<Road> MakeRandomRoads(std::mt19937 &random, std::size_t count,
+                                  Coord extent, Coord max_length) {
+    std::uniform_int_distribution<Coord> coord{0, extent};
+    std::uniform_int_distribution<Coord> length{-max_length, max_length};
+    std::bernoulli_distribution horizontal{0.5};
+
+    std::vector<Road> roads;
+    roads.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const Point start{coord(random), coord(random)};
+        if (horizontal(random)) {
+            roads.emplace_back(Road::HORIZONTAL, start, start.x + length(random));
+        } else {
+            roads.emplace_back(Road::VERTICAL, start, start.y + length(random));
+        }
+    }
+    return roads;
+}
+
+} // namespace
+
+TEST_CASE("RoadIndex finds roads covering a point") {
+    const std::vector<Road> roads{
+        {Road::HORIZONTAL, {0, 0}, 10},
+        {Road::VERTICAL, {10, 0}, 10},
+        {Road::HORIZONTAL, {5, 10}, 15},
+    };
+    const RoadIndex index{roads};
+
+    auto find = [&index](Position position) {
+        auto found = index.FindRoadsAt(position);
+        std::sort(found.begin(), found.end());
+        return found;
+    };
+
+    CHECK(find({5, 0}) == std::vector<std::size_t>{0});
+    CHECK(find({10, 0.2}) == std::vector<std::size_t>{0, 1});
+    CHECK(find({10, 10}) == std::vector<std::size_t>{1, 2});
+    CHECK(find({-0.4, 0.4}) == std::vector<std::size_t>{0});
+    CHECK(find({5, 5}).empty());
+    CHECK_FALSE(index.IsOnRoad({-0.5, 0}));
+    CHECK_FALSE(index.IsOnRoad({0, 0.5}));
+}
+
+TEST_CASE("RoadIndex moves a point to the farthest reachable position") {
+    const std::vector<Road> roads{
+        {Road::HORIZONTAL, {0, 0}, 10},
+        {Road::VERTICAL, {10, 0}, 10},
+        {Road::HORIZONTAL, {10, 10}, 20},
+    };
+    const RoadIndex index{roads};
+
+    CHECK(index.GetMaxReachable({5, 0}, Direction::EAST) ==
+          Position{10 + ROAD_HALF_WIDTH, 0});
+    CHECK(index.GetMaxReachable({5, 0}, Direction::WEST) ==
+          Position{0 - ROAD_HALF_WIDTH, 0});
+    CHECK(index.GetMaxReachable({10, 0}, Direction::SOUTH) ==
+          Position{10, 10 + ROAD_HALF_WIDTH});
+    // Точка вне дорог остаётся на месте
+    CHECK(index.GetMaxReachable({5, 5}, Direction::EAST) == Position{5, 5});
+}
+
+TEST_CASE("Points on road edges are on the road") {
+    std::vector<Road> roads;
+    for (Coord y = 0; y <= 100; ++y) {
+        roads.emplace_back(Road::HORIZONTAL, Point{0, y}, 10);
+    }
+    const RoadIndex index{roads};
+
+    for (Coord y = 0; y <= 100; ++y) {
+        for (const auto direction : DIRECTIONS) {
+            const auto reached =
+                index.GetMaxReachable({5, static_cast<double>(y)}, direction);
+            INFO("y = " << y);
+            CHECK(index.IsOnRoad(reached));
+        }
+        const auto nearest = index.FindNearestRoadPoint({5, y + 0.45});
+        REQUIRE(nearest);
+        CHECK(index.IsOnRoad(*nearest));
+    }
+}
+
+TEST_CASE("RoadIndex matches checking every road") {
+    std::mt19937 random{42};
+
+    for (int map = 0; map < 30; ++map) {
+        const auto roads = MakeRandomRoads(random, 200, 50, 10);
+        const RoadIndex index{roads};
+        std::uniform_real_distribution<double> coord{-5, 55};
+        // Часть точек берётся на краях дорог, где легче всего ошибиться
+        std::uniform_int_distribution<std::size_t> road_index{0,
+                                                              roads.size() - 1};
+
+        for (int i = 0; i < 300; ++i) {
+            Position position{coord(random), coord(random)};
+            if (i % 3 == 0) {
+                const auto bounds = GetBounds(roads[road_index(random)]);
+                position = {i % 2 ? bounds.max_x : bounds.min_x,
+                            i % 4 ? bounds.max_y : bounds.min_y};
+            }
+
+            auto found = index.FindRoadsAt(position);
+            std::sort(found.begin(), found.end());
+            REQUIRE(found == FindRoadsAtBruteForce(roads, position));
+
+            for (const auto direction : DIRECTIONS) {
+                const auto reached = index.GetMaxReachable(position, direction);
+                REQUIRE(reached ==
+                        GetMaxReachableBruteForce(roads, position, direction));
+                if (index.IsOnRoad(position)) {
+                    REQUIRE(index.IsOnRoad(reached));
+                }
+            }
+
+            const auto nearest = index.FindNearestRoadPoint(position);
+            REQUIRE(nearest);
+            REQUIRE(index.IsOnRoad(*nearest));
+            const double distance =
+                std::hypot(nearest->x - position.x, nearest->y - position.y);
+            REQUIRE(std::abs(distance - GetDistanceToRoadsBruteForce(
+                                            roads, position)) < 1e-9);
+        }
+    }
+}
+
+TEST_CASE("RoadIndex finds overlapping roads on one line") {
+    std::mt19937 random{42};
+    // Длинные дороги на нескольких линиях перекрывают друг друга
+    std::uniform_int_distribution<Coord> line{0, 3};
+    std::uniform_int_distribution<Coord> coord{0, 1000};
+    std::vector<Road> roads;
+    for (int i = 0; i < 2000; ++i) {
+        const auto [from, to] = std::minmax(coord(random), coord(random));
+        if (i % 2) {
+            roads.emplace_back(Road::HORIZONTAL, Point{from, line(random)}, to);
+        } else {
+            roads.emplace_back(Road::VERTICAL, Point{line(random), from}, to);
+        }
+    }
+    const RoadIndex index{roads};
+
+    std::uniform_real_distribution<double> along{-1, 1001};
+    std::uniform_real_distribution<double> across{-1, 4};
+    for (int i = 0; i < 1000; ++i) {
+        const Position position = i % 2 ? Position{along(random), across(random)}
+                                         : Position{across(random), along(random)};
+        auto found = index.FindRoadsAt(position);
+        std::sort(found.begin(), found.end());
+        REQUIRE(found == FindRoadsAtBruteForce(roads, position));
+    }
+}
+
+// Запускается явно: game_server_tests "[benchmark]"
+TEST_CASE("RoadIndex query scaling", "[.][benchmark]") {
+    std::mt19937 random{42};
+
+    for (const std::size_t count : {1'000u, 10'000u, 100'000u}) {
+        const Coord extent = static_cast<Coord>(std::sqrt(count) * 10);
+        const auto roads = MakeRandomRoads(random, count, extent, 10);
+        const RoadIndex index{roads};
+
+        std::uniform_real_distribution<double> coord{0.0, 1.0 * extent};
+        std::vector<Position> positions(1'000);
+        for (auto &position : positions) {
+            position = {coord(random), coord(random)};
+        }
+        const auto name = std::to_string(count) + " roads";
+
+        BENCHMARK("Build index: " + name) { return RoadIndex{roads}; };
+
+        BENCHMARK("1000 FindRoadsAt, index: " + name) {
+            std::size_t found = 0;
+            for (const auto position : positions) {
+                index.ForEachRoadAt(position, [&found](std::size_t) { ++found; });
+            }
+            return found;
+        };
+
+        BENCHMARK("1000 FindRoadsAt, every road: " + name) {
+            std::size_t found = 0;
+            for (const auto position : positions) {
+                found += FindRoadsAtBruteForce(roads, position).size();
+            }
+            return found;
+        };
+
+        BENCHMARK("1000 GetMaxReachable: " + name) {
+            double sum = 0;
+            for (const auto position : positions) {
+                sum += index.GetMaxReachable(position, Direction::EAST).x;
+            }
+            return sum;
+        };
+
+        BENCHMARK("1000 FindNearestRoadPoint: " + name) {
+            double sum = 0;
+            for (const auto position : positions) {
+                sum += index.FindNearestRoadPoint(position)->x;
+            }
+            return sum;
+        };
+    }
+}
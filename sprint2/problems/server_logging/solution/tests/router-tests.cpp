@@ -0,0 +1,162 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/lexical_cast/try_lexical_convert.hpp>
+
+#include "allocation_counter.hpp"
+#include "router.hpp"
+
+using namespace http_handler;
+using namespace std::literals;
+
+namespace {
+
+enum class Route { ALL_MAPS, MAP, BAD_REQUEST, STATIC, METRICS };
+
+using TestRouter = Router<Route>;
+using Status = TestRouter::Match::Status;
+
+// Таблица маршрутов, как у RequestHandler
+TestRouter MakeRouter() {
+    using enum http::verb;
+    TestRouter router;
+    router.AddRoute("/api/v1/maps"sv, {get, head}, Route::ALL_MAPS)
+        .AddRoute("/api/v1/maps/{id}"sv, {get, head}, Route::MAP)
+        .AddRoute("/api/{*path}"sv, {}, Route::BAD_REQUEST)
+        .AddRoute("/{*path}"sv, {}, Route::STATIC)
+        .AddRoute("/metrics"sv, {get, head}, Route::METRICS);
+    return router;
+}
+
+// Разбор пути, которым RequestHandler пользовался до Router: цепочка
+// starts_with, разбиение пути boost::split и извлечение id карты
+Route RouteWithSplit(http::verb method, std::string_view target,
+                     std::string &map_id) {
+    if (!target.starts_with("/api/"sv)) {
+        return Route::STATIC;
+    }
+    if (method != http::verb::get) {
+        return Route::BAD_REQUEST;
+    }
+    if (target == "/api/v1/maps"sv) {
+        return Route::ALL_MAPS;
+    }
+    if (target.starts_with("/api/v1/maps/"sv)) {
+        std::vector<std::string> segments;
+        boost::split(segments, target, boost::is_any_of("/"));
+        if (segments.size() < 5 ||
+            !boost::conversion::try_lexical_convert(segments[4], map_id)) {
+            return Route::BAD_REQUEST;
+        }
+        return Route::MAP;
+    }
+    return Route::BAD_REQUEST;
+}
+
+} // namespace
+
+TEST_CASE("Router matches literal paths and parameters") {
+    const auto router = MakeRouter();
+    const std::string target = "/api/v1/maps/map1?x=1";
+
+    const auto map = router.Find(http::verb::get, target);
+    REQUIRE(map.status == Status::FOUND);
+    CHECK(*map.handler == Route::MAP);
+    CHECK(map.pattern == "/api/v1/maps/{id}"sv);
+    CHECK(map.params.Get("id"sv) == "map1"sv);
+    // Значение параметра ссылается на target запроса
+    CHECK(map.params.Get("id"sv).data() == target.data() + 13);
+
+    const auto maps = router.Find(http::verb::head, "/api/v1/maps"sv);
+    REQUIRE(maps.status == Status::FOUND);
+    CHECK(*maps.handler == Route::ALL_MAPS);
+}
+
+TEST_CASE("Router prefers literal segments to parameters and rests") {
+    const auto router = MakeRouter();
+
+    const auto metrics = router.Find(http::verb::get, "/metrics"sv);
+    REQUIRE(metrics.status == Status::FOUND);
+    CHECK(*metrics.handler == Route::METRICS);
+
+    const auto nested = router.Find(http::verb::get, "/api/v1/maps/a/b"sv);
+    REQUIRE(nested.status == Status::FOUND);
+    CHECK(*nested.handler == Route::BAD_REQUEST);
+    CHECK(nested.params.Get("path"sv) == "v1/maps/a/b"sv);
+
+    const auto file = router.Find(http::verb::get, "/assets/pug.fbx"sv);
+    REQUIRE(file.status == Status::FOUND);
+    CHECK(*file.handler == Route::STATIC);
+    CHECK(file.params.Get("path"sv) == "assets/pug.fbx"sv);
+}
+
+TEST_CASE("Router finds literal routes by the whole path") {
+    const auto router = MakeRouter();
+
+    const auto maps = router.Find(http::verb::get, "/api/v1/maps?x=1"sv);
+    REQUIRE(maps.status == Status::FOUND);
+    CHECK(*maps.handler == Route::ALL_MAPS);
+    CHECK(maps.params.Size() == 0);
+
+    // Пути той же длины, что и маршруты без параметров, ищутся в дереве
+    const auto other = router.Find(http::verb::get, "/api/v1/mapz"sv);
+    REQUIRE(other.status == Status::FOUND);
+    CHECK(*other.handler == Route::BAD_REQUEST);
+    CHECK(other.params.Get("path"sv) == "v1/mapz"sv);
+
+    const auto file = router.Find(http::verb::get, "/metricz"sv);
+    REQUIRE(file.status == Status::FOUND);
+    CHECK(*file.handler == Route::STATIC);
+
+    // Таблица остаётся действительной после перемещения маршрутизатора
+    auto source = MakeRouter();
+    const auto moved = std::move(source);
+    CHECK(*moved.Find(http::verb::get, "/metrics"sv).handler ==
+          Route::METRICS);
+}
+
+TEST_CASE("Router reports methods allowed for a path") {
+    const auto router = MakeRouter();
+
+    const auto match = router.Find(http::verb::post, "/api/v1/maps"sv);
+    CHECK(match.status == Status::METHOD_NOT_ALLOWED);
+    CHECK(match.allow == "GET, HEAD"sv);
+    CHECK(match.pattern == "/api/v1/maps"sv);
+
+    CHECK(router.Find(http::verb::get, "maps"sv).status == Status::NOT_FOUND);
+}
+
+TEST_CASE("Router::Find does not allocate") {
+    const auto router = MakeRouter();
+
+    const auto before = GetAllocationCount();
+    for (const auto target : {"/api/v1/maps"sv, "/api/v1/maps/map1"sv,
+                              "/api/v2/x"sv, "/index.html"sv}) {
+        CHECK(router.Find(http::verb::get, target).status == Status::FOUND);
+    }
+    CHECK(GetAllocationCount() == before);
+}
+
+// Запускается явно: game_server_tests "[benchmark]"
+TEST_CASE("Router against starts_with and boost::split", "[.][benchmark]") {
+    const auto router = MakeRouter();
+
+    for (const auto target :
+         {"/api/v1/maps"sv, "/api/v1/maps/map1"sv, "/index.html"sv}) {
+        const std::string name{target};
+        BENCHMARK("Router: " + name) {
+            return router.Find(http::verb::get, target).params.Size();
+        };
+        BENCHMARK("starts_with and split: " + name) {
+            std::string map_id;
+            return RouteWithSplit(http::verb::get, target, map_id);
+        };
+    }
+}
@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "allocation_counter.hpp"
+#include "test_server.hpp"
+
+using namespace std::literals;
+using namespace test_server;
+
+namespace {
+
+constexpr std::size_t ASSET_SIZE = 50 * 1024 * 1024;
+constexpr int DOWNLOADS = 10;
+constexpr int CLIENTS = 8;
+
+// Резидентная память процесса, байт
+std::size_t GetResidentBytes() {
+    std::size_t pages = 0, resident = 0;
+    std::ifstream{"/proc/self/statm"} >> pages >> resident;
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+struct Mode {
+    const char *name;
+    TestServer::Options options;
+};
+
+} // namespace
+
+// Запускается явно: game_server_tests "[benchmark]".
+// Сравнивает отправку через sendfile с чтением файла в память, которым
+// сервер отправлял большие файлы раньше: порог sendfile выше размера файла,
+// а кеш статики меньше него, поэтому файл читается заново на каждый запрос.
+// Время процессора учитывается только у io-потоков: файлы для ответа в
+// памяти читают потоки пула блокирующего ввода-вывода
+TEST_CASE("Sending a 50 MB static file", "[.][benchmark]") {
+    const StaticDirectory static_dir;
+    static_dir.AddFile("asset.bin", ASSET_SIZE);
+
+    for (const auto &mode :
+         {Mode{"sendfile", {.sendfile_threshold = 1024 * 1024}},
+          Mode{"read", {.sendfile_threshold = 2 * ASSET_SIZE}}}) {
+        TestServer server{static_dir.GetPath(), mode.options};
+
+        Client client{server.GetPort()};
+        REQUIRE(client.Get("/asset.bin") == 200);
+
+        const auto bytes_before = GetAllocatedBytes();
+        const auto cpu_before = server.GetCpuTime();
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < DOWNLOADS; ++i) {
+            REQUIRE(client.Get("/asset.bin") == 200);
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        const std::chrono::duration<double, std::milli> cpu =
+            server.GetCpuTime() - cpu_before;
+
+        std::printf("%-8s 1 client:  %6.0f MB/s, io thread CPU %6.2f ms, "
+                    "%5.1f MB allocated per download\n",
+                    mode.name, DOWNLOADS * 50.0 / elapsed.count(),
+                    cpu.count() / DOWNLOADS,
+                    (GetAllocatedBytes() - bytes_before) / DOWNLOADS /
+                        (1024.0 * 1024.0));
+
+        // Одновременные загрузки: при чтении в память каждая держит в куче
+        // свою копию файла
+        const auto resident_before = GetResidentBytes();
+        std::atomic<std::size_t> resident_peak{resident_before};
+        std::jthread sampler{[&resident_peak](std::stop_token stop) {
+            while (!stop.stop_requested()) {
+                resident_peak =
+                    std::max(resident_peak.load(), GetResidentBytes());
+                std::this_thread::sleep_for(1ms);
+            }
+        }};
+
+        std::vector<std::jthread> clients;
+        const auto concurrent_start = std::chrono::steady_clock::now();
+        for (int i = 0; i < CLIENTS; ++i) {
+            clients.emplace_back([port = server.GetPort()] {
+                Client client{port};
+                for (int j = 0; j < DOWNLOADS / 2; ++j) {
+                    client.Get("/asset.bin");
+                }
+            });
+        }
+        clients.clear();
+        const std::chrono::duration<double> concurrent_elapsed =
+            std::chrono::steady_clock::now() - concurrent_start;
+        sampler = {};
+
+        std::printf("%-8s %d clients: %6.0f MB/s, resident memory grew by "
+                    "%5.1f MB\n",
+                    mode.name, CLIENTS,
+                    CLIENTS * (DOWNLOADS / 2) * 50.0 /
+                        concurrent_elapsed.count(),
+                    (resident_peak - resident_before) / (1024.0 * 1024.0));
+    }
+}
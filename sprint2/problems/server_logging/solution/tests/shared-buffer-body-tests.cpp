@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "shared_buffer_body.hpp"
+
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/beast/http/serializer.hpp>
+
+using namespace http_server;
+using namespace std::literals;
+
+namespace {
+
+using SharedBufferResponse = http::response<SharedBufferBody>;
+
+// Буферы, которые сериализатор отдаёт для отправки, в порядке отправки
+std::vector<std::string_view> Serialize(SharedBufferResponse &response) {
+    std::vector<std::string_view> buffers;
+    http::response_serializer<SharedBufferBody> serializer{response};
+    beast::error_code ec;
+    while (!serializer.is_done()) {
+        std::size_t size = 0;
+        serializer.next(ec, [&](beast::error_code &, const auto &sequence) {
+            for (const auto buffer : beast::buffers_range_ref(sequence)) {
+                buffers.emplace_back(static_cast<const char *>(buffer.data()),
+                                     buffer.size());
+                size += buffer.size();
+            }
+        });
+        REQUIRE(!ec);
+        serializer.consume(size);
+    }
+    return buffers;
+}
+
+std::string Concat(const std::vector<std::string_view> &buffers) {
+    std::string result;
+    for (const auto buffer : buffers) {
+        result += buffer;
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("SharedBufferBody sends the shared buffer without copying") {
+    const auto data = std::make_shared<const std::string>(R"({"id":"map1"})");
+    SharedBufferResponse response{http::status::ok, 11};
+    response.body() = SharedBufferBody::value_type{data};
+    response.prepare_payload();
+
+    const auto buffers = Serialize(response);
+
+    CHECK(response[http::field::content_length] == "13"sv);
+    REQUIRE(!buffers.empty());
+    CHECK(buffers.back().data() == data->data());
+    CHECK(buffers.back().size() == data->size());
+}
+
+TEST_CASE("SharedBufferBody sends a part of the shared buffer") {
+    const auto data = std::make_shared<const std::string>("0123456789");
+    SharedBufferResponse response{http::status::partial_content, 11};
+    const std::string_view data_view{*data};
+    response.body() = SharedBufferBody::value_type{data, data_view.substr(2, 5)};
+    response.prepare_payload();
+
+    const auto buffers = Serialize(response);
+
+    CHECK(response[http::field::content_length] == "5"sv);
+    CHECK(buffers.back() == "23456"sv);
+    CHECK(buffers.back().data() == data->data() + 2);
+}
+
+TEST_CASE("SharedBufferBody sends pieces one after another") {
+    const auto data = std::make_shared<const std::string>("0123456789");
+    const auto extra = std::make_shared<const std::string>("--b\r\n--b--");
+    const std::string_view data_view{*data}, extra_view{*extra};
+    SharedBufferResponse response{http::status::partial_content, 11};
+    response.body() = SharedBufferBody::value_type{
+        data,
+        extra,
+        {extra_view.substr(0, 5), data_view.substr(0, 3),
+         extra_view.substr(5), data_view.substr(7)}};
+    response.prepare_payload();
+
+    const auto buffers = Serialize(response);
+    const auto message = Concat(buffers);
+
+    CHECK(response[http::field::content_length] == "16"sv);
+    CHECK(message.ends_with("\r\n\r\n--b\r\n012--b--789"sv));
+    // Каждый участок отправляется из своего буфера, без склеивания
+    CHECK(buffers.back().data() == data->data() + 7);
+}
@@ -0,0 +1,100 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "static_content_cache.hpp"
+
+using namespace http_cache;
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+namespace {
+
+StaticContentCache::FilePtr MakeFile(const fs::path &relative_path,
+                                     std::size_t size,
+                                     ContentEncoding encoding =
+                                         ContentEncoding::IDENTITY) {
+    return std::make_shared<const StaticFile>(StaticFile{
+        .content = std::make_shared<const std::string>(size, 'x'),
+        .content_type = "text/plain"s,
+        .etag = {},
+        .last_write_time = {},
+        .last_modified_date = {},
+        .relative_path = relative_path,
+        .encoding = encoding,
+        .vary_by_encoding = true,
+    });
+}
+
+// Исходный файл размером size и его сжатая gzip-версия размером size / 2
+StaticContentCache::FileSetPtr MakeFileSet(const fs::path &relative_path,
+                                           std::size_t size) {
+    auto files = std::make_shared<StaticFileSet>();
+    files->Set(MakeFile(relative_path, size));
+    files->Set(MakeFile(relative_path, size / 2, ContentEncoding::GZIP));
+    return files;
+}
+
+} // namespace
+
+TEST_CASE("StaticContentCache keeps a file and its sidecars together") {
+    StaticContentCache cache{fs::temp_directory_path(), 400};
+    cache.Insert("a.js"s, MakeFileSet("a.js", 100), cache.BeginRead());
+    cache.Insert("b.js"s, MakeFileSet("b.js", 100), cache.BeginRead());
+
+    const auto a = cache.Find("a.js"sv);
+    REQUIRE(a);
+    CHECK(a->Size() == 150);
+    CHECK(a->Get(ContentEncoding::GZIP));
+    CHECK_FALSE(a->Get(ContentEncoding::BROTLI));
+
+    SECTION("eviction removes the whole set") {
+        // a.js использован после вставки, поэтому вытесняется b.js
+        cache.Insert("c.js"s, MakeFileSet("c.js", 100), cache.BeginRead());
+        CHECK(cache.Find("a.js"sv));
+        CHECK_FALSE(cache.Find("b.js"sv));
+        CHECK(cache.Find("c.js"sv));
+    }
+
+    SECTION("sets larger than the budget are not cached") {
+        cache.Insert("d.js"s, MakeFileSet("d.js", 300), cache.BeginRead());
+        CHECK_FALSE(cache.Find("d.js"sv));
+        CHECK(cache.Find("a.js"sv));
+    }
+
+    SECTION("inserting many sets keeps used memory within the budget") {
+        for (int i = 0; i < 100; ++i) {
+            const auto path = std::to_string(i) + ".js"s;
+            cache.Insert(path, MakeFileSet(path, 100), cache.BeginRead());
+        }
+        int cached = 0;
+        for (int i = 0; i < 100; ++i) {
+            cached += cache.Find(std::to_string(i) + ".js"s) ? 1 : 0;
+        }
+        CHECK(cached == 2);
+        CHECK(cache.Find("99.js"sv));
+    }
+
+    SECTION("changing a sidecar invalidates the source") {
+        cache.Invalidate("a.js.gz");
+        CHECK_FALSE(cache.Find("a.js"sv));
+        CHECK(cache.Find("b.js"sv));
+    }
+
+    SECTION("files read before an invalidation are not cached") {
+        auto ticket = cache.BeginRead();
+        cache.Invalidate("d.js");
+        // Следующий сброс забывает лишь файлы, которые не застало ни одно
+        // чтение
+        cache.Invalidate("e.js");
+        cache.Insert("d.js"s, MakeFileSet("d.js", 10), ticket);
+        CHECK_FALSE(cache.Find("d.js"sv));
+
+        ticket = {};
+        cache.Invalidate("f.js");
+        cache.Insert("d.js"s, MakeFileSet("d.js", 10), cache.BeginRead());
+        CHECK(cache.Find("d.js"sv));
+    }
+}
@@ -0,0 +1,259 @@
+#include "test_server.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace test_server {
+
+using namespace std::literals;
+
+namespace {
+
+// Свободный порт на 127.0.0.1
+unsigned short FindFreePort() {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    socklen_t length = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &length);
+    ::close(fd);
+    return ntohs(addr.sin_port);
+}
+
+model::Game &MakeGame(model::Game &game) {
+    model::Map map{model::Map::Id{"map1"}, "Map 1"};
+    map.AddRoad({model::Road::HORIZONTAL, {0, 0}, 40});
+    map.AddRoad({model::Road::VERTICAL, {40, 0}, 30});
+    map.Compile();
+    game.AddMap(std::move(map));
+    return game;
+}
+
+} // namespace
+
+StaticDirectory::StaticDirectory()
+    : path_(fs::temp_directory_path() /
+            ("game_server_test_" + std::to_string(::getpid()))) {
+    fs::create_directories(path_);
+    std::ofstream{path_ / "index.html"} << "<html>Hello</html>";
+}
+
+StaticDirectory::~StaticDirectory() {
+    std::error_code ec;
+    fs::remove_all(path_, ec);
+}
+
+void StaticDirectory::AddFile(std::string_view name, std::size_t size) const {
+    std::ofstream file{path_ / name, std::ios::binary};
+    const std::string chunk(1024 * 1024, 'x');
+    for (; size > chunk.size(); size -= chunk.size()) {
+        file << chunk;
+    }
+    file.write(chunk.data(), static_cast<std::streamsize>(size));
+}
+
+Client::Client(unsigned short port)
+    : fd_(::socket(AF_INET, SOCK_STREAM, 0)) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        if (::connect(fd_, reinterpret_cast<sockaddr *>(&addr),
+                      sizeof(addr)) == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    const int one = 1;
+    ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+Client::~Client() { ::close(fd_); }
+
+unsigned Client::Get(std::string_view target) {
+    char request[256];
+    const int length = std::snprintf(
+        request, sizeof(request), "GET %.*s HTTP/1.1\r\nHost: test\r\n\r\n",
+        static_cast<int>(target.size()), target.data());
+    if (::send(fd_, request, length, MSG_NOSIGNAL) != length) {
+        return 0;
+    }
+
+    std::size_t received = 0;
+    std::size_t header_end = std::string_view::npos;
+    while (header_end == std::string_view::npos) {
+        const auto n =
+            ::recv(fd_, buffer_ + received, sizeof(buffer_) - received, 0);
+        if (n <= 0) {
+            return 0;
+        }
+        received += n;
+        header_end = std::string_view{buffer_, received}.find("\r\n\r\n");
+    }
+    const std::string_view header{buffer_, header_end};
+
+    unsigned code = 0;
+    std::from_chars(header.data() + "HTTP/1.1 "sv.size(),
+                    header.data() + header.size(), code);
+
+    std::size_t content_length = 0;
+    if (const auto pos = header.find("Content-Length: "sv);
+        pos != std::string_view::npos) {
+        std::from_chars(header.data() + pos + "Content-Length: "sv.size(),
+                        header.data() + header.size(), content_length);
+    }
+
+    // Оставшаяся часть тела читается поверх уже разобранного ответа
+    std::size_t body_received = received - header_end - 4;
+    while (body_received < content_length) {
+        const auto n = ::recv(fd_, buffer_, sizeof(buffer_), 0);
+        if (n <= 0) {
+            return 0;
+        }
+        body_received += n;
+    }
+    return code;
+}
+
+TestServer::TestServer(const fs::path &static_root, const Options &options)
+    : sampler_({.default_rate = options.log_rate,
+                .slow_threshold = 10s,
+                .aggregate_interval = 3600s}),
+      handler_({.game = MakeGame(game_),
+                .static_content_directory_path = static_root.string(),
+                .static_cache_size = options.static_cache_size,
+                .sendfile_threshold = options.sendfile_threshold,
+                .log_sampler = sampler_,
+                .admin_token = {},
+                .file_io = options.file_io,
+                .blocking_io = {},
+                .retry_after = 1s}),
+      logging_handler_(handler_, sampler_), port_(FindFreePort()) {
+    const unsigned threads = std::max(options.threads, 1u);
+    if (options.reuse_port) {
+        for (unsigned i = 0; i < threads; ++i) {
+            contexts_.push_back(std::make_unique<net::io_context>(1));
+        }
+    } else {
+        contexts_.push_back(std::make_unique<net::io_context>(threads));
+    }
+
+    for (auto &ioc : contexts_) {
+        http_server::ServeHttp(
+            *ioc, {net::ip::address_v4::loopback(), port_},
+            [this](auto &&endpoint, auto &&req, auto &&sender) {
+                logging_handler_(std::forward<decltype(endpoint)>(endpoint),
+                                 std::forward<decltype(req)>(req),
+                                 std::forward<decltype(sender)>(sender));
+            },
+            {.reuse_port = options.reuse_port,
+             .admission = {},
+             .engine = options.engine});
+    }
+
+    for (unsigned i = 0; i < threads; ++i) {
+        threads_.emplace_back(
+            [&ioc = *contexts_[i % contexts_.size()]] { ioc.run(); });
+    }
+}
+
+TestServer::~TestServer() {
+    for (auto &ioc : contexts_) {
+        ioc->stop();
+    }
+    threads_.clear();
+}
+
+std::chrono::nanoseconds TestServer::GetCpuTime() {
+    std::chrono::nanoseconds total{0};
+    for (auto &thread : threads_) {
+        clockid_t clock;
+        timespec time{};
+        if (::pthread_getcpuclockid(thread.native_handle(), &clock) == 0 &&
+            ::clock_gettime(clock, &time) == 0) {
+            total += std::chrono::seconds{time.tv_sec} +
+                     std::chrono::nanoseconds{time.tv_nsec};
+        }
+    }
+    return total;
+}
+
+LoadResult RunLoad(unsigned short port, std::string_view target,
+                   unsigned clients, std::chrono::milliseconds duration,
+                   double rate) {
+    using Clock = std::chrono::steady_clock;
+
+    // Промежуток между запросами одного клиента
+    const auto interval =
+        rate > 0 ? std::chrono::duration_cast<Clock::duration>(
+                       std::chrono::duration<double>(clients / rate))
+                 : Clock::duration::zero();
+
+    struct ClientResult {
+        std::vector<std::chrono::nanoseconds> latencies;
+        std::size_t failures = 0;
+    };
+    std::vector<ClientResult> results(clients);
+
+    const auto start = Clock::now();
+    const auto deadline = start + duration;
+    {
+        std::vector<std::jthread> threads;
+        for (auto &result : results) {
+            threads.emplace_back([&result, port, target, deadline,
+                                  interval] {
+                Client client{port};
+                result.latencies.reserve(1024 * 1024);
+                for (auto next = Clock::now(); next < deadline;
+                     next += interval) {
+                    std::this_thread::sleep_until(next);
+                    const auto sent = Clock::now();
+                    if (client.Get(target) != 200) {
+                        ++result.failures;
+                        return;
+                    }
+                    const auto finished = Clock::now();
+                    result.latencies.push_back(finished - sent);
+                    // Отставшему от расписания клиенту не нужно догонять его
+                    // серией запросов подряд
+                    next = std::max(next, finished - interval);
+                }
+            });
+        }
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    std::vector<std::chrono::nanoseconds> latencies;
+    LoadResult load;
+    for (const auto &result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(),
+                         result.latencies.end());
+        load.failures += result.failures;
+    }
+    if (latencies.empty()) {
+        return load;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    load.requests = latencies.size();
+    load.requests_per_second = latencies.size() / elapsed.count();
+    load.p50 = latencies[latencies.size() / 2];
+    load.p99 = latencies[latencies.size() * 99 / 100];
+    return load;
+}
+
+} // namespace test_server
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "http_server.hpp"
+#include "log_sampling.hpp"
+#include "model.hpp"
+#include "request_handler.hpp"
+
+// Сервер, запущенный внутри процесса тестов, и клиент к нему
+
+namespace test_server {
+
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+
+// Временный каталог статики с файлом index.html. Удаляется вместе с
+// объектом
+class StaticDirectory {
+  public:
+    StaticDirectory();
+    ~StaticDirectory();
+
+    StaticDirectory(const StaticDirectory &) = delete;
+    StaticDirectory &operator=(const StaticDirectory &) = delete;
+
+    // Создаёт файл name размером size байт
+    void AddFile(std::string_view name, std::size_t size) const;
+
+    const fs::path &GetPath() const noexcept { return path_; }
+
+  private:
+    fs::path path_;
+};
+
+// Keep-alive клиент на блокирующем сокете. Не выделяет память, чтобы
+// счётчик выделений учитывал только выделения сервера
+class Client {
+  public:
+    explicit Client(unsigned short port);
+    ~Client();
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    // Отправляет GET-запрос и читает ответ целиком. Возвращает код ответа
+    // или 0 при ошибке
+    unsigned Get(std::string_view target);
+
+  private:
+    int fd_;
+    char buffer_[64 * 1024];
+};
+
+// Сервер на 127.0.0.1, собранный так же, как в main. Обслуживается
+// собственными потоками
+class TestServer {
+  public:
+    struct Options {
+        http_server::SessionEngine engine =
+            http_server::SessionEngine::CALLBACKS;
+        std::size_t static_cache_size = 1024 * 1024;
+        std::uintmax_t sendfile_threshold = 16 * 1024;
+        http_handler::FileIo file_io = http_handler::FileIo::SYNC;
+        // Число потоков. В режиме reuse_port у каждого потока свой
+        // io_context и свой acceptor
+        unsigned threads = 1;
+        bool reuse_port = false;
+        // Логировать каждый log_rate-й запрос
+        unsigned log_rate = 1'000'000;
+    };
+
+    TestServer(const fs::path &static_root, const Options &options);
+    ~TestServer();
+
+    TestServer(const TestServer &) = delete;
+    TestServer &operator=(const TestServer &) = delete;
+
+    unsigned short GetPort() const noexcept { return port_; }
+
+    // Процессорное время, потраченное потоками сервера с его запуска
+    std::chrono::nanoseconds GetCpuTime();
+
+  private:
+    model::Game game_;
+    http_handler::LogSampler sampler_;
+    http_handler::RequestHandler handler_;
+    http_handler::LoggingRequestHandler logging_handler_;
+    std::vector<std::unique_ptr<net::io_context>> contexts_;
+    unsigned short port_;
+    std::vector<std::jthread> threads_;
+};
+
+// Результат нагрузки, которую несколько клиентов создают одновременно
+struct LoadResult {
+    std::size_t requests = 0;
+    std::size_t failures = 0;
+    double requests_per_second = 0;
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p99{0};
+};
+
+// В течение duration clients клиентов запрашивают target: каждый следующий
+// запрос отправляется сразу после получения ответа на предыдущий. Если
+// задан rate, клиенты вместе отправляют не больше rate запросов в секунду
+LoadResult RunLoad(unsigned short port, std::string_view target,
+                   unsigned clients, std::chrono::milliseconds duration,
+                   double rate = 0);
+
+} // namespace test_server
@@ -1,5 +1,7 @@
 #include "collision_detector.h"
 #include <cassert>
+#include <cmath>
+#include <tuple>
 
 namespace collision_detector {
 
@@ -22,11 +24,166 @@ CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D
     return CollectionResult(sq_distance, proj_ratio);
 }
 
-// В задании на разработку тестов реализовывать следующую функцию не нужно -
-// она будет линковаться извне.
-/*
+namespace {
+
+// Равномерная сетка по положениям предметов. Размер ячейки выбирается так,
+// чтобы в ячейке было в среднем не больше одного предмета, но не меньше
+// радиуса сбора: тогда собиратель проверяет лишь предметы из ячеек,
+// которые задевает его путь, а не все предметы карты
+class ItemGrid {
+public:
+    ItemGrid(const std::vector<Item>& items, double min_cell_size) {
+        min_x_ = max_x_ = items.front().position.x;
+        min_y_ = max_y_ = items.front().position.y;
+        for (const auto& item : items) {
+            min_x_ = std::min(min_x_, item.position.x);
+            max_x_ = std::max(max_x_, item.position.x);
+            min_y_ = std::min(min_y_, item.position.y);
+            max_y_ = std::max(max_y_, item.position.y);
+        }
+
+        // Второй вариант размера ограничивает число ячеек, когда предметы лежат
+        // на одной прямой и площадь равна нулю
+        const double count = static_cast<double>(items.size());
+        const double width = max_x_ - min_x_;
+        const double height = max_y_ - min_y_;
+        cell_size_ = std::max({std::sqrt(width * height / count),
+                               std::max(width, height) / count, min_cell_size});
+        if (!(cell_size_ > 0)) {
+            cell_size_ = 1;
+        }
+        columns_ = static_cast<size_t>(width / cell_size_) + 1;
+        rows_ = static_cast<size_t>(height / cell_size_) + 1;
+
+        // Предметы раскладываются по ячейкам подсчётом: сначала размеры
+        // ячеек, затем начало каждой ячейки в item_ids_
+        std::vector<size_t> cells(items.size());
+        cell_offsets_.assign(columns_ * rows_ + 1, 0);
+        for (size_t i = 0; i < items.size(); ++i) {
+            cells[i] = Column(items[i].position.x) + Row(items[i].position.y) * columns_;
+            ++cell_offsets_[cells[i] + 1];
+        }
+        for (size_t i = 1; i < cell_offsets_.size(); ++i) {
+            cell_offsets_[i] += cell_offsets_[i - 1];
+        }
+        item_ids_.resize(items.size());
+        std::vector<size_t> filled(cell_offsets_.begin(), cell_offsets_.end() - 1);
+        for (size_t i = 0; i < items.size(); ++i) {
+            item_ids_[filled[cells[i]]++] = i;
+        }
+    }
+
+    // Вызывает fn(item_id) для предметов из ячеек, пересекающих прямоугольник
+    template <typename Fn>
+    void ForEachCandidate(double min_x, double min_y, double max_x, double max_y,
+                          Fn&& fn) const {
+        if (max_x < min_x_ || min_x > max_x_ || max_y < min_y_ || min_y > max_y_) {
+            return;
+        }
+        const size_t first_column = Column(min_x);
+        const size_t last_column = Column(max_x);
+        for (size_t row = Row(min_y), last_row = Row(max_y); row <= last_row; ++row) {
+            // Ячейки одной строки занимают в item_ids_ непрерывный диапазон
+            const size_t begin = cell_offsets_[row * columns_ + first_column];
+            const size_t end = cell_offsets_[row * columns_ + last_column + 1];
+            for (size_t i = begin; i < end; ++i) {
+                fn(item_ids_[i]);
+            }
+        }
+    }
+
+private:
+    size_t Column(double x) const noexcept {
+        return ToCell(x - min_x_, columns_);
+    }
+
+    size_t Row(double y) const noexcept {
+        return ToCell(y - min_y_, rows_);
+    }
+
+    size_t ToCell(double offset, size_t count) const noexcept {
+        if (!(offset > 0)) {
+            return 0;
+        }
+        return std::min(static_cast<size_t>(offset / cell_size_), count - 1);
+    }
+
+    double min_x_ = 0;
+    double max_x_ = 0;
+    double min_y_ = 0;
+    double max_y_ = 0;
+    double cell_size_ = 1;
+    size_t columns_ = 1;
+    size_t rows_ = 1;
+    // Предметы ячейки i - item_ids_[cell_offsets_[i]..cell_offsets_[i + 1])
+    std::vector<size_t> cell_offsets_;
+    std::vector<size_t> item_ids_;
+};
+
+}  // namespace
+
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
+    std::vector<GatheringEvent> events;
+
+    std::vector<Item> items;
+    items.reserve(provider.ItemsCount());
+    double max_item_width = 0;
+    for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+        items.push_back(provider.GetItem(i));
+        max_item_width = std::max(max_item_width, items.back().width);
+    }
+
+    std::vector<Gatherer> gatherers;
+    gatherers.reserve(provider.GatherersCount());
+    double max_gatherer_width = 0;
+    for (size_t i = 0; i < provider.GatherersCount(); ++i) {
+        gatherers.push_back(provider.GetGatherer(i));
+        max_gatherer_width = std::max(max_gatherer_width, gatherers.back().width);
+    }
+
+    if (items.empty() || gatherers.empty()) {
+        return events;
+    }
+
+    const ItemGrid grid{items, max_gatherer_width + max_item_width};
+
+    for (size_t g = 0; g < gatherers.size(); ++g) {
+        const auto& gatherer = gatherers[g];
+        const auto start = gatherer.start_pos;
+        const auto end = gatherer.end_pos;
+        if (start.x == end.x && start.y == end.y) {
+            continue;
+        }
+
+        // Запас на погрешность TryCollectPoint: квадрат расстояния
+        // вычисляется с ошибкой порядка 1e-16 от квадрата длины пути, и
+        // отбор по сетке не должен отбросить предмет, который при такой
+        // ошибке был бы подобран
+        const double radius = gatherer.width + max_item_width;
+        const double length = std::hypot(end.x - start.x, end.y - start.y);
+        const double reach = std::sqrt(radius * radius
+                                       + 1e-12 * (length + radius) * (length + radius));
+
+        grid.ForEachCandidate(
+            std::min(start.x, end.x) - reach, std::min(start.y, end.y) - reach,
+            std::max(start.x, end.x) + reach, std::max(start.y, end.y) + reach,
+            [&](size_t i) {
+                const auto& item = items[i];
+                const auto result = TryCollectPoint(start, end, item.position);
+                if (result.IsCollected(gatherer.width + item.width)) {
+                    events.push_back({i, g, result.sq_distance, result.proj_ratio});
+                }
+            });
+    }
+
+    // Одновременные события упорядочены по собирателю, затем по предмету, как
+    // при переборе всех пар с устойчивой сортировкой по времени
+    std::sort(events.begin(), events.end(), [](const auto& lhs, const auto& rhs) {
+        return std::tie(lhs.time, lhs.gatherer_id, lhs.item_id)
+             < std::tie(rhs.time, rhs.gatherer_id, rhs.item_id);
+    });
+
+    return events;
 }
-*/
 
 }  // namespace collision_detector
\ No newline at end of file
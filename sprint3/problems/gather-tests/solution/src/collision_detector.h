@@ -52,8 +52,12 @@ struct GatheringEvent {
     double time;
 };
 
-// Эту функцию вам нужно будет реализовать в соответствующем задании.
-// При проверке ваших тестов она не нужна - функция будет линковаться снаружи.
+// Находит все подборы предметов собирателями за такт, упорядоченные по времени.
+// Одновременные события упорядочены по gatherer_id, затем по item_id.
+// Предметы раскладываются по равномерной сетке, и каждый собиратель
+// проверяется только с предметами из ячеек, которые задевает его путь.
+// Результат совпадает с проверкой всех пар через TryCollectPoint.
+// Собиратели, не сдвинувшиеся за такт, ничего не подбирают
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
 
 }  // namespace collision_detector
\ No newline at end of file
@@ -1,5 +1,214 @@
 #define _USE_MATH_DEFINES
 
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
 #include "../src/collision_detector.h"
 
-// Напишите здесь тесты для функции collision_detector::FindGatherEvents
\ No newline at end of file
+using namespace collision_detector;
+
+namespace collision_detector {
+
+// События сравниваются точно: оба способа вызывают TryCollectPoint с одними и
+// теми же аргументами
+bool operator==(const GatheringEvent& lhs, const GatheringEvent& rhs) {
+    return lhs.item_id == rhs.item_id && lhs.gatherer_id == rhs.gatherer_id
+        && lhs.sq_distance == rhs.sq_distance && lhs.time == rhs.time;
+}
+
+}  // namespace collision_detector
+
+namespace {
+
+class Provider : public ItemGathererProvider {
+public:
+    Provider(std::vector<Item> items, std::vector<Gatherer> gatherers)
+        : items_(std::move(items))
+        , gatherers_(std::move(gatherers)) {
+    }
+
+    size_t ItemsCount() const override {
+        return items_.size();
+    }
+
+    Item GetItem(size_t idx) const override {
+        return items_.at(idx);
+    }
+
+    size_t GatherersCount() const override {
+        return gatherers_.size();
+    }
+
+    Gatherer GetGatherer(size_t idx) const override {
+        return gatherers_.at(idx);
+    }
+
+private:
+    std::vector<Item> items_;
+    std::vector<Gatherer> gatherers_;
+};
+
+// Проверка всех пар собиратель-предмет
+std::vector<GatheringEvent> FindGatherEventsBruteForce(const ItemGathererProvider& provider) {
+    std::vector<GatheringEvent> events;
+    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
+        const auto gatherer = provider.GetGatherer(g);
+        if (gatherer.start_pos.x == gatherer.end_pos.x
+            && gatherer.start_pos.y == gatherer.end_pos.y) {
+            continue;
+        }
+        for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+            const auto item = provider.GetItem(i);
+            const auto result
+                = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+            if (result.IsCollected(gatherer.width + item.width)) {
+                events.push_back({i, g, result.sq_distance, result.proj_ratio});
+            }
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.time < rhs.time;
+    });
+    return events;
+}
+
+// Собиратели движутся по осям, как собаки по дорогам, на расстояние до max_step
+Provider MakeRandomProvider(std::mt19937& random, size_t item_count, size_t gatherer_count,
+                            double map_size, double max_step) {
+    std::uniform_real_distribution<double> coord{0, map_size};
+    std::uniform_real_distribution<double> step{-max_step, max_step};
+    std::uniform_real_distribution<double> width{0, 0.6};
+    std::bernoulli_distribution horizontal{0.5};
+
+    std::vector<Item> items;
+    for (size_t i = 0; i < item_count; ++i) {
+        items.push_back({{coord(random), coord(random)}, width(random)});
+    }
+    std::vector<Gatherer> gatherers;
+    for (size_t i = 0; i < gatherer_count; ++i) {
+        const geom::Point2D start{coord(random), coord(random)};
+        auto end = start;
+        (horizontal(random) ? end.x : end.y) += step(random);
+        gatherers.push_back({start, end, width(random)});
+    }
+    return {std::move(items), std::move(gatherers)};
+}
+
+}  // namespace
+
+TEST_CASE("FindGatherEvents without items or gatherers") {
+    CHECK(FindGatherEvents(Provider{{}, {}}).empty());
+    CHECK(FindGatherEvents(Provider{{{{1, 0}, 1}}, {}}).empty());
+    CHECK(FindGatherEvents(Provider{{}, {{{0, 0}, {5, 0}, 1}}}).empty());
+}
+
+TEST_CASE("FindGatherEvents collects items along the path") {
+    const Provider provider{
+        {
+            {{3, 0.5}, 0.1},   // Сбоку от пути на расстоянии 0.5
+            {{1, 0}, 0.},      // На пути
+            {{-1, 0}, 0.},     // Позади начала пути
+            {{6, 0}, 0.},      // За концом пути
+            {{5, 0}, 0.},      // В конце пути
+            {{2, 1}, 0.},      // Дальше радиуса сбора
+        },
+        {{{0, 0}, {5, 0}, 0.4}},
+    };
+
+    const auto events = FindGatherEvents(provider);
+
+    REQUIRE(events.size() == 3);
+    CHECK(events[0].item_id == 1);
+    CHECK(events[0].time == 0.2);
+    CHECK(events[1].item_id == 0);
+    CHECK(events[1].time == 0.6);
+    CHECK(events[2].item_id == 4);
+    CHECK(events[2].time == 1);
+    CHECK(events[2].sq_distance == 0);
+}
+
+TEST_CASE("FindGatherEvents ignores gatherers that did not move") {
+    const Provider provider{{{{0, 0}, 1}}, {{{0, 0}, {0, 0}, 1}, {{0, -1}, {0, 1}, 0}}};
+
+    const auto events = FindGatherEvents(provider);
+
+    REQUIRE(events.size() == 1);
+    CHECK(events[0].gatherer_id == 1);
+}
+
+TEST_CASE("FindGatherEvents orders simultaneous events by gatherer and item") {
+    const Provider provider{
+        {{{1, 1}, 0}, {{1, 0}, 0}, {{1, 1}, 0}},
+        {{{0, 1}, {2, 1}, 0}, {{0, 0}, {2, 0}, 0}},
+    };
+
+    const auto events = FindGatherEvents(provider);
+
+    REQUIRE(events.size() == 3);
+    CHECK(events[0].gatherer_id == 0);
+    CHECK(events[0].item_id == 0);
+    CHECK(events[1].gatherer_id == 0);
+    CHECK(events[1].item_id == 2);
+    CHECK(events[2].gatherer_id == 1);
+    CHECK(events[2].item_id == 1);
+}
+
+TEST_CASE("FindGatherEvents matches checking every pair") {
+    std::mt19937 random{42};
+
+    SECTION("random maps of different density") {
+        for (const double map_size : {5., 50., 500.}) {
+            for (int i = 0; i < 20; ++i) {
+                const auto provider = MakeRandomProvider(random, 300, 100, map_size, 10);
+                CHECK(FindGatherEvents(provider) == FindGatherEventsBruteForce(provider));
+            }
+        }
+    }
+
+    SECTION("items on a single line") {
+        std::vector<Item> items;
+        for (int i = 0; i < 100; ++i) {
+            items.push_back({{i * 0.25, 3}, 0.1});
+        }
+        const Provider provider{std::move(items),
+                                {{{2, 3}, {10, 3}, 0.3}, {{5, 0}, {5, 10}, 0.3}}};
+        CHECK(FindGatherEvents(provider) == FindGatherEventsBruteForce(provider));
+    }
+
+    SECTION("all items at one point") {
+        const Provider provider{std::vector<Item>(10, Item{{1, 1}, 0}),
+                                {{{0, 1}, {2, 1}, 0}, {{0, 0}, {0, 5}, 2}}};
+        CHECK(FindGatherEvents(provider) == FindGatherEventsBruteForce(provider));
+    }
+
+    SECTION("gatherers far from items and with diagonal paths") {
+        const Provider provider{{{{0, 0}, 1}, {{10, 10}, 1}, {{5, 5}, 0}},
+                                {{{100, 100}, {200, 200}, 1}, {{-3, -3}, {13, 13}, 0}}};
+        CHECK(FindGatherEvents(provider) == FindGatherEventsBruteForce(provider));
+    }
+}
+
+// Запускается явно: collision_detection_tests "[benchmark]"
+TEST_CASE("FindGatherEvents performance", "[.][benchmark]") {
+    constexpr size_t COUNT = 5'000;
+
+    std::mt19937 random{42};
+    // Карта размером 100 заполнена густо, 10'000 - редко
+    for (const double map_size : {100., 1'000., 10'000.}) {
+        const auto provider = MakeRandomProvider(random, COUNT, COUNT, map_size, 3);
+        const auto name = std::to_string(COUNT) + " items and gatherers on map "
+                        + std::to_string(static_cast<int>(map_size));
+
+        BENCHMARK("Every pair: " + name) {
+            return FindGatherEventsBruteForce(provider).size();
+        };
+
+        BENCHMARK("Grid: " + name) {
+            return FindGatherEvents(provider).size();
+        };
+    }
+}
\ No newline at end of file
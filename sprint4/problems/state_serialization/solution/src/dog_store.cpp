@@ -0,0 +1,154 @@
+#include "dog_store.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace model {
+
+DogStore::Handle DogStore::Add(const Dog& dog, RoadIndex road) {
+    std::uint32_t slot = 0;
+    if (free_slots_.empty()) {
+        slot = static_cast<std::uint32_t>(slots_.size());
+        slots_.emplace_back();
+    } else {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+
+    slots_[slot].index = static_cast<std::uint32_t>(positions_.size());
+    positions_.push_back(dog.GetPosition());
+    speeds_.push_back(dog.GetSpeed());
+    directions_.push_back(dog.GetDirection());
+    roads_.push_back(road);
+    slot_of_.push_back(slot);
+    cold_.PushBack({
+        .id = dog.GetId(),
+        .name = dog.GetName(),
+        .bag_capacity = dog.GetBagCapacity(),
+        .bag = dog.GetBagContent(),
+        .score = dog.GetScore(),
+    });
+
+    return {slot, slots_[slot].generation};
+}
+
+bool DogStore::Remove(Handle handle) {
+    if (!Contains(handle)) {
+        return false;
+    }
+
+    const auto index = slots_[handle.slot].index;
+    const auto last = positions_.size() - 1;
+    if (index != last) {
+        positions_[index] = positions_[last];
+        speeds_[index] = speeds_[last];
+        directions_[index] = directions_[last];
+        roads_[index] = roads_[last];
+        slot_of_[index] = slot_of_[last];
+        slots_[slot_of_[index]].index = index;
+    }
+    positions_.pop_back();
+    speeds_.pop_back();
+    directions_.pop_back();
+    roads_.pop_back();
+    slot_of_.pop_back();
+    cold_.RemoveBySwap(index);
+
+    ++slots_[handle.slot].generation;
+    free_slots_.push_back(handle.slot);
+    return true;
+}
+
+bool DogStore::Contains(Handle handle) const noexcept {
+    if (handle.slot >= slots_.size()) {
+        return false;
+    }
+    const auto& slot = slots_[handle.slot];
+    return slot.generation == handle.generation && slot.index < slot_of_.size()
+        && slot_of_[slot.index] == handle.slot;
+}
+
+DogStore::ColdData& DogStore::GetColdData(Handle handle) {
+    const auto index = IndexOf(handle);
+    return cold_.GetMutable(index);
+}
+
+Dog DogStore::ToDog(Handle handle) const {
+    const auto index = IndexOf(handle);
+    const auto& cold = cold_.Get(index);
+
+    Dog dog{cold.id, cold.name, positions_[index], cold.bag_capacity};
+    dog.SetSpeed(speeds_[index]);
+    dog.SetDirection(directions_[index]);
+    dog.AddScore(cold.score);
+    for (const auto& item : cold.bag) {
+        if (!dog.PutToBag(item)) {
+            throw std::runtime_error("Failed to put bag content");
+        }
+    }
+    return dog;
+}
+
+void DogStore::Move(std::chrono::milliseconds time_delta) noexcept {
+    const double seconds = std::chrono::duration<double>(time_delta).count();
+    const auto count = positions_.size();
+    for (size_t i = 0; i < count; ++i) {
+        positions_[i] += speeds_[i] * seconds;
+    }
+}
+
+size_t DogStore::IndexOf(Handle handle) const {
+    if (!Contains(handle)) {
+        throw std::out_of_range("Dog handle is not valid");
+    }
+    return slots_[handle.slot].index;
+}
+
+DogStore::ColdStorage& DogStore::ColdStorage::operator=(const ColdStorage& other) {
+    if (this == &other) {
+        return *this;
+    }
+    const auto& records = other.records_;
+    records_.resize(std::min(records_.size(), records.size()));
+    for (size_t i = 0; i < records_.size(); ++i) {
+        if (records_[i] != records[i]) {
+            records_[i] = records[i];
+        }
+    }
+    records_.insert(records_.end(), records.begin() + records_.size(), records.end());
+    owners_ = other.owners_;
+    epoch_ = NewEpoch();
+    other.epoch_ = NewEpoch();
+    return *this;
+}
+
+DogStore::ColdData& DogStore::ColdStorage::GetMutable(size_t index) {
+    const auto epoch = epoch_.load();
+    if (owners_[index] != epoch) {
+        records_[index] = std::make_shared<ColdData>(*records_[index]);
+        owners_[index] = epoch;
+    }
+    return *records_[index];
+}
+
+void DogStore::ColdStorage::PushBack(ColdData data) {
+    records_.push_back(std::make_shared<ColdData>(std::move(data)));
+    owners_.push_back(epoch_.load());
+}
+
+void DogStore::ColdStorage::RemoveBySwap(size_t index) {
+    const auto last = records_.size() - 1;
+    if (index != last) {
+        records_[index] = std::move(records_[last]);
+        owners_[index] = owners_[last];
+    }
+    records_.pop_back();
+    owners_.pop_back();
+}
+
+std::uint64_t DogStore::ColdStorage::NewEpoch() noexcept {
+    static std::atomic<std::uint64_t> next_epoch{1};
+    return next_epoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace model
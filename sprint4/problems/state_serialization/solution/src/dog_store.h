@@ -0,0 +1,212 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <compare>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "geom.h"
+#include "model.h"
+
+namespace model {
+
+// Собаки игровой сессии в виде структуры массивов. Поля, нужные для
+// перемещения (координаты, скорости, направления, дороги), лежат в отдельных
+// плотных массивах, поэтому обход всех собак за такт читает память подряд и
+// не затрагивает имена и рюкзаки. Редко используемые поля каждой собаки
+// хранятся отдельно и разделяются между копиями хранилища, пока одна из
+// копий их не изменит
+class DogStore {
+public:
+    // Ссылка на собаку, которая не меняется при добавлении и удалении других
+    // собак. После удаления собаки её описатель становится недействительным
+    struct Handle {
+        std::uint32_t slot = 0;
+        std::uint32_t generation = 0;
+
+        auto operator<=>(const Handle&) const = default;
+    };
+
+    using RoadIndex = std::uint32_t;
+    static constexpr RoadIndex NO_ROAD = std::numeric_limits<RoadIndex>::max();
+
+    struct ColdData {
+        Dog::Id id{0u};
+        std::string name;
+        size_t bag_capacity = 0;
+        Dog::BagContent bag;
+        Score score = 0;
+    };
+
+    Handle Add(const Dog& dog, RoadIndex road = NO_ROAD);
+
+    // Удаляет собаку, перемещая на её место последнюю. Возвращает false, если
+    // описатель недействителен
+    bool Remove(Handle handle);
+
+    bool Contains(Handle handle) const noexcept;
+
+    size_t Size() const noexcept {
+        return positions_.size();
+    }
+
+    bool IsEmpty() const noexcept {
+        return positions_.empty();
+    }
+
+    // Обращение по недействительному описателю выбрасывает std::out_of_range
+
+    const geom::Point2D& GetPosition(Handle handle) const {
+        return positions_[IndexOf(handle)];
+    }
+
+    void SetPosition(Handle handle, geom::Point2D position) {
+        positions_[IndexOf(handle)] = position;
+    }
+
+    const geom::Vec2D& GetSpeed(Handle handle) const {
+        return speeds_[IndexOf(handle)];
+    }
+
+    void SetSpeed(Handle handle, geom::Vec2D speed) {
+        speeds_[IndexOf(handle)] = speed;
+    }
+
+    Direction GetDirection(Handle handle) const {
+        return directions_[IndexOf(handle)];
+    }
+
+    void SetDirection(Handle handle, Direction direction) {
+        directions_[IndexOf(handle)] = direction;
+    }
+
+    RoadIndex GetRoad(Handle handle) const {
+        return roads_[IndexOf(handle)];
+    }
+
+    void SetRoad(Handle handle, RoadIndex road) {
+        roads_[IndexOf(handle)] = road;
+    }
+
+    const ColdData& GetColdData(Handle handle) const {
+        return cold_.Get(IndexOf(handle));
+    }
+
+    // Если редкие поля собаки разделяются с другой копией хранилища,
+    // сначала копирует их
+    ColdData& GetColdData(Handle handle);
+
+    // Собирает собаку из полей хранилища, например для сериализации
+    Dog ToDog(Handle handle) const;
+
+    // Плотные массивы для обхода всех собак. Порядок собак меняется при
+    // удалении, поэтому запоминать индексы нельзя: для этого есть описатели
+    std::span<const geom::Point2D> GetPositions() const noexcept {
+        return positions_;
+    }
+
+    std::span<const geom::Vec2D> GetSpeeds() const noexcept {
+        return speeds_;
+    }
+
+    std::span<const Direction> GetDirections() const noexcept {
+        return directions_;
+    }
+
+    std::span<const RoadIndex> GetRoads() const noexcept {
+        return roads_;
+    }
+
+    Handle GetHandle(size_t index) const {
+        const auto slot = slot_of_.at(index);
+        return {slot, slots_[slot].generation};
+    }
+
+    // Перемещает всех собак в соответствии с их скоростями (единиц в секунду)
+    void Move(std::chrono::milliseconds time_delta) noexcept;
+
+private:
+    struct Slot {
+        // Индекс собаки в плотных массивах
+        std::uint32_t index = 0;
+        // Увеличивается при удалении собаки, делая её описатели
+        // недействительными
+        std::uint32_t generation = 0;
+    };
+
+    // Редкие поля собак. Каждая запись разделяется между копиями хранилища,
+    // пока одна из копий не изменит именно её, поэтому копирование
+    // хранилища и последующее изменение одной собаки не копируют имена и
+    // рюкзаки остальных. Запись принадлежит копии, если её метка совпадает
+    // с эпохой копии. Копирование выдаёт новые эпохи обеим сторонам, и все
+    // записи становятся общими. Число владельцев shared_ptr для этого не
+    // подходит: оно читается без синхронизации с потоком, освободившим свою
+    // копию
+    class ColdStorage {
+    public:
+        ColdStorage() = default;
+
+        ColdStorage(const ColdStorage& other)
+            : records_{other.records_}
+            , owners_{other.owners_} {
+            other.epoch_ = NewEpoch();
+        }
+
+        ColdStorage(ColdStorage&& other) noexcept
+            : records_{std::move(other.records_)}
+            , owners_{std::move(other.owners_)}
+            , epoch_{other.epoch_.load()} {
+        }
+
+        // Записи, уже общие с other, не переприсваиваются, чтобы не менять
+        // счётчики владельцев shared_ptr без необходимости
+        ColdStorage& operator=(const ColdStorage& other);
+
+        ColdStorage& operator=(ColdStorage&& other) noexcept {
+            records_ = std::move(other.records_);
+            owners_ = std::move(other.owners_);
+            epoch_ = other.epoch_.load();
+            return *this;
+        }
+
+        const ColdData& Get(size_t index) const {
+            return *records_[index];
+        }
+
+        // Если запись разделяется с другой копией, сначала копирует её
+        ColdData& GetMutable(size_t index);
+
+        void PushBack(ColdData data);
+        // Перемещает последнюю запись на место index и удаляет последнюю
+        void RemoveBySwap(size_t index);
+
+    private:
+        static std::uint64_t NewEpoch() noexcept;
+
+        std::vector<std::shared_ptr<ColdData>> records_;
+        // Эпоха хранилища, которому принадлежит каждая запись
+        std::vector<std::uint64_t> owners_;
+        // Атомарная, так как копии опубликованного хранилища могут
+        // создаваться в нескольких потоках одновременно
+        mutable std::atomic<std::uint64_t> epoch_{NewEpoch()};
+    };
+
+    size_t IndexOf(Handle handle) const;
+
+    std::vector<geom::Point2D> positions_;
+    std::vector<geom::Vec2D> speeds_;
+    std::vector<Direction> directions_;
+    std::vector<RoadIndex> roads_;
+    // Слот каждой собаки в плотных массивах
+    std::vector<std::uint32_t> slot_of_;
+    ColdStorage cold_;
+
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> free_slots_;
+};
+
+}  // namespace model
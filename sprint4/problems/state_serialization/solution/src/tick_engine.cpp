@@ -0,0 +1,251 @@
+#include "tick_engine.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace model {
+
+using namespace std::literals;
+
+void MoveDogs(MapState& state, std::chrono::milliseconds time_delta) {
+    state.dogs.Move(time_delta);
+}
+
+const MapState* WorldSnapshot::FindMap(std::string_view map_id) const noexcept {
+    for (const auto& map : maps) {
+        if (map->map_id == map_id) {
+            return map.get();
+        }
+    }
+    return nullptr;
+}
+
+TickEngine::TickEngine(Settings settings, Step step)
+    : settings_(settings)
+    , step_(std::move(step))
+    , pool_(settings.threads)
+    , snapshot_(std::make_shared<const WorldSnapshot>()) {
+    if (settings_.max_step <= 0ms) {
+        throw std::invalid_argument("Tick step must be positive");
+    }
+}
+
+TickEngine::~TickEngine() {
+    Stop();
+}
+
+void TickEngine::AddMap(std::string map_id) {
+    std::lock_guard lock{maps_mutex_};
+    if (FindSlot(map_id)) {
+        throw std::invalid_argument("Map with id "s + map_id + " already exists"s);
+    }
+    auto state = std::make_shared<MapState>();
+    state->map_id = std::move(map_id);
+    maps_.push_back({std::move(state), {}, nullptr});
+}
+
+void TickEngine::Modify(std::string_view map_id, Modification modification) {
+    std::lock_guard lock{maps_mutex_};
+    auto* slot = FindSlot(map_id);
+    if (!slot) {
+        throw std::invalid_argument("Map with id "s + std::string{map_id} + " not found"s);
+    }
+    slot->modifications.push_back(std::move(modification));
+}
+
+void TickEngine::Tick(std::chrono::milliseconds time_delta) {
+    std::lock_guard tick_lock{tick_mutex_};
+    const auto start = std::chrono::steady_clock::now();
+
+    // Карты и накопленные изменения забираются под мьютексом, а
+    // продвигаются без него, чтобы не задерживать AddMap и Modify
+    std::vector<MapSlot> maps;
+    {
+        std::lock_guard lock{maps_mutex_};
+        maps.reserve(maps_.size());
+        for (auto& slot : maps_) {
+            maps.push_back({slot.state, std::exchange(slot.modifications, {}),
+                            std::exchange(slot.spare, nullptr)});
+        }
+    }
+
+    std::vector<MapResult> results(maps.size());
+    std::vector<util::WorkStealingPool::Task> tasks;
+    tasks.reserve(maps.size());
+    for (std::size_t i = 0; i < maps.size(); ++i) {
+        tasks.emplace_back([this, &map = maps[i], &result = results[i], time_delta] {
+            AdvanceMap(map, time_delta, result);
+        });
+    }
+    pool_.RunAll(std::move(tasks));
+
+    std::vector<std::shared_ptr<const MapState>> states;
+    states.reserve(maps.size());
+    std::uint64_t failed_maps = 0;
+    std::uint64_t dropped_modifications = 0;
+    std::string last_error;
+    {
+        std::lock_guard lock{maps_mutex_};
+        for (std::size_t i = 0; i < maps.size(); ++i) {
+            auto& result = results[i];
+            if (result.state) {
+                maps_[i].spare = std::exchange(maps_[i].state, result.state);
+                states.push_back(std::move(result.state));
+                continue;
+            }
+
+            states.push_back(maps[i].state);
+            ++failed_maps;
+            last_error = std::move(result.error);
+            auto& taken = maps[i].modifications;
+            if (!result.failed_modification) {
+                dropped_modifications += taken.size();
+                continue;
+            }
+            // Остальные изменения возвращаются перед поступившими за время
+            // такта и применяются к прежнему состоянию в следующем
+            taken.erase(taken.begin() + *result.failed_modification);
+            ++dropped_modifications;
+            auto& modifications = maps_[i].modifications;
+            modifications.insert(modifications.begin(), std::make_move_iterator(taken.begin()),
+                                 std::make_move_iterator(taken.end()));
+        }
+    }
+
+    const auto previous = snapshot_.load();
+    auto snapshot = std::make_shared<WorldSnapshot>();
+    snapshot->tick = previous->tick + 1;
+    snapshot->game_time = previous->game_time + time_delta;
+    snapshot->maps = std::move(states);
+    snapshot_.store(std::move(snapshot));
+
+    const auto duration = std::chrono::steady_clock::now() - start;
+    std::lock_guard lock{stats_mutex_};
+    ++stats_.ticks;
+    if (duration > settings_.period) {
+        ++stats_.overruns;
+    }
+    stats_.last_duration = duration;
+    stats_.max_duration = std::max(stats_.max_duration, stats_.last_duration);
+    stats_.total_duration += duration;
+    stats_.failed_maps += failed_maps;
+    stats_.dropped_modifications += dropped_modifications;
+    if (failed_maps != 0) {
+        stats_.last_error = std::move(last_error);
+    }
+}
+
+void TickEngine::Start() {
+    if (timer_.joinable()) {
+        return;
+    }
+    timer_ = std::jthread([this](std::stop_token stop_token) {
+        RunTimer(std::move(stop_token));
+    });
+}
+
+void TickEngine::Stop() {
+    if (timer_.joinable()) {
+        timer_.request_stop();
+        timer_.join();
+    }
+}
+
+TickStats TickEngine::GetStats() const {
+    std::lock_guard lock{stats_mutex_};
+    return stats_;
+}
+
+void TickEngine::AdvanceMap(MapSlot& map, std::chrono::milliseconds time_delta,
+                            MapResult& result) const {
+    try {
+        // Единственный владелец запасного буфера - этот такт, если его не
+        // держат ни снимки, ни их читатели. use_count читается без
+        // синхронизации, поэтому барьер упорядочивает чтение буфера после
+        // того, как читатель отпустил его последним
+        auto state = std::move(map.spare);
+        if (state && state.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            *state = *map.state;
+        } else {
+            state = std::make_shared<MapState>(*map.state);
+        }
+        for (std::size_t i = 0; i < map.modifications.size(); ++i) {
+            try {
+                map.modifications[i](*state);
+            } catch (...) {
+                result.failed_modification = i;
+                throw;
+            }
+        }
+        // Последний шаг может быть короче max_step
+        for (auto remaining = time_delta; remaining > 0ms; remaining -= settings_.max_step) {
+            step_(*state, std::min(remaining, settings_.max_step));
+        }
+        result.state = std::move(state);
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    } catch (...) {
+        result.error = "Unknown error"s;
+    }
+}
+
+void TickEngine::RecordTickFailure(std::string error) {
+    std::lock_guard lock{stats_mutex_};
+    ++stats_.failed_ticks;
+    stats_.last_error = std::move(error);
+}
+
+TickEngine::MapSlot* TickEngine::FindSlot(std::string_view map_id) noexcept {
+    for (auto& slot : maps_) {
+        if (slot.state->map_id == map_id) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void TickEngine::RunTimer(std::stop_token stop_token) {
+    using Clock = std::chrono::steady_clock;
+
+    auto last_tick = Clock::now();
+    auto next_tick = last_tick + settings_.period;
+    while (true) {
+        {
+            // Ожидание прерывается только остановкой
+            std::unique_lock lock{timer_mutex_};
+            timer_cv_.wait_until(lock, stop_token, next_tick, [] {
+                return false;
+            });
+        }
+        if (stop_token.stop_requested()) {
+            return;
+        }
+
+        // Остаток меньше миллисекунды переходит в следующий такт, поэтому
+        // игровое время не отстаёт от реального
+        const auto now = Clock::now();
+        const auto time_delta =
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - last_tick);
+        last_tick += time_delta;
+        try {
+            Tick(time_delta);
+        } catch (const std::exception& e) {
+            // Время неопубликованного такта не теряется: карты продвинутся
+            // на него в следующем
+            last_tick -= time_delta;
+            RecordTickFailure(e.what());
+        } catch (...) {
+            last_tick -= time_delta;
+            RecordTickFailure("Unknown error"s);
+        }
+
+        // После затянувшегося такта следующий начинается сразу, а не
+        // наверстывает пропущенные периоды по одному
+        next_tick = std::max(next_tick + settings_.period, Clock::now());
+    }
+}
+
+}  // namespace model
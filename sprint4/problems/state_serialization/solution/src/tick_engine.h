@@ -0,0 +1,177 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "dog_store.h"
+#include "model.h"
+#include "work_stealing_pool.h"
+
+namespace model {
+
+// Собаки всех игровых сессий на одной карте. Карты не влияют друг на друга,
+// поэтому продвигаются во времени независимо
+struct MapState {
+    std::string map_id;
+    DogStore dogs;
+};
+
+// Перемещает собак карты в соответствии с их скоростями (единиц в секунду)
+void MoveDogs(MapState& state, std::chrono::milliseconds time_delta);
+
+// Состояние всех карт после очередного такта. Публикуется целиком, поэтому
+// читатель никогда не видит карты из разных тактов. Исключение составляют
+// карты, продвижение которых в такте не удалось: они остаются в прежнем
+// состоянии
+struct WorldSnapshot {
+    std::uint64_t tick = 0;
+    // Игровое время, прошедшее с создания TickEngine
+    std::chrono::milliseconds game_time{0};
+    // В порядке добавления карт
+    std::vector<std::shared_ptr<const MapState>> maps;
+
+    // Возвращает nullptr, если карты нет
+    const MapState* FindMap(std::string_view map_id) const noexcept;
+};
+
+// Показатели тактов с момента создания TickEngine
+struct TickStats {
+    std::uint64_t ticks = 0;
+    // Такты, продлившиеся дольше периода
+    std::uint64_t overruns = 0;
+    std::chrono::nanoseconds last_duration{0};
+    std::chrono::nanoseconds max_duration{0};
+    std::chrono::nanoseconds total_duration{0};
+    // Продвижения карт, выбросившие исключение. Такая карта остаётся в
+    // состоянии предыдущего такта
+    std::uint64_t failed_maps = 0;
+    // Изменения, отброшенные из-за исключений
+    std::uint64_t dropped_modifications = 0;
+    // Такты потока Start, не опубликованные из-за исключения
+    std::uint64_t failed_ticks = 0;
+    // Сообщение последнего из перечисленных выше исключений
+    std::string last_error;
+};
+
+// Продвигает игровые карты во времени. Такт обрабатывает карты параллельно
+// в WorkStealingPool: каждая карта продвигается в собственной копии
+// состояния, и по окончании такта копии публикуются одним WorldSnapshot.
+// Копии чередуются между двумя буферами каждой карты, пока читатели не
+// удерживают старые снимки.
+// Такты выполняются либо вызовами Tick (например, из /api/v1/game/tick),
+// либо потоком, запущенным Start, с периодом Settings::period
+class TickEngine {
+public:
+    struct Settings {
+        // Период тактов, выполняемых после Start. Такты дольше периода
+        // учитываются в TickStats::overruns
+        std::chrono::milliseconds period{50};
+        // Большой интервал времени делится на шаги не длиннее этого, чтобы
+        // результат не зависел от того, как часто выполняются такты
+        std::chrono::milliseconds max_step{50};
+        // Потоки пула в дополнение к потоку, выполняющему такт
+        unsigned threads = 0;
+    };
+
+    // Изменение карты, выполняемое перед её продвижением в следующем такте
+    using Modification = std::function<void(MapState&)>;
+    // Продвигает карту на один шаг
+    using Step = std::function<void(MapState&, std::chrono::milliseconds)>;
+
+    explicit TickEngine(Settings settings, Step step = MoveDogs);
+    ~TickEngine();
+
+    TickEngine(const TickEngine&) = delete;
+    TickEngine& operator=(const TickEngine&) = delete;
+
+    // Добавляет карту без собак. Если карта уже есть, выбрасывает
+    // std::invalid_argument
+    void AddMap(std::string map_id);
+
+    // Применяет modification к карте в начале следующего такта: через него
+    // в игру добавляются собаки и меняются их скорости.
+    // Если карты нет, выбрасывает std::invalid_argument
+    void Modify(std::string_view map_id, Modification modification);
+
+    // Продвигает все карты на time_delta и публикует результат.
+    // Одновременные вызовы выполняются по очереди. Карты продвигаются
+    // независимо: карта, продвижение которой выбросило исключение, остаётся
+    // в прежнем состоянии, а остальные публикуются. Если исключение
+    // выбросило изменение, оно отбрасывается, а остальные изменения карты
+    // применяются в следующем такте. Если исключение выбросил шаг,
+    // отбрасываются все изменения карты, полученные к такту, иначе шаг
+    // повторял бы ошибку в каждом такте. Ошибки учитываются в TickStats
+    void Tick(std::chrono::milliseconds time_delta);
+
+    // Запускает поток, выполняющий такты с периодом Settings::period.
+    // Каждый такт продвигает карты на время, фактически прошедшее с
+    // предыдущего. Исключение такта учитывается в TickStats::failed_ticks,
+    // и поток продолжает выполнять такты по расписанию
+    void Start();
+    void Stop();
+
+    // Результат последнего такта
+    std::shared_ptr<const WorldSnapshot> GetSnapshot() const {
+        return snapshot_.load();
+    }
+
+    TickStats GetStats() const;
+
+private:
+    struct MapSlot {
+        // Опубликовано последним тактом
+        std::shared_ptr<MapState> state;
+        std::vector<Modification> modifications;
+        // Опубликованное тактом раньше. Когда его перестают читать, следующий
+        // такт копирует state в него, а не в новый объект: память массивов
+        // переиспользуется, а редкие поля собак, не изменившиеся за два
+        // такта, не копируются вовсе
+        std::shared_ptr<MapState> spare;
+    };
+
+    // Итог продвижения одной карты в такте
+    struct MapResult {
+        // nullptr, если продвижение выбросило исключение
+        std::shared_ptr<MapState> state;
+        // Индекс изменения, выбросившего исключение
+        std::optional<std::size_t> failed_modification;
+        std::string error;
+    };
+
+    MapSlot* FindSlot(std::string_view map_id) noexcept;
+    void AdvanceMap(MapSlot& map, std::chrono::milliseconds time_delta,
+                    MapResult& result) const;
+    void RecordTickFailure(std::string error);
+    void RunTimer(std::stop_token stop_token);
+
+    const Settings settings_;
+    const Step step_;
+    util::WorkStealingPool pool_;
+
+    // Защищает maps_
+    mutable std::mutex maps_mutex_;
+    std::vector<MapSlot> maps_;
+
+    // Такты выполняются по одному
+    std::mutex tick_mutex_;
+    std::atomic<std::shared_ptr<const WorldSnapshot>> snapshot_;
+
+    mutable std::mutex stats_mutex_;
+    TickStats stats_;
+
+    std::mutex timer_mutex_;
+    std::condition_variable_any timer_cv_;
+    std::jthread timer_;
+};
+
+}  // namespace model
@@ -0,0 +1,122 @@
+#include "work_stealing_pool.h"
+
+namespace util {
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    queues_.reserve(threads + 1);
+    for (unsigned i = 0; i <= threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+
+    threads_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i](std::stop_token stop_token) {
+            Work(std::move(stop_token), i);
+        });
+    }
+}
+
+void WorkStealingPool::RunAll(std::vector<Task> tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    std::lock_guard run_lock{run_mutex_};
+
+    {
+        // Счётчики задаются до того, как задачи попадут в очереди: поток,
+        // ещё не вышедший из TryRunOne после предыдущего пакета, может взять
+        // новую задачу сразу, и его уменьшение счётчиков не должно
+        // затереться
+        std::lock_guard lock{mutex_};
+        error_ = nullptr;
+        pending_ = tasks.size();
+        queued_ = tasks.size();
+
+        // Задачи раскладываются по очередям поровну, дальше потоки
+        // выравнивают нагрузку сами
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            auto& queue = *queues_[i % queues_.size()];
+            std::lock_guard queue_lock{queue.mutex};
+            queue.tasks.push_back(std::move(tasks[i]));
+        }
+    }
+    has_tasks_.notify_all();
+
+    while (TryRunOne(queues_.size() - 1)) {
+    }
+
+    std::exception_ptr error;
+    {
+        std::unique_lock lock{mutex_};
+        all_done_.wait(lock, [this] {
+            return pending_ == 0;
+        });
+        error = std::exchange(error_, nullptr);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool WorkStealingPool::TryRunOne(std::size_t home) {
+    Task task;
+
+    {
+        auto& queue = *queues_[home];
+        std::lock_guard lock{queue.mutex};
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+
+    for (std::size_t i = 1; !task && i < queues_.size(); ++i) {
+        auto& victim = *queues_[(home + i) % queues_.size()];
+        std::lock_guard lock{victim.mutex};
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+    --queued_;
+
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard lock{mutex_};
+        if (!error_) {
+            error_ = std::current_exception();
+        }
+    }
+
+    if (--pending_ == 0) {
+        // Под мьютексом, чтобы RunAll не пропустил уведомление между
+        // проверкой условия и началом ожидания
+        std::lock_guard lock{mutex_};
+        all_done_.notify_all();
+    }
+    return true;
+}
+
+void WorkStealingPool::Work(std::stop_token stop_token, std::size_t home) {
+    while (true) {
+        {
+            std::unique_lock lock{mutex_};
+            if (!has_tasks_.wait(lock, stop_token, [this] {
+                    return queued_ > 0;
+                })) {
+                return;
+            }
+        }
+
+        while (TryRunOne(home)) {
+        }
+    }
+}
+
+}  // namespace util
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+// Пул потоков для параллельного выполнения пакета независимых задач.
+// У каждого потока своя очередь: поток берёт задачи с её конца, а когда она
+// пуста, забирает задачи из начала чужих очередей. Так потоки, которым
+// достались короткие задачи, помогают тем, кому достались длинные
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // threads - число потоков пула. Поток, вызвавший RunAll, выполняет
+    // задачи вместе с ними, поэтому при threads == 0 все задачи выполняются
+    // в нём
+    explicit WorkStealingPool(unsigned threads);
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Выполняет задачи и возвращает управление, когда все они завершены.
+    // Если задачи выбросили исключения, после завершения остальных задач
+    // выбрасывает первое из них
+    void RunAll(std::vector<Task> tasks);
+
+    unsigned GetThreadCount() const noexcept {
+        return static_cast<unsigned>(threads_.size());
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Выполняет одну задачу из очереди home или из чужой очереди.
+    // Возвращает false, если задач не осталось
+    bool TryRunOne(std::size_t home);
+    void Work(std::stop_token stop_token, std::size_t home);
+
+    // Последняя очередь принадлежит потоку, вызвавшему RunAll
+    std::vector<std::unique_ptr<Queue>> queues_;
+    // Задачи, ещё не взятые из очередей
+    std::atomic<std::size_t> queued_{0};
+    // Задачи, ещё не завершённые
+    std::atomic<std::size_t> pending_{0};
+
+    // Пакеты задач выполняются по одному
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable_any has_tasks_;
+    std::condition_variable_any all_done_;
+    std::exception_ptr error_;
+
+    // Объявлены последними, чтобы потоки останавливались раньше, чем
+    // разрушаются очереди
+    std::vector<std::jthread> threads_;
+};
+
+}  // namespace util
@@ -0,0 +1,182 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#include "../src/dog_store.h"
+
+using namespace model;
+using namespace std::literals;
+
+namespace {
+
+Dog MakeDog(uint32_t id, geom::Point2D pos, geom::Vec2D speed) {
+    Dog dog{Dog::Id{id}, "Dog "s + std::to_string(id), pos, 3};
+    dog.SetSpeed(speed);
+    return dog;
+}
+
+}  // namespace
+
+SCENARIO("Dog store") {
+    GIVEN("a store with three dogs") {
+        DogStore store;
+        const auto first = store.Add(MakeDog(1, {0, 0}, {1, 0}), 7);
+        const auto second = store.Add(MakeDog(2, {1, 1}, {0, 1}));
+        const auto third = store.Add(MakeDog(3, {2, 2}, {-1, 0}));
+
+        THEN("dogs are accessible by their handles") {
+            CHECK(store.Size() == 3);
+            CHECK(store.GetPosition(second) == geom::Point2D{1, 1});
+            CHECK(store.GetSpeed(third) == geom::Vec2D{-1, 0});
+            CHECK(store.GetRoad(first) == 7);
+            CHECK(store.GetRoad(second) == DogStore::NO_ROAD);
+            CHECK(store.GetColdData(third).name == "Dog 3"s);
+        }
+
+        WHEN("dogs are moved") {
+            store.Move(500ms);
+
+            THEN("positions change according to speeds") {
+                CHECK(store.GetPosition(first) == geom::Point2D{0.5, 0});
+                CHECK(store.GetPosition(second) == geom::Point2D{1, 1.5});
+                CHECK(store.GetPosition(third) == geom::Point2D{1.5, 2});
+            }
+        }
+
+        WHEN("a dog is removed") {
+            REQUIRE(store.Remove(first));
+
+            THEN("the last dog takes its place and handles of others stay valid") {
+                CHECK(store.Size() == 2);
+                CHECK(store.GetPositions()[0] == geom::Point2D{2, 2});
+                CHECK(store.GetPosition(second) == geom::Point2D{1, 1});
+                CHECK(store.GetPosition(third) == geom::Point2D{2, 2});
+                CHECK(*store.GetColdData(third).id == 3u);
+                CHECK(store.GetHandle(0) == third);
+            }
+
+            THEN("its handle becomes invalid") {
+                CHECK_FALSE(store.Contains(first));
+                CHECK_FALSE(store.Remove(first));
+                CHECK_THROWS_AS(store.GetPosition(first), std::out_of_range);
+            }
+
+            AND_WHEN("another dog is added") {
+                const auto fourth = store.Add(MakeDog(4, {4, 4}, {}));
+
+                THEN("it does not get the removed dog's handle") {
+                    CHECK(fourth != first);
+                    CHECK_FALSE(store.Contains(first));
+                    CHECK(store.GetPosition(fourth) == geom::Point2D{4, 4});
+                }
+            }
+        }
+
+        WHEN("the original is changed after being copied") {
+            const auto copy = store;
+            store.GetColdData(second).name = "Renamed"s;
+
+            THEN("the copy is not affected") {
+                CHECK(copy.GetColdData(second).name == "Dog 2"s);
+                CHECK(store.GetColdData(second).name == "Renamed"s);
+            }
+
+            THEN("only the changed dog's cold data is copied") {
+                CHECK(&std::as_const(store).GetColdData(first) == &copy.GetColdData(first));
+                CHECK(&std::as_const(store).GetColdData(third) == &copy.GetColdData(third));
+            }
+
+            AND_WHEN("dogs are added and removed") {
+                store.Remove(first);
+                store.Add(MakeDog(4, {4, 4}, {}));
+
+                THEN("cold data of the other dogs stays shared") {
+                    CHECK(&std::as_const(store).GetColdData(third) == &copy.GetColdData(third));
+                    CHECK(copy.Size() == 3);
+                }
+            }
+        }
+
+        WHEN("the store is copied") {
+            auto copy = store;
+            copy.GetColdData(first).score = 10;
+            copy.SetPosition(first, {5, 5});
+
+            THEN("changes of the copy do not affect the original") {
+                CHECK(store.GetColdData(first).score == 0);
+                CHECK(store.GetPosition(first) == geom::Point2D{0, 0});
+                CHECK(copy.GetColdData(first).score == 10);
+            }
+
+            AND_WHEN("the original is changed after that") {
+                store.GetColdData(first).score = 20;
+
+                THEN("the copy keeps its own value") {
+                    CHECK(copy.GetColdData(first).score == 10);
+                    CHECK(store.GetColdData(first).score == 20);
+                }
+            }
+        }
+    }
+
+    GIVEN("a dog with a bag") {
+        auto dog = MakeDog(42, {42.2, 12.5}, {2.3, -1.2});
+        dog.AddScore(42);
+        CHECK(dog.PutToBag({FoundObject::Id{10}, 2u}));
+        dog.SetDirection(Direction::EAST);
+
+        WHEN("it is added to a store and restored") {
+            DogStore store;
+            const auto restored = store.ToDog(store.Add(dog));
+
+            THEN("all fields are preserved") {
+                CHECK(restored.GetId() == dog.GetId());
+                CHECK(restored.GetName() == dog.GetName());
+                CHECK(restored.GetPosition() == dog.GetPosition());
+                CHECK(restored.GetSpeed() == dog.GetSpeed());
+                CHECK(restored.GetDirection() == dog.GetDirection());
+                CHECK(restored.GetScore() == dog.GetScore());
+                CHECK(restored.GetBagCapacity() == dog.GetBagCapacity());
+                CHECK(restored.GetBagContent() == dog.GetBagContent());
+            }
+        }
+    }
+}
+
+// Запускается явно: game_server_tests "[benchmark]"
+TEST_CASE("Dog movement tick", "[.][benchmark]") {
+    constexpr uint32_t DOG_COUNT = 100'000;
+
+    std::mt19937 random{42};
+    std::uniform_real_distribution<double> coord{0, 100};
+    std::uniform_real_distribution<double> speed{-3, 3};
+
+    std::vector<DogPtr> dogs;
+    DogStore store;
+    for (uint32_t id = 0; id < DOG_COUNT; ++id) {
+        auto dog = MakeDog(id, {coord(random), coord(random)}, {speed(random), speed(random)});
+        store.Add(dog);
+        dogs.push_back(std::make_shared<Dog>(std::move(dog)));
+    }
+    // Собаки подключаются и отключаются в произвольном порядке, поэтому
+    // соседние указатели обычно ведут в разные места кучи
+    std::shuffle(dogs.begin(), dogs.end(), random);
+
+    constexpr double SECONDS = 0.05;
+
+    BENCHMARK("AoS: std::vector<DogPtr>") {
+        for (const auto& dog : dogs) {
+            dog->SetPosition(dog->GetPosition() + dog->GetSpeed() * SECONDS);
+        }
+        return dogs.front()->GetPosition().x;
+    };
+
+    BENCHMARK("SoA: DogStore") {
+        store.Move(50ms);
+        return store.GetPositions().front().x;
+    };
+}
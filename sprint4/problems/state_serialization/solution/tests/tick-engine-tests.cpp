@@ -0,0 +1,371 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "../src/tick_engine.h"
+#include "../src/work_stealing_pool.h"
+
+using namespace model;
+using namespace std::literals;
+
+namespace {
+
+Dog MakeDog(uint32_t id, geom::Point2D pos, geom::Vec2D speed) {
+    Dog dog{Dog::Id{id}, "Dog "s + std::to_string(id), pos, 3};
+    dog.SetSpeed(speed);
+    return dog;
+}
+
+// Шаги складываются в числах с плавающей точкой
+bool IsNear(geom::Point2D lhs, geom::Point2D rhs) {
+    constexpr double EPSILON = 1e-9;
+    return std::abs(lhs.x - rhs.x) < EPSILON && std::abs(lhs.y - rhs.y) < EPSILON;
+}
+
+}  // namespace
+
+SCENARIO("Work stealing pool") {
+    GIVEN("a pool with several threads") {
+        util::WorkStealingPool pool{3};
+
+        WHEN("a batch of tasks is run") {
+            std::vector<std::atomic<int>> runs(100);
+            std::vector<util::WorkStealingPool::Task> tasks;
+            for (auto& run : runs) {
+                tasks.emplace_back([&run] {
+                    ++run;
+                });
+            }
+            pool.RunAll(std::move(tasks));
+
+            THEN("every task is run exactly once before RunAll returns") {
+                for (const auto& run : runs) {
+                    CHECK(run == 1);
+                }
+            }
+        }
+
+        WHEN("a task throws") {
+            std::atomic<int> completed = 0;
+            std::vector<util::WorkStealingPool::Task> tasks;
+            tasks.emplace_back([] {
+                throw std::runtime_error("failure");
+            });
+            for (int i = 0; i < 10; ++i) {
+                tasks.emplace_back([&completed] {
+                    ++completed;
+                });
+            }
+
+            THEN("the exception is rethrown after the other tasks complete") {
+                CHECK_THROWS_AS(pool.RunAll(std::move(tasks)), std::runtime_error);
+                CHECK(completed == 10);
+            }
+        }
+
+        WHEN("many small batches are run one after another") {
+            // Потоки пула могут ещё искать задачи предыдущего пакета, когда
+            // RunAll раскладывает следующий
+            constexpr int BATCHES = 100'000;
+            std::atomic<int> runs = 0;
+            for (int i = 0; i < BATCHES; ++i) {
+                pool.RunAll({[&runs] {
+                                 ++runs;
+                             },
+                             [&runs] {
+                                 ++runs;
+                             }});
+            }
+
+            THEN("every batch completes") {
+                CHECK(runs == 2 * BATCHES);
+            }
+        }
+    }
+
+    GIVEN("a pool without threads") {
+        util::WorkStealingPool pool{0};
+
+        THEN("tasks are run by the calling thread") {
+            const auto caller = std::this_thread::get_id();
+            bool same_thread = false;
+            pool.RunAll({[&] {
+                same_thread = std::this_thread::get_id() == caller;
+            }});
+            CHECK(same_thread);
+        }
+    }
+}
+
+SCENARIO("Tick engine") {
+    GIVEN("an engine with two maps") {
+        TickEngine engine{{.period = 50ms, .max_step = 50ms, .threads = 2}};
+        engine.AddMap("map1"s);
+        engine.AddMap("map2"s);
+
+        THEN("map ids are unique") {
+            CHECK_THROWS_AS(engine.AddMap("map1"s), std::invalid_argument);
+            CHECK_THROWS_AS(engine.Modify("map3"sv, [](MapState&) {}), std::invalid_argument);
+        }
+
+        WHEN("dogs are added and a tick is run") {
+            engine.Modify("map1"sv, [](MapState& state) {
+                state.dogs.Add(MakeDog(1, {0, 0}, {1, 0}));
+            });
+            engine.Modify("map2"sv, [](MapState& state) {
+                state.dogs.Add(MakeDog(2, {5, 5}, {0, -2}));
+            });
+            const auto before = engine.GetSnapshot();
+            engine.Tick(1500ms);
+
+            THEN("dogs are moved according to their speed") {
+                const auto snapshot = engine.GetSnapshot();
+                CHECK(snapshot->tick == 1);
+                CHECK(snapshot->game_time == 1500ms);
+
+                const auto* map1 = snapshot->FindMap("map1"sv);
+                REQUIRE(map1);
+                REQUIRE(map1->dogs.Size() == 1);
+                CHECK(IsNear(map1->dogs.GetPositions()[0], geom::Point2D{1.5, 0}));
+
+                const auto* map2 = snapshot->FindMap("map2"sv);
+                REQUIRE(map2);
+                REQUIRE(map2->dogs.Size() == 1);
+                CHECK(IsNear(map2->dogs.GetPositions()[0], geom::Point2D{5, 2}));
+            }
+
+            THEN("snapshots taken earlier are not changed") {
+                CHECK(before->tick == 0);
+                CHECK(before->maps.empty());
+            }
+
+            AND_WHEN("the next tick is run") {
+                const auto first = engine.GetSnapshot();
+                engine.Tick(500ms);
+
+                THEN("it continues from the published state") {
+                    const auto snapshot = engine.GetSnapshot();
+                    CHECK(snapshot->tick == 2);
+                    const auto& dogs = snapshot->FindMap("map1"sv)->dogs;
+                    CHECK(IsNear(dogs.GetPositions()[0], {2, 0}));
+                    const auto& first_dogs = first->FindMap("map1"sv)->dogs;
+                    CHECK(IsNear(first_dogs.GetPositions()[0], {1.5, 0}));
+                }
+            }
+        }
+    }
+
+    GIVEN("an engine with a moving dog") {
+        TickEngine engine{{.period = 50ms, .max_step = 50ms, .threads = 1}};
+        engine.AddMap("map1"s);
+        engine.Modify("map1"sv, [](MapState& state) {
+            state.dogs.Add(MakeDog(1, {0, 0}, {1, 0}));
+        });
+        engine.Tick(100ms);
+        const MapState* first = engine.GetSnapshot()->FindMap("map1"sv);
+        engine.Tick(100ms);
+
+        WHEN("nobody holds the snapshot published two ticks ago") {
+            engine.Tick(100ms);
+
+            THEN("its map state is reused for the next tick") {
+                const auto snapshot = engine.GetSnapshot();
+                const auto* map = snapshot->FindMap("map1"sv);
+                CHECK(map == first);
+                REQUIRE(map->dogs.Size() == 1);
+                CHECK(IsNear(map->dogs.GetPositions()[0], {0.3, 0}));
+            }
+        }
+
+        WHEN("a reader holds that snapshot") {
+            engine.Tick(100ms);
+            const auto held = engine.GetSnapshot();
+            engine.Tick(100ms);
+            engine.Tick(100ms);
+
+            THEN("the held snapshot is not changed") {
+                const auto& dogs = held->FindMap("map1"sv)->dogs;
+                CHECK(IsNear(dogs.GetPositions()[0], {0.3, 0}));
+                CHECK(IsNear(engine.GetSnapshot()->FindMap("map1"sv)->dogs.GetPositions()[0],
+                             {0.5, 0}));
+            }
+        }
+    }
+
+    GIVEN("an engine with a recording step") {
+        std::vector<std::chrono::milliseconds> steps;
+        TickEngine engine{{.period = 50ms, .max_step = 50ms, .threads = 0},
+                          [&steps](MapState&, std::chrono::milliseconds time_delta) {
+                              steps.push_back(time_delta);
+                          }};
+        engine.AddMap("map1"s);
+
+        WHEN("time delta is longer than max step") {
+            engine.Tick(120ms);
+
+            THEN("it is split into steps not longer than max step") {
+                CHECK(steps == std::vector{50ms, 50ms, 20ms});
+            }
+        }
+
+        WHEN("time delta is zero") {
+            engine.Tick(0ms);
+
+            THEN("no steps are made") {
+                CHECK(steps.empty());
+                CHECK(engine.GetSnapshot()->tick == 1);
+            }
+        }
+    }
+
+    GIVEN("an engine whose first step fails") {
+        bool fail = true;
+        TickEngine engine{{.period = 50ms, .max_step = 50ms, .threads = 1},
+                          [&fail](MapState& state, std::chrono::milliseconds time_delta) {
+                              if (std::exchange(fail, false)) {
+                                  throw std::runtime_error("step failed");
+                              }
+                              MoveDogs(state, time_delta);
+                          }};
+        engine.AddMap("map1"s);
+        engine.Modify("map1"sv, [](MapState& state) {
+            state.dogs.Add(MakeDog(1, {0, 0}, {1, 0}));
+        });
+
+        WHEN("a tick fails") {
+            engine.Tick(100ms);
+
+            THEN("the map keeps its previous state and the tick is published") {
+                const auto snapshot = engine.GetSnapshot();
+                CHECK(snapshot->tick == 1);
+                CHECK(snapshot->FindMap("map1"sv)->dogs.IsEmpty());
+            }
+
+            THEN("the failure is counted and modifications taken by it are dropped") {
+                const auto stats = engine.GetStats();
+                CHECK(stats.failed_maps == 1);
+                CHECK(stats.dropped_modifications == 1);
+                CHECK(stats.last_error == "step failed"s);
+            }
+
+            AND_WHEN("the next tick succeeds") {
+                engine.Modify("map1"sv, [](MapState& state) {
+                    state.dogs.Add(MakeDog(2, {0, 0}, {0, 1}));
+                });
+                engine.Tick(100ms);
+
+                THEN("only modifications queued after the failure are applied") {
+                    const auto& dogs = engine.GetSnapshot()->FindMap("map1"sv)->dogs;
+                    REQUIRE(dogs.Size() == 1);
+                    CHECK(*dogs.GetColdData(dogs.GetHandle(0)).id == 2u);
+                    CHECK(IsNear(dogs.GetPositions()[0], {0, 0.1}));
+                }
+            }
+        }
+    }
+
+    GIVEN("an engine with a modification that always fails") {
+        TickEngine engine{{.period = 50ms, .max_step = 50ms, .threads = 1}};
+        engine.AddMap("map1"s);
+        engine.AddMap("map2"s);
+        engine.Modify("map1"sv, [](MapState& state) {
+            state.dogs.Add(MakeDog(1, {0, 0}, {1, 0}));
+        });
+        engine.Modify("map1"sv, [](MapState&) {
+            throw std::runtime_error("bad join");
+        });
+        engine.Modify("map1"sv, [](MapState& state) {
+            state.dogs.Add(MakeDog(2, {0, 0}, {0, 1}));
+        });
+        engine.Modify("map2"sv, [](MapState& state) {
+            state.dogs.Add(MakeDog(3, {0, 0}, {1, 0}));
+        });
+
+        WHEN("a tick is run") {
+            engine.Tick(100ms);
+
+            THEN("other maps are advanced and published") {
+                const auto snapshot = engine.GetSnapshot();
+                CHECK(snapshot->tick == 1);
+                CHECK(snapshot->FindMap("map1"sv)->dogs.IsEmpty());
+                const auto& dogs = snapshot->FindMap("map2"sv)->dogs;
+                REQUIRE(dogs.Size() == 1);
+                CHECK(IsNear(dogs.GetPositions()[0], {0.1, 0}));
+            }
+
+            THEN("only the failed modification is dropped") {
+                const auto stats = engine.GetStats();
+                CHECK(stats.failed_maps == 1);
+                CHECK(stats.dropped_modifications == 1);
+                CHECK(stats.last_error == "bad join"s);
+            }
+
+            AND_WHEN("the next tick is run") {
+                engine.Tick(100ms);
+
+                THEN("the remaining modifications are applied in order") {
+                    const auto& dogs = engine.GetSnapshot()->FindMap("map1"sv)->dogs;
+                    REQUIRE(dogs.Size() == 2);
+                    CHECK(*dogs.GetColdData(dogs.GetHandle(0)).id == 1u);
+                    CHECK(*dogs.GetColdData(dogs.GetHandle(1)).id == 2u);
+                    CHECK(engine.GetStats().failed_maps == 1);
+                }
+            }
+        }
+    }
+
+    GIVEN("an engine whose ticks are longer than the period") {
+        TickEngine engine{{.period = 1ms, .max_step = 50ms, .threads = 1},
+                          [](MapState&, std::chrono::milliseconds) {
+                              std::this_thread::sleep_for(5ms);
+                          }};
+        engine.AddMap("map1"s);
+        engine.Tick(10ms);
+        engine.Tick(10ms);
+
+        THEN("ticks are counted as overruns") {
+            const auto stats = engine.GetStats();
+            CHECK(stats.ticks == 2);
+            CHECK(stats.overruns == 2);
+            CHECK(stats.last_duration >= 5ms);
+            CHECK(stats.max_duration >= stats.last_duration);
+            CHECK(stats.total_duration >= stats.max_duration);
+        }
+    }
+
+    GIVEN("a started engine") {
+        TickEngine engine{{.period = 5ms, .max_step = 50ms, .threads = 1}};
+        engine.AddMap("map1"s);
+        engine.Modify("map1"sv, [](MapState& state) {
+            state.dogs.Add(MakeDog(1, {0, 0}, {1, 0}));
+        });
+        engine.Start();
+
+        WHEN("several periods pass") {
+            while (engine.GetSnapshot()->tick < 3) {
+                std::this_thread::sleep_for(1ms);
+            }
+            engine.Stop();
+
+            THEN("ticks advance maps by the elapsed time") {
+                const auto snapshot = engine.GetSnapshot();
+                CHECK(snapshot->game_time > 0ms);
+                const auto& dogs = snapshot->FindMap("map1"sv)->dogs;
+                REQUIRE(dogs.Size() == 1);
+                const double game_seconds =
+                    std::chrono::duration<double>(snapshot->game_time).count();
+                CHECK(IsNear(dogs.GetPositions()[0], {game_seconds, 0}));
+            }
+
+            THEN("no ticks are run after Stop") {
+                const auto tick = engine.GetSnapshot()->tick;
+                std::this_thread::sleep_for(20ms);
+                CHECK(engine.GetSnapshot()->tick == tick);
+            }
+        }
+    }
+}